@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+static inline double
+spk_bench_now ()
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// Growable in-memory source used to build synthetic workloads
+typedef struct spk_bench_source_s {
+    char   *data;
+    size_t size;
+    FILE   *stream;
+} spk_bench_source_t;
+
+static inline void
+spk_bench_source_begin (spk_bench_source_t *src)
+{
+    src->data = nullptr;
+    src->size = 0;
+    src->stream = open_memstream (&src->data, &src->size);
+}
+
+static inline void
+spk_bench_source_end (spk_bench_source_t *src)
+{
+    fclose (src->stream);
+    src->stream = nullptr;
+}
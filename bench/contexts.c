@@ -0,0 +1,155 @@
+#include "bench_common.h"
+
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/optimizer.h"
+#include "interpreter/ast_interpreter.h"
+#include "interpreter/context.h"
+#include "interpreter/statements.h"
+#include "utils/arena.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ Many small scripts run concurrently, one context per worker thread, from
+ one thread up to every online CPU. Each script goes through the whole
+ pipeline (lex, parse, resolve, type check, optimize, ast engine) and its
+ result is checked, so workers stepping on each other's state would fail
+ the run rather than just skew the numbers.
+
+ Usage: spk-bench-contexts [max threads] [scripts per thread]
+*/
+
+typedef struct spk_bench_worker_s {
+    pthread_t thread;
+    uint32_t  id;
+    uint32_t  scripts;
+    bool      ok;
+} spk_bench_worker_t;
+
+static int32_t
+spk_bench_expected (int32_t seed)
+{
+    int32_t a = seed * 3 + 7;
+    int32_t b = (a - seed) / 2;
+    return a * b + 1;
+}
+
+static bool
+spk_bench_run_script (spk_context_t *context, spk_arena_t *arena, int32_t seed)
+{
+    char src[256];
+    int len = snprintf (src, sizeof (src),
+                        "var seed = %d;\n"
+                        "var a = seed * 3 + 7;\n"
+                        "var b = (a - seed) / 2;\n"
+                        "var name = \"worker\" + \"-\" + \"rule\";\n"
+                        "var same = name == \"worker-rule\";\n"
+                        "var result = a * b + same;\n", seed);
+
+    auto tokens = spk_tokenize_source (src, (size_t)len, context->symbols);
+    auto statements = spk_parser_recursive_descent (tokens, arena);
+    spk_token_list_free (tokens);
+
+    bool ok = spk_resolve_statements (statements) && spk_typecheck_statements (statements);
+    if (ok) {
+        spk_optimize_statements (statements, SPK_OPT_LEVEL_MAX);
+        for (size_t i = 0; i < statements->count; ++i) {
+            spk_interpret_statement (context, darray_elem (statements, i));
+        }
+
+        spk_statement_t *last = darray_elem (statements, statements->count - 1);
+        auto result = context->globals[last->var.slot];
+        ok = spk_value_as_int (result) == spk_bench_expected (seed);
+    }
+
+    spk_interpreter_reset (context);
+    darray_free (statements);
+    spk_arena_reset (arena);
+    return ok;
+}
+
+static void *
+spk_bench_worker (void *arg)
+{
+    spk_bench_worker_t *worker = arg;
+
+    auto context = spk_context_create ();
+    spk_arena_t arena;
+    spk_arena_init (&arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+
+    worker->ok = true;
+    for (uint32_t i = 0; i < worker->scripts && worker->ok; ++i) {
+        // Different inputs per worker, a result computed in another
+        // context would not match
+        int32_t seed = (int32_t)(worker->id * 100000 + i % 100000);
+        worker->ok = spk_bench_run_script (context, &arena, seed);
+    }
+
+    spk_arena_release (&arena);
+    spk_context_free (context);
+    return nullptr;
+}
+
+// Returns the elapsed time, or a negative value if a script failed
+static double
+spk_bench_run (uint32_t threads, uint32_t scripts)
+{
+    spk_bench_worker_t *workers = calloc (threads, sizeof (spk_bench_worker_t));
+
+    double start = spk_bench_now ();
+
+    uint32_t started = 0;
+    for (; started < threads; ++started) {
+        workers[started].id = started;
+        workers[started].scripts = scripts;
+        if (pthread_create (&workers[started].thread, nullptr,
+                            spk_bench_worker, &workers[started]) != 0) {
+            break;
+        }
+    }
+
+    bool ok = started == threads;
+    for (uint32_t i = 0; i < started; ++i) {
+        pthread_join (workers[i].thread, nullptr);
+        ok = ok && workers[i].ok;
+    }
+
+    double elapsed = spk_bench_now () - start;
+    free (workers);
+    return ok ? elapsed : -1.0;
+}
+
+int
+main (int argc, char **argv)
+{
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    uint32_t max_threads = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) :
+                                      (uint32_t)(cpus > 1 ? cpus : 1);
+    uint32_t scripts = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) : 20000;
+
+    printf ("%u scripts per thread, %ld online CPUs\n\n", scripts, cpus);
+    printf ("%-8s %14s %10s %11s\n", "threads", "scripts/s", "speedup", "efficiency");
+
+    double single = 0.0;
+    for (uint32_t threads = 1; threads <= max_threads; ++threads) {
+        double elapsed = spk_bench_run (threads, scripts);
+        if (elapsed < 0.0) {
+            printf ("A script returned a wrong result with %u threads\n", threads);
+            return EXIT_FAILURE;
+        }
+
+        double rate = (double)threads * scripts / elapsed;
+        if (threads == 1) {
+            single = rate;
+        }
+
+        printf ("%-8u %14.0f %9.2fx %10.0f%%\n", threads, rate,
+                rate / single, rate / single / threads * 100.0);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+#include "bench_common.h"
+
+#include "spark.h"
+
+#include <string.h>
+
+/*
+ The libspark use case: the same rules evaluated for every request with
+ different inputs. Compares compiling the source for every evaluation with
+ compiling it once and running the program handle again, per engine.
+
+ Usage: spk-bench-embed [evaluations]
+*/
+
+static const char *spk_bench_rules =
+    "var total = price * quantity;\n"
+    "var discounted = total - total / 10 * (quantity > 10);\n"
+    "var shipping = (discounted < 5000) * 499;\n"
+    "var premium = tier == \"gold\";\n"
+    "var charge = discounted + shipping * (1 - premium);\n"
+    "var label = \"order-\" + tier;\n";
+
+static const spk_input_t spk_bench_inputs[] = {
+    { "price", SPK_INPUT_INT },
+    { "quantity", SPK_INPUT_INT },
+    { "tier", SPK_INPUT_STRING },
+};
+
+static const char *spk_bench_tiers[] = { "gold", "silver", "bronze" };
+
+static const char *spk_bench_engine_names[] = {
+    [SPK_ENGINE_VM] = "vm",
+    [SPK_ENGINE_AST] = "ast",
+    [SPK_ENGINE_CLOSURE] = "closure",
+};
+
+static int32_t
+spk_bench_expected_charge (int32_t price, int32_t quantity, const char *tier)
+{
+    int32_t total = price * quantity;
+    int32_t discounted = total - total / 10 * (quantity > 10);
+    int32_t shipping = (discounted < 5000) * 499;
+    int32_t premium = strcmp (tier, "gold") == 0;
+    return discounted + shipping * (1 - premium);
+}
+
+static void
+spk_bench_inputs_for (uint32_t i, spk_input_value_t values[3])
+{
+    values[0].integer = (int32_t)(100 + i % 1000);
+    values[1].integer = (int32_t)(1 + i % 20);
+    values[2].string = spk_bench_tiers[i % 3];
+}
+
+static bool
+spk_bench_check (spk_program_t *program, const spk_input_value_t values[3])
+{
+    int32_t charge;
+    auto label = spk_program_get_string (program, "label");
+    return spk_program_get_int (program, "charge", &charge) &&
+           charge == spk_bench_expected_charge (values[0].integer, values[1].integer,
+                                                values[2].string) &&
+           label && strncmp (label, "order-", 6) == 0 &&
+           strcmp (label + 6, values[2].string) == 0;
+}
+
+// Both return the elapsed time, or a negative value if an evaluation was wrong
+static double
+spk_bench_compile_each (const spk_program_options_t *options, uint32_t evaluations)
+{
+    double start = spk_bench_now ();
+
+    for (uint32_t i = 0; i < evaluations; ++i) {
+        spk_input_value_t values[3];
+        spk_bench_inputs_for (i, values);
+
+        auto program = spk_program_compile (spk_bench_rules, strlen (spk_bench_rules), options);
+        auto ok = program && spk_program_run (program, values) && spk_bench_check (program, values);
+        if (program) {
+            spk_program_free (program);
+        }
+
+        if (!ok) {
+            return -1.0;
+        }
+    }
+
+    return spk_bench_now () - start;
+}
+
+static double
+spk_bench_compile_once (const spk_program_options_t *options, uint32_t evaluations)
+{
+    double start = spk_bench_now ();
+
+    auto program = spk_program_compile (spk_bench_rules, strlen (spk_bench_rules), options);
+    if (!program) {
+        return -1.0;
+    }
+
+    bool ok = true;
+    for (uint32_t i = 0; i < evaluations && ok; ++i) {
+        spk_input_value_t values[3];
+        spk_bench_inputs_for (i, values);
+        ok = spk_program_run (program, values) && spk_bench_check (program, values);
+    }
+
+    spk_program_free (program);
+    return ok ? spk_bench_now () - start : -1.0;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t evaluations = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 200000;
+
+    printf ("%u evaluations\n\n", evaluations);
+    printf ("%-8s %18s %18s %9s\n", "engine", "compile each/s", "compile once/s", "speedup");
+
+    for (uint32_t engine = SPK_ENGINE_VM; engine <= SPK_ENGINE_CLOSURE; ++engine) {
+        spk_program_options_t options;
+        spk_program_options_init (&options);
+        options.engine = (SPK_engine)engine;
+        options.inputs = spk_bench_inputs;
+        options.input_count = sizeof (spk_bench_inputs) / sizeof (spk_bench_inputs[0]);
+
+        double each = spk_bench_compile_each (&options, evaluations);
+        double once = spk_bench_compile_once (&options, evaluations);
+        if (each < 0.0 || once < 0.0) {
+            printf ("%s returned a wrong result\n", spk_bench_engine_names[engine]);
+            return EXIT_FAILURE;
+        }
+
+        printf ("%-8s %18.0f %18.0f %8.1fx\n", spk_bench_engine_names[engine],
+                evaluations / each, evaluations / once, each / once);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+#include "bench_common.h"
+
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/ast_interpreter.h"
+#include "interpreter/context.h"
+#include "interpreter/bytecode.h"
+#include "interpreter/compiler.h"
+#include "interpreter/vm.h"
+#include "interpreter/closure.h"
+#include "utils/arena.h"
+
+/*
+ Scales the number of global variables and reports the cost per statement
+ of compiling and running a script that declares them all and then reads
+ pairs of them back.
+
+ Usage: spk-bench-globals [max globals] [reads per global]
+
+ With symbol lookups in constant time the ns/statement column stays flat
+ as the number of globals grows, a linear lookup makes it grow with N.
+*/
+
+typedef enum {
+    SPK_BENCH_ENGINE_AST,
+    SPK_BENCH_ENGINE_VM,
+    SPK_BENCH_ENGINE_CLOSURE,
+
+    SPK_BENCH_ENGINE_COUNT
+} SPK_bench_engine;
+
+static const char *spk_bench_engine_names[SPK_BENCH_ENGINE_COUNT] = {
+    [SPK_BENCH_ENGINE_AST] = "ast",
+    [SPK_BENCH_ENGINE_VM] = "vm",
+    [SPK_BENCH_ENGINE_CLOSURE] = "closure",
+};
+
+static void
+spk_bench_build_source (spk_bench_source_t *src, uint32_t globals, uint32_t reads)
+{
+    spk_bench_source_begin (src);
+
+    for (uint32_t i = 0; i < globals; ++i) {
+        fprintf (src->stream, "var global_variable_%u = %u;\n", i, i);
+    }
+
+    uint32_t state = 0x9e3779b9;
+    for (uint32_t i = 0; i < globals * reads; ++i) {
+        state = state * 1664525u + 1013904223u;
+        uint32_t a = (state >> 8) % globals;
+        state = state * 1664525u + 1013904223u;
+        uint32_t b = (state >> 8) % globals;
+        fprintf (src->stream, "global_variable_%u + global_variable_%u;\n", a, b);
+    }
+
+    spk_bench_source_end (src);
+}
+
+static bool
+spk_bench_execute (SPK_bench_engine engine, spk_context_t *context, darray_t *statements)
+{
+    switch (engine) {
+        case SPK_BENCH_ENGINE_AST:
+            for (size_t i = 0; i < statements->count; ++i) {
+                spk_interpret_statement (context, darray_elem (statements, i));
+            }
+            spk_interpreter_reset (context);
+            return true;
+        case SPK_BENCH_ENGINE_VM:
+            auto chunk = spk_compile_statements (statements);
+            if (!chunk) {
+                return false;
+            }
+
+            auto result = spk_vm_run (chunk);
+            spk_chunk_free (chunk);
+            return result == SPK_VM_RESULT_OK;
+        case SPK_BENCH_ENGINE_CLOSURE:
+            auto program = spk_closure_compile (statements);
+            if (!program) {
+                return false;
+            }
+
+            auto ok = spk_closure_run (program);
+            spk_closure_program_free (program);
+            return ok;
+        default:
+            return false;
+    }
+}
+
+// Lexes, parses and runs the source, returning the elapsed time
+// or a negative value if the script failed
+static double
+spk_bench_run (SPK_bench_engine engine, const spk_bench_source_t *src)
+{
+    double start = spk_bench_now ();
+
+    spk_arena_t arena;
+    spk_arena_init (&arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    auto context = spk_context_create ();
+
+    auto tokens = spk_tokenize_source (src->data, src->size, context->symbols);
+    auto statements = spk_parser_recursive_descent (tokens, &arena);
+    auto ok = spk_resolve_statements (statements) &&
+              spk_typecheck_statements (statements) &&
+              spk_bench_execute (engine, context, statements);
+
+    darray_free (statements);
+    spk_token_list_free (tokens);
+    spk_context_free (context);
+    spk_arena_release (&arena);
+
+    double elapsed = spk_bench_now () - start;
+    return ok ? elapsed : -1.0;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t max_globals = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 65536;
+    uint32_t reads = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) : 4;
+
+    // Global slots are u16 operands in the bytecode
+    if (max_globals > UINT16_MAX + 1) {
+        max_globals = UINT16_MAX + 1;
+    }
+
+    printf ("%10s %12s", "globals", "statements");
+    for (uint32_t e = 0; e < SPK_BENCH_ENGINE_COUNT; ++e) {
+        printf (" %10s ns/stmt", spk_bench_engine_names[e]);
+    }
+    printf ("\n");
+
+    for (uint32_t globals = 16; globals <= max_globals; globals *= 4) {
+        spk_bench_source_t src;
+        spk_bench_build_source (&src, globals, reads);
+
+        uint32_t statements = globals + globals * reads;
+        printf ("%10u %12u", globals, statements);
+
+        for (uint32_t e = 0; e < SPK_BENCH_ENGINE_COUNT; ++e) {
+            double elapsed = spk_bench_run (e, &src);
+            if (elapsed < 0.0) {
+                printf ("\n%s failed to run the benchmark script\n", spk_bench_engine_names[e]);
+                return EXIT_FAILURE;
+            }
+
+            printf (" %18.1f", elapsed / statements * 1e9);
+        }
+        printf ("\n");
+
+        free (src.data);
+    }
+
+    return EXIT_SUCCESS;
+}
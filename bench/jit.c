@@ -0,0 +1,136 @@
+#include "bench_common.h"
+
+#include "spark.h"
+
+#include <string.h>
+
+/*
+ The JIT against the tree walker it falls back to, on an int-only script
+ run again and again with different inputs. Every statement gets hot
+ after the threshold's worth of runs and runs natively from then on.
+ The vm and closure engines are there for reference.
+
+ Usage: spk-bench-jit [runs] [statements] [threshold]
+*/
+
+static const spk_input_t spk_bench_inputs[] = {
+    { "x", SPK_INPUT_INT },
+    { "y", SPK_INPUT_INT },
+};
+
+typedef struct spk_bench_engine_s {
+    const char *name;
+    SPK_engine engine;
+    bool       jit;
+} spk_bench_engine_t;
+
+static const spk_bench_engine_t spk_bench_engines[] = {
+    { "ast", SPK_ENGINE_AST, false },
+    { "ast+jit", SPK_ENGINE_AST, true },
+    { "closure", SPK_ENGINE_CLOSURE, false },
+    { "vm", SPK_ENGINE_VM, false },
+};
+
+// Every statement depends on the inputs and the one before it, none of
+// them folds away
+static void
+spk_bench_generate (spk_bench_source_t *src, uint32_t statements)
+{
+    spk_bench_source_begin (src);
+
+    fprintf (src->stream, "var v0 = x * 3 + y;\n");
+    for (uint32_t i = 1; i < statements; ++i) {
+        fprintf (src->stream,
+                 "var v%u = (v%u * %u + x - y / %u) / 2 + (v%u > x) * (y - %u) - -(x <= %u);\n",
+                 i, i - 1, i % 7 + 2, i % 5 + 1, i - 1, i % 11, i % 13);
+    }
+    fprintf (src->stream, "var result = v%u;\n", statements - 1);
+
+    spk_bench_source_end (src);
+}
+
+// Returns the elapsed time, or a negative value if a run failed.
+// Sums the results so engines can be compared.
+static double
+spk_bench_run (const spk_bench_engine_t *engine, const spk_bench_source_t *src,
+               uint32_t runs, uint32_t threshold, int64_t *checksum)
+{
+    spk_program_options_t options;
+    spk_program_options_init (&options);
+    options.engine = engine->engine;
+    options.jit = engine->jit;
+    options.jit_threshold = threshold;
+    options.inputs = spk_bench_inputs;
+    options.input_count = sizeof (spk_bench_inputs) / sizeof (spk_bench_inputs[0]);
+
+    auto program = spk_program_compile (src->data, src->size, &options);
+    if (!program) {
+        return -1.0;
+    }
+
+    *checksum = 0;
+    bool ok = true;
+    double start = spk_bench_now ();
+
+    for (uint32_t i = 0; i < runs && ok; ++i) {
+        spk_input_value_t values[2];
+        values[0].integer = (int32_t)(i % 1000);
+        values[1].integer = (int32_t)(7 + i % 31);
+
+        int32_t result;
+        ok = spk_program_run (program, values) && spk_program_get_int (program, "result", &result);
+        *checksum += result;
+    }
+
+    double elapsed = spk_bench_now () - start;
+    spk_program_free (program);
+    return ok ? elapsed : -1.0;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t runs = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 20000;
+    uint32_t statements = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) : 200;
+    uint32_t threshold = argc > 3 ? (uint32_t)strtoul (argv[3], nullptr, 10) : 10;
+    if (statements == 0) {
+        statements = 1;
+    }
+
+    spk_bench_source_t src;
+    spk_bench_generate (&src, statements);
+
+    printf ("%u runs of %u statements, JIT threshold %u\n\n", runs, statements, threshold);
+    printf ("%-8s %12s %12s %9s\n", "engine", "runs/s", "ns/stmt", "vs ast");
+
+    double ast_time = 0.0;
+    int64_t expected = 0;
+    auto engine_count = sizeof (spk_bench_engines) / sizeof (spk_bench_engines[0]);
+
+    for (size_t i = 0; i < engine_count; ++i) {
+        auto engine = &spk_bench_engines[i];
+
+        int64_t checksum;
+        double elapsed = spk_bench_run (engine, &src, runs, threshold, &checksum);
+        if (elapsed < 0.0) {
+            printf ("%s failed to run the script\n", engine->name);
+            free (src.data);
+            return EXIT_FAILURE;
+        }
+
+        if (i == 0) {
+            ast_time = elapsed;
+            expected = checksum;
+        } else if (checksum != expected) {
+            printf ("%s returned a wrong result\n", engine->name);
+            free (src.data);
+            return EXIT_FAILURE;
+        }
+
+        printf ("%-8s %12.0f %12.1f %8.1fx\n", engine->name, runs / elapsed,
+                elapsed * 1e9 / ((double)runs * (statements + 1)), ast_time / elapsed);
+    }
+
+    free (src.data);
+    return EXIT_SUCCESS;
+}
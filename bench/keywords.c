@@ -0,0 +1,179 @@
+#include "bench_common.h"
+
+#include "interpreter/token.h"
+#include "interpreter/keywords.h"
+#include "interpreter/lexer.h"
+
+#include <string.h>
+
+/*
+ Identifier classification microbenchmark.
+
+ Usage: spk-bench-keywords [words] [iterations]
+
+ Compares spk_keyword_lookup against the previous approach of comparing
+ every identifier with every spelling in SPK_TOKEN_ENUM_ITER(), then
+ reports lexer throughput on the same identifier-heavy corpus.
+*/
+
+typedef struct spk_bench_word_s {
+    const char *text;
+    size_t     len;
+} spk_bench_word_t;
+
+static inline bool
+spk_bench_is_spelling (const char *spelling, const char *text, size_t len)
+{
+    return spelling && strlen (spelling) == len && memcmp (spelling, text, len) == 0;
+}
+
+// Kept out of line so both classifiers pay the same call overhead
+__attribute__((noinline)) static SPK_token_type
+spk_keyword_lookup_linear (const char *text, size_t len)
+{
+    SPK_token_type type = SPK_TOKEN_TYPE_IDENTIFIER;
+#define SPK_TOKEN_TYPE(t, n) \
+    if (spk_bench_is_spelling (n, text, len)) { \
+        type = t; \
+    }
+    SPK_TOKEN_ENUM_ITER();
+#undef SPK_TOKEN_TYPE
+    return type;
+}
+
+static uint32_t
+spk_bench_rand (uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void
+spk_bench_build_corpus (spk_bench_source_t *src, uint32_t words)
+{
+    static const char *keywords[] = {
+        "var", "mut", "print", "fn", "if", "else", "for", "while", "return",
+        "va", "vars", "prin", "muts", "fns", "iff", "elsif", "fore", "whiles", "ret"
+    };
+    static const char ident_chars[] = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+    uint32_t state = 0x12345678;
+    spk_bench_source_begin (src);
+
+    for (uint32_t i = 0; i < words; ++i) {
+        uint32_t roll = spk_bench_rand (&state) % 100;
+        if (roll < 30) {
+            fputs (keywords[spk_bench_rand (&state) % (sizeof (keywords) / sizeof (keywords[0]))],
+                   src->stream);
+        } else {
+            uint32_t len = 1 + spk_bench_rand (&state) % 12;
+            // Identifiers can't start with a digit
+            fputc (ident_chars[spk_bench_rand (&state) % 53], src->stream);
+            for (uint32_t c = 1; c < len; ++c) {
+                fputc (ident_chars[spk_bench_rand (&state) % (sizeof (ident_chars) - 1)],
+                       src->stream);
+            }
+        }
+
+        fputc (i % 16 == 15 ? '\n' : ' ', src->stream);
+    }
+
+    spk_bench_source_end (src);
+}
+
+static size_t
+spk_bench_split_words (const spk_bench_source_t *src, spk_bench_word_t *words)
+{
+    size_t count = 0;
+    const char *p = src->data;
+    const char *end = src->data + src->size;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\n')) {
+            ++p;
+        }
+
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\n') {
+            ++p;
+        }
+
+        if (p > start) {
+            words[count++] = (spk_bench_word_t) { start, (size_t)(p - start) };
+        }
+    }
+
+    return count;
+}
+
+typedef SPK_token_type (*spk_bench_lookup_fn_t) (const char *text, size_t len);
+
+__attribute__((noinline)) static double
+spk_bench_lookups (const char *name, spk_bench_lookup_fn_t fn,
+                   const spk_bench_word_t *words, size_t count, uint32_t iterations)
+{
+    uint64_t keywords = 0;
+    double start = spk_bench_now ();
+
+    for (uint32_t it = 0; it < iterations; ++it) {
+        for (size_t i = 0; i < count; ++i) {
+            keywords += fn (words[i].text, words[i].len) != SPK_TOKEN_TYPE_IDENTIFIER;
+        }
+    }
+
+    double elapsed = spk_bench_now () - start;
+    double lookups = (double)count * iterations;
+    printf ("%-10s %10.2f Mlookups/s %8.2f ns/lookup (%lu keywords)\n",
+            name, lookups / elapsed / 1e6, elapsed / lookups * 1e9,
+            (unsigned long)(keywords / iterations));
+    return elapsed;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t word_count = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 1000000;
+    uint32_t iterations = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) : 10;
+
+    spk_bench_source_t src;
+    spk_bench_build_corpus (&src, word_count);
+
+    spk_bench_word_t *words = calloc (word_count, sizeof (spk_bench_word_t));
+    size_t count = spk_bench_split_words (&src, words);
+
+    // Both classifiers have to agree before their timings mean anything
+    for (size_t i = 0; i < count; ++i) {
+        if (spk_keyword_lookup (words[i].text, words[i].len) !=
+            spk_keyword_lookup_linear (words[i].text, words[i].len)) {
+            printf ("Mismatch on '%.*s'\n", (int)words[i].len, words[i].text);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf ("%zu words, %zu bytes\n\n", count, src.size);
+
+    double linear = spk_bench_lookups ("linear", spk_keyword_lookup_linear, words, count, iterations);
+    double hashed = spk_bench_lookups ("perfect", spk_keyword_lookup, words, count, iterations);
+    printf ("speedup    %10.2fx\n\n", linear / hashed);
+
+    double start = spk_bench_now ();
+    size_t tokens = 0;
+    for (uint32_t it = 0; it < iterations; ++it) {
+        auto symbols = spk_symbol_table_create ();
+        auto list = spk_tokenize_source (src.data, src.size, symbols);
+        tokens = list->tokens.count;
+        spk_token_list_free (list);
+        spk_symbol_table_free (symbols);
+    }
+    double elapsed = spk_bench_now () - start;
+
+    printf ("lexer      %10.2f MB/s %8.2f Mtokens/s\n",
+            (double)src.size * iterations / elapsed / 1e6,
+            (double)tokens * iterations / elapsed / 1e6);
+
+    free (words);
+    free (src.data);
+    return EXIT_SUCCESS;
+}
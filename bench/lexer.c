@@ -0,0 +1,95 @@
+#include "bench_common.h"
+#include "lexer_corpus.h"
+
+#include "interpreter/token.h"
+#include "interpreter/lexer.h"
+#include "interpreter/scan.h"
+
+#include <string.h>
+
+/*
+ Lexer throughput for every scan implementation the CPU supports.
+
+ Usage: spk-bench-lexer [megabytes] [iterations]
+
+ Token streams from every implementation are checked against the scalar
+ one before anything is timed.
+*/
+
+// Every run interns into a fresh table, like a real compilation would.
+// Single-threaded, lexer_threads.c measures the scaling across cores.
+static spk_token_list_t *
+spk_bench_tokenize (const spk_bench_source_t *src)
+{
+    return spk_tokenize_source_parallel (src->data, src->size,
+                                         spk_symbol_table_create (), 1);
+}
+
+static void
+spk_bench_free_tokens (spk_token_list_t *list)
+{
+    spk_symbol_table_free (list->symbols);
+    spk_token_list_free (list);
+}
+
+static bool
+spk_bench_same_tokens (const spk_token_list_t *a, const spk_token_list_t *b)
+{
+    return a->tokens.count == b->tokens.count &&
+           memcmp (a->tokens.data, b->tokens.data,
+                   a->tokens.count * sizeof (spk_token_t)) == 0;
+}
+
+int
+main (int argc, char **argv)
+{
+    size_t megabytes = argc > 1 ? strtoul (argv[1], nullptr, 10) : 64;
+    uint32_t iterations = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) : 5;
+
+    spk_bench_source_t src;
+    spk_bench_build_corpus (&src, megabytes);
+
+    auto best = spk_scan_impl_current ();
+
+    spk_scan_use (SPK_SCAN_IMPL_SCALAR);
+    auto reference = spk_bench_tokenize (&src);
+
+    printf ("%zu bytes, %zu tokens, default scan: %s\n\n",
+            src.size, reference->tokens.count, spk_scan_impl_str (best));
+    printf ("%-8s %10s %12s %10s\n", "scan", "MB/s", "Mtokens/s", "speedup");
+
+    double scalar_time = 0.0;
+    for (uint32_t i = 0; i < SPK_SCAN_IMPL_COUNT; ++i) {
+        SPK_scan_impl impl = i;
+        if (!spk_scan_use (impl)) {
+            continue;
+        }
+
+        auto tokens = spk_bench_tokenize (&src);
+        if (!spk_bench_same_tokens (reference, tokens)) {
+            printf ("%s produced a different token stream\n", spk_scan_impl_str (impl));
+            return EXIT_FAILURE;
+        }
+        spk_bench_free_tokens (tokens);
+
+        double start = spk_bench_now ();
+        for (uint32_t it = 0; it < iterations; ++it) {
+            spk_bench_free_tokens (spk_bench_tokenize (&src));
+        }
+        double elapsed = (spk_bench_now () - start) / iterations;
+
+        if (impl == SPK_SCAN_IMPL_SCALAR) {
+            scalar_time = elapsed;
+        }
+
+        printf ("%-8s %10.2f %12.2f %9.2fx\n",
+                spk_scan_impl_str (impl),
+                (double)src.size / elapsed / 1e6,
+                (double)reference->tokens.count / elapsed / 1e6,
+                scalar_time / elapsed);
+    }
+
+    spk_bench_free_tokens (reference);
+    free (src.data);
+    return EXIT_SUCCESS;
+}
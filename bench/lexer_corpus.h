@@ -0,0 +1,91 @@
+#pragma once
+
+#include "bench_common.h"
+
+/*
+ Synthetic lexer input shared by the lexer benchmarks. The corpus mimics
+ generated scripts: long identifiers, deep indentation, comment banners
+ and string literals, with a little arithmetic in between.
+
+ Some strings span a few lines, and every SPK_BENCH_LONG_STRING_EVERY
+ bytes one spans SPK_BENCH_LONG_STRING_SIZE. The parallel lexer cuts
+ its chunks of at least SPK_LEXER_MIN_CHUNK bytes at newlines, so
+ chunks start inside strings and a long string covers whole chunks.
+*/
+
+#define SPK_BENCH_LONG_STRING_FIRST (8 * 1024 * 1024)
+#define SPK_BENCH_LONG_STRING_EVERY (128 * 1024 * 1024)
+#define SPK_BENCH_LONG_STRING_SIZE  (10 * 1024 * 1024)
+
+static inline uint32_t
+spk_bench_rand (uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static inline void
+spk_bench_build_corpus (spk_bench_source_t *src, size_t megabytes)
+{
+    static const char ident_chars[] = "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+    uint32_t state = 0x2545f491;
+    spk_bench_source_begin (src);
+
+    size_t long_string = SPK_BENCH_LONG_STRING_FIRST;
+    size_t size;
+    while ((size = (size_t)ftell (src->stream)) < megabytes * 1024 * 1024) {
+        if (size >= long_string) {
+            fputs ("print \"", src->stream);
+            for (uint32_t i = 0; (size_t)ftell (src->stream) - size < SPK_BENCH_LONG_STRING_SIZE; ++i) {
+                fprintf (src->stream, "line %u of a string spanning several chunks\n", i);
+            }
+            fputs ("\";\n", src->stream);
+            long_string += SPK_BENCH_LONG_STRING_EVERY;
+            continue;
+        }
+
+        uint32_t indent = spk_bench_rand (&state) % 5;
+        fprintf (src->stream, "%*s", (int)(indent * 4), "");
+
+        uint32_t roll = spk_bench_rand (&state) % 100;
+        if (roll < 8) {
+            fputs ("# ---------------------------------------------------------------\n",
+                   src->stream);
+            continue;
+        }
+
+        if (roll < 10) {
+            fputs ("print \"a string", src->stream);
+            for (uint32_t lines = 1 + spk_bench_rand (&state) % 4; lines > 0; --lines) {
+                fprintf (src->stream, "\nspanning line %u", spk_bench_rand (&state));
+            }
+            fputs ("\";\n", src->stream);
+            continue;
+        }
+
+        if (roll < 20) {
+            fprintf (src->stream, "print \"generated string literal number %u\";\n",
+                     spk_bench_rand (&state));
+            continue;
+        }
+
+        fputs ("var ", src->stream);
+        uint32_t len = 8 + spk_bench_rand (&state) % 32;
+        fputc (ident_chars[spk_bench_rand (&state) % 53], src->stream);
+        for (uint32_t c = 1; c < len; ++c) {
+            fputc (ident_chars[spk_bench_rand (&state) % (sizeof (ident_chars) - 1)],
+                   src->stream);
+        }
+        fprintf (src->stream, " = generated_identifier_%u + %u;\n",
+                 spk_bench_rand (&state) % 1000, spk_bench_rand (&state) % 100);
+
+        if (spk_bench_rand (&state) % 10 == 0) {
+            fputc ('\n', src->stream);
+        }
+    }
+
+    spk_bench_source_end (src);
+}
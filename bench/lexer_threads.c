@@ -0,0 +1,99 @@
+#include "bench_common.h"
+#include "lexer_corpus.h"
+
+#include "interpreter/token.h"
+#include "interpreter/lexer.h"
+
+#include <string.h>
+#include <unistd.h>
+
+/*
+ Parallel lexer throughput from one thread up to every online CPU.
+
+ Usage: spk-bench-lexer-threads [megabytes] [max threads] [iterations]
+
+ Runs on a 500 MB corpus by default, see lexer_corpus.h. Every thread
+ count has to produce the same tokens and symbols as the single-threaded
+ lexer before it is timed, the best of the iterations is reported.
+*/
+
+static spk_token_list_t *
+spk_bench_tokenize (const spk_bench_source_t *src, uint32_t threads)
+{
+    return spk_tokenize_source_parallel (src->data, src->size,
+                                         spk_symbol_table_create (), threads);
+}
+
+static void
+spk_bench_free_tokens (spk_token_list_t *list)
+{
+    spk_symbol_table_free (list->symbols);
+    spk_token_list_free (list);
+}
+
+static bool
+spk_bench_same_tokens (const spk_token_list_t *a, const spk_token_list_t *b)
+{
+    return a->tokens.count == b->tokens.count &&
+           spk_symbol_count (a->symbols) == spk_symbol_count (b->symbols) &&
+           memcmp (a->tokens.data, b->tokens.data,
+                   a->tokens.count * sizeof (spk_token_t)) == 0;
+}
+
+int
+main (int argc, char **argv)
+{
+    size_t megabytes = argc > 1 ? strtoul (argv[1], nullptr, 10) : 500;
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    uint32_t max_threads = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) :
+                                      (uint32_t)(cpus > 1 ? cpus : 1);
+    uint32_t iterations = argc > 3 ? (uint32_t)strtoul (argv[3], nullptr, 10) : 3;
+
+    spk_bench_source_t src;
+    spk_bench_build_corpus (&src, megabytes);
+
+    auto reference = spk_bench_tokenize (&src, 1);
+    if (!reference) {
+        return EXIT_FAILURE;
+    }
+
+    printf ("%zu bytes, %zu tokens, %ld online CPUs\n\n",
+            src.size, reference->tokens.count, cpus);
+    printf ("%-8s %10s %12s %10s %11s\n",
+            "threads", "MB/s", "Mtokens/s", "speedup", "efficiency");
+
+    double single_time = 0.0;
+    for (uint32_t threads = 1; threads <= max_threads; ++threads) {
+        double best = 0.0;
+        for (uint32_t it = 0; it < iterations; ++it) {
+            double start = spk_bench_now ();
+            auto tokens = spk_bench_tokenize (&src, threads);
+            double elapsed = spk_bench_now () - start;
+
+            if (!spk_bench_same_tokens (reference, tokens)) {
+                printf ("%u threads produced a different token stream\n", threads);
+                return EXIT_FAILURE;
+            }
+            spk_bench_free_tokens (tokens);
+
+            if (it == 0 || elapsed < best) {
+                best = elapsed;
+            }
+        }
+
+        if (threads == 1) {
+            single_time = best;
+        }
+
+        printf ("%-8u %10.2f %12.2f %9.2fx %10.0f%%\n",
+                threads,
+                (double)src.size / best / 1e6,
+                (double)reference->tokens.count / best / 1e6,
+                single_time / best,
+                single_time / best / threads * 100.0);
+    }
+
+    spk_bench_free_tokens (reference);
+    free (src.data);
+    return EXIT_SUCCESS;
+}
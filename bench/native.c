@@ -0,0 +1,287 @@
+#include "bench_common.h"
+
+#include "spark.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ Ahead-of-time compilation against the interpreter. The script is
+ emitted with spk_program_emit_asm and spk_program_emit_c, built with
+ the system C compiler (-O2 for the C file) and run as its own process,
+ start-up included. The engines run the same script compiled once, and
+ once more from source each run the way spk-interp does.
+
+ Usage: spk-bench-native [runs] [statements]
+*/
+
+#ifndef SPK_BENCH_RUNTIME
+#error "SPK_BENCH_RUNTIME has to name the spk-runtime library"
+#endif
+
+extern char **environ;
+
+typedef struct spk_bench_engine_s {
+    const char *name;
+    SPK_engine engine;
+} spk_bench_engine_t;
+
+static const spk_bench_engine_t spk_bench_engines[] = {
+    { "ast", SPK_ENGINE_AST },
+    { "closure", SPK_ENGINE_CLOSURE },
+    { "vm", SPK_ENGINE_VM },
+};
+
+// Same shape as spk-bench-jit's, with strings in between. Every
+// statement refers to the one before it, nothing folds away.
+static void
+spk_bench_generate (spk_bench_source_t *src, uint32_t statements)
+{
+    spk_bench_source_begin (src);
+
+    fprintf (src->stream, "var v0 = 12345;\nvar s0 = \"spark\";\n");
+    for (uint32_t i = 1; i < statements; ++i) {
+        fprintf (src->stream,
+                 "var v%u = (v%u * %u + v%u / %u) / 3 - (v%u > %u) * %u + -(v%u <= %u);\n",
+                 i, i - 1, i % 7 + 2, i - 1, i % 5 + 1, i - 1, i * 13 % 1000, i % 11,
+                 i - 1, i % 17);
+        if (i % 16 == 0) {
+            fprintf (src->stream, "var s%u = s%u + \"-\";\nvar w%u = (s%u == \"spark\") + v%u;\n",
+                     i / 16, i / 16 - 1, i / 16, i / 16, i);
+        }
+    }
+    fprintf (src->stream, "var result = v%u;\nprint result;\n", statements - 1);
+
+    spk_bench_source_end (src);
+}
+
+// Runs argv with stdout sent to out_fd, returns its exit status or -1
+static int
+spk_bench_spawn (char *const argv[], int out_fd)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init (&actions);
+    posix_spawn_file_actions_adddup2 (&actions, out_fd, STDOUT_FILENO);
+
+    pid_t pid;
+    int status = -1;
+    if (posix_spawnp (&pid, argv[0], &actions, nullptr, argv, environ) == 0 &&
+        waitpid (pid, &status, 0) == pid) {
+        status = WIFEXITED (status) ? WEXITSTATUS (status) : -1;
+    }
+
+    posix_spawn_file_actions_destroy (&actions);
+    return status;
+}
+
+// Stdout goes to null_fd while the engines print
+static double
+spk_bench_engine (const spk_bench_engine_t *engine, const spk_bench_source_t *src,
+                  uint32_t runs, bool compile_each, int null_fd, int32_t *result)
+{
+    spk_program_options_t options;
+    spk_program_options_init (&options);
+    options.engine = engine->engine;
+
+    fflush (stdout);
+    int saved_fd = dup (STDOUT_FILENO);
+    dup2 (null_fd, STDOUT_FILENO);
+
+    spk_program_t *program = nullptr;
+    bool ok = true;
+    double start = spk_bench_now ();
+
+    for (uint32_t i = 0; i < runs && ok; ++i) {
+        if (!program) {
+            program = spk_program_compile (src->data, src->size, &options);
+        }
+
+        ok = program && spk_program_run (program, nullptr) &&
+             spk_program_get_int (program, "result", result);
+
+        if (program && compile_each) {
+            spk_program_free (program);
+            program = nullptr;
+        }
+    }
+
+    double elapsed = spk_bench_now () - start;
+    if (program) {
+        spk_program_free (program);
+    }
+
+    fflush (stdout);
+    dup2 (saved_fd, STDOUT_FILENO);
+    close (saved_fd);
+    return ok ? elapsed : -1.0;
+}
+
+typedef struct spk_bench_backend_s {
+    const char *name;
+    const char *extension;
+    const char *cc_flag;
+    const char *runtime; // Library the output links with, if any
+    bool (*emit) (const spk_program_t *program, const char *path);
+} spk_bench_backend_t;
+
+static const spk_bench_backend_t spk_bench_backends[] = {
+    { "asm", "s", "-O0", SPK_BENCH_RUNTIME, spk_program_emit_asm },
+    { "c", "c", "-O2", nullptr, spk_program_emit_c },
+};
+
+// Emits and builds the executable, returns the build time or a negative value
+static double
+spk_bench_build (const spk_bench_backend_t *backend, const spk_bench_source_t *src,
+                 const char *emit_path, const char *exe_path)
+{
+    spk_program_options_t options;
+    spk_program_options_init (&options);
+    options.engine = SPK_ENGINE_AST;
+
+    double start = spk_bench_now ();
+
+    auto program = spk_program_compile (src->data, src->size, &options);
+    bool ok = program && backend->emit (program, emit_path);
+    if (program) {
+        spk_program_free (program);
+    }
+
+    char *argv[] = { "cc", (char *)backend->cc_flag, "-o", (char *)exe_path, (char *)emit_path,
+                     (char *)backend->runtime, nullptr };
+    ok = ok && spk_bench_spawn (argv, STDOUT_FILENO) == 0;
+    return ok ? spk_bench_now () - start : -1.0;
+}
+
+// Checks what the executable prints against the engines' result
+static bool
+spk_bench_check_native (const char *exe_path, const char *out_path, int32_t expected)
+{
+    int fd = open (out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    char *argv[] = { (char *)exe_path, nullptr };
+    bool ok = fd >= 0 && spk_bench_spawn (argv, fd) == 0;
+    if (fd >= 0) {
+        close (fd);
+    }
+
+    int32_t printed = 0;
+    auto file = fopen (out_path, "r");
+    ok = ok && file && fscanf (file, "%d", &printed) == 1 && printed == expected;
+    if (file) {
+        fclose (file);
+    }
+
+    return ok;
+}
+
+static bool
+spk_bench_run_engines (const spk_bench_source_t *src, uint32_t runs, int null_fd,
+                       int32_t *expected)
+{
+    for (size_t i = 0; i < sizeof (spk_bench_engines) / sizeof (spk_bench_engines[0]); ++i) {
+        auto engine = &spk_bench_engines[i];
+        int32_t result;
+
+        double each = spk_bench_engine (engine, src, runs, true, null_fd, &result);
+        double once = spk_bench_engine (engine, src, runs, false, null_fd, &result);
+        if (each < 0.0 || once < 0.0 || (i > 0 && result != *expected)) {
+            printf ("%s failed to run the script\n", engine->name);
+            return false;
+        }
+
+        *expected = result;
+        printf ("%-8s %-7s %14.1f\n", engine->name, "source", each * 1e6 / runs);
+        printf ("%-8s %-7s %14.1f\n", engine->name, "once", once * 1e6 / runs);
+    }
+
+    return true;
+}
+
+static bool
+spk_bench_run_native (const spk_bench_backend_t *backend, const spk_bench_source_t *src,
+                      const char *dir, uint32_t runs, int null_fd, int32_t expected)
+{
+    char emit_path[64], exe_path[64], out_path[64];
+    snprintf (emit_path, sizeof (emit_path), "%s/bench.%s", dir, backend->extension);
+    snprintf (exe_path, sizeof (exe_path), "%s/bench", dir);
+    snprintf (out_path, sizeof (out_path), "%s/out.txt", dir);
+
+    double build = spk_bench_build (backend, src, emit_path, exe_path);
+    bool ok = build >= 0.0 && spk_bench_check_native (exe_path, out_path, expected);
+
+    if (ok) {
+        char *exe_argv[] = { exe_path, nullptr };
+        double start = spk_bench_now ();
+        for (uint32_t i = 0; i < runs; ++i) {
+            spk_bench_spawn (exe_argv, null_fd);
+        }
+        double elapsed = spk_bench_now () - start;
+
+        printf ("%-8s %-7s %14.1f  (built in %.0f ms)\n", backend->name, "process",
+                elapsed * 1e6 / runs, build * 1e3);
+    } else {
+        printf ("%s failed to build or returned a wrong result\n", backend->name);
+    }
+
+    remove (out_path);
+    remove (exe_path);
+    remove (emit_path);
+    return ok;
+}
+
+// A process that does nothing, what starting an executable costs
+static void
+spk_bench_run_startup (uint32_t runs, int null_fd)
+{
+    char *argv[] = { "true", nullptr };
+    double start = spk_bench_now ();
+    for (uint32_t i = 0; i < runs; ++i) {
+        spk_bench_spawn (argv, null_fd);
+    }
+    double elapsed = spk_bench_now () - start;
+
+    printf ("%-8s %-7s %14.1f\n", "true", "process", elapsed * 1e6 / runs);
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t runs = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 200;
+    uint32_t statements = argc > 2 ? (uint32_t)strtoul (argv[2], nullptr, 10) : 5000;
+    if (runs == 0) {
+        runs = 1;
+    }
+    if (statements == 0) {
+        statements = 1;
+    }
+
+    char dir[] = "/tmp/spk-bench-native-XXXXXX";
+    if (!mkdtemp (dir)) {
+        printf ("Failed creating a temporary directory\n");
+        return EXIT_FAILURE;
+    }
+
+    spk_bench_source_t src;
+    spk_bench_generate (&src, statements);
+    int null_fd = open ("/dev/null", O_WRONLY);
+
+    printf ("%u runs of %u statements\n\n", runs, statements);
+    printf ("%-16s %14s\n", "", "us/run");
+
+    int32_t expected = 0;
+    bool ok = spk_bench_run_engines (&src, runs, null_fd, &expected);
+    for (size_t i = 0; i < sizeof (spk_bench_backends) / sizeof (spk_bench_backends[0]) && ok; ++i) {
+        ok = spk_bench_run_native (&spk_bench_backends[i], &src, dir, runs, null_fd, expected);
+    }
+
+    if (ok) {
+        spk_bench_run_startup (runs, null_fd);
+    }
+
+    close (null_fd);
+    remove (dir);
+    free (src.data);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
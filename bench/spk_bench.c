@@ -0,0 +1,527 @@
+#include "bench_common.h"
+#include "workloads.h"
+
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/optimizer.h"
+#include "interpreter/statements.h"
+#include "interpreter/ast_interpreter.h"
+#include "interpreter/context.h"
+#include "interpreter/bytecode.h"
+#include "interpreter/compiler.h"
+#include "interpreter/vm.h"
+#include "interpreter/closure.h"
+#include "utils/arena.h"
+#include "utils/file.h"
+
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ The benchmark suite: times every phase of running a script separately,
+ over repeated runs of each synthetic workload (see workloads.h).
+
+   read     spk_read_file of the script written to a temporary file
+   lex      spk_tokenize_source
+   parse    spk_parser_recursive_descent
+   check    resolving, type checking, -O1 and building the engine's program
+   execute  running it, with stdout sent to /dev/null
+
+ Every phase reports the median, 90th and 99th percentile of its run
+ times, and MB/s, tokens/s, nodes/s and statements/s at the median.
+ --json prints the same as one JSON document, to compare across
+ releases.
+
+ Usage: spk-bench [--runs=<n>] [--size=<MB>] [--engine=<ast|vm|closure>] [--json]
+                  [--generate=<dir>] [workload ...]
+
+ --generate writes the workloads to <dir>/<workload>.spk for spk-interp
+ and exits.
+*/
+
+typedef enum {
+    SPK_BENCH_PHASE_READ,
+    SPK_BENCH_PHASE_LEX,
+    SPK_BENCH_PHASE_PARSE,
+    SPK_BENCH_PHASE_CHECK,
+    SPK_BENCH_PHASE_EXECUTE,
+
+    SPK_BENCH_PHASE_COUNT
+} SPK_bench_phase;
+
+static const char *spk_bench_phase_names[SPK_BENCH_PHASE_COUNT] = {
+    [SPK_BENCH_PHASE_READ] = "read",
+    [SPK_BENCH_PHASE_LEX] = "lex",
+    [SPK_BENCH_PHASE_PARSE] = "parse",
+    [SPK_BENCH_PHASE_CHECK] = "check",
+    [SPK_BENCH_PHASE_EXECUTE] = "execute",
+};
+
+typedef enum {
+    SPK_BENCH_ENGINE_AST,
+    SPK_BENCH_ENGINE_VM,
+    SPK_BENCH_ENGINE_CLOSURE,
+
+    SPK_BENCH_ENGINE_COUNT
+} SPK_bench_engine;
+
+static const char *spk_bench_engine_names[SPK_BENCH_ENGINE_COUNT] = {
+    [SPK_BENCH_ENGINE_AST] = "ast",
+    [SPK_BENCH_ENGINE_VM] = "vm",
+    [SPK_BENCH_ENGINE_CLOSURE] = "closure",
+};
+
+typedef struct spk_bench_options_s {
+    uint32_t         runs;
+    size_t           bytes;
+    SPK_bench_engine engine;
+    bool             json;
+    const char       *generate_dir;
+    bool             selected[SPK_BENCH_WORKLOAD_COUNT];
+} spk_bench_options_t;
+
+// What one workload amounts to, the same on every run
+typedef struct spk_bench_counts_s {
+    size_t bytes;
+    size_t tokens;
+    size_t nodes;
+    size_t statements;
+} spk_bench_counts_t;
+
+typedef struct spk_bench_result_s {
+    spk_bench_counts_t counts;
+    double             *samples[SPK_BENCH_PHASE_COUNT]; // Seconds, one per run
+} spk_bench_result_t;
+
+typedef struct spk_bench_summary_s {
+    double min;
+    double median;
+    double p90;
+    double p99;
+    double max;
+} spk_bench_summary_t;
+
+static size_t
+spk_bench_count_nodes (const spk_expr_t *expr)
+{
+    if (!expr) {
+        return 0;
+    }
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_GROUPING:
+            return 1 + spk_bench_count_nodes (expr->grouping.expr);
+        case SPK_EXPR_TYPE_UNARY:
+            return 1 + spk_bench_count_nodes (expr->unary.right);
+        case SPK_EXPR_TYPE_BINARY:
+            return 1 + spk_bench_count_nodes (expr->binary.left) +
+                   spk_bench_count_nodes (expr->binary.right);
+        default:
+            return 1;
+    }
+}
+
+// Statements count as nodes too
+static size_t
+spk_bench_count_statement_nodes (darray_t *statements)
+{
+    size_t nodes = statements->count;
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_statement_t *stmt = darray_elem (statements, i);
+        switch (stmt->type) {
+            case SPK_STATEMENT_TYPE_EXPR:
+                nodes += spk_bench_count_nodes (stmt->expr.expr);
+                break;
+            case SPK_STATEMENT_TYPE_PRINT:
+                nodes += spk_bench_count_nodes (stmt->print.expr);
+                break;
+            case SPK_STATEMENT_TYPE_VAR:
+                nodes += spk_bench_count_nodes (stmt->var.initializer);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return nodes;
+}
+
+// Runs every phase once, stores how long each took at samples[phase][run]
+static bool
+spk_bench_run_once (const spk_bench_options_t *options, const char *path, uint32_t run,
+                    spk_bench_result_t *result, int null_fd)
+{
+    double *samples[SPK_BENCH_PHASE_COUNT];
+    for (uint32_t phase = 0; phase < SPK_BENCH_PHASE_COUNT; ++phase) {
+        samples[phase] = &result->samples[phase][run];
+    }
+
+    double start = spk_bench_now ();
+    auto file = spk_read_file (path);
+    *samples[SPK_BENCH_PHASE_READ] = spk_bench_now () - start;
+    if (!file.data) {
+        return false;
+    }
+
+    auto context = spk_context_create ();
+    start = spk_bench_now ();
+    auto tokens = spk_tokenize_source (file.data, file.size, context->symbols);
+    *samples[SPK_BENCH_PHASE_LEX] = spk_bench_now () - start;
+
+    spk_arena_t arena;
+    spk_arena_init (&arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    darray_t *statements = nullptr;
+    spk_chunk_t *chunk = nullptr;
+    spk_closure_program_t *closure = nullptr;
+
+    bool ok = tokens != nullptr;
+    if (ok) {
+        start = spk_bench_now ();
+        statements = spk_parser_recursive_descent (tokens, &arena);
+        *samples[SPK_BENCH_PHASE_PARSE] = spk_bench_now () - start;
+        ok = statements != nullptr;
+        if (!ok) {
+            spk_token_list_free (tokens);
+        }
+    }
+
+    if (ok) {
+        result->counts = (spk_bench_counts_t) {
+            .bytes = file.size,
+            .tokens = tokens->tokens.count,
+            .nodes = spk_bench_count_statement_nodes (statements),
+            .statements = statements->count
+        };
+        spk_token_list_free (tokens);
+
+        start = spk_bench_now ();
+        ok = spk_resolve_statements (statements) && spk_typecheck_statements (statements);
+        if (ok) {
+            spk_optimize_statements (statements, SPK_OPT_LEVEL_MAX);
+            if (options->engine == SPK_BENCH_ENGINE_VM) {
+                chunk = spk_compile_statements (statements);
+                ok = chunk != nullptr;
+            } else if (options->engine == SPK_BENCH_ENGINE_CLOSURE) {
+                closure = spk_closure_compile (statements);
+                ok = closure != nullptr;
+            }
+        }
+        *samples[SPK_BENCH_PHASE_CHECK] = spk_bench_now () - start;
+    }
+
+    if (ok) {
+        fflush (stdout);
+        int saved_fd = dup (STDOUT_FILENO);
+        dup2 (null_fd, STDOUT_FILENO);
+
+        start = spk_bench_now ();
+        switch (options->engine) {
+            case SPK_BENCH_ENGINE_AST:
+                for (size_t i = 0; i < statements->count; ++i) {
+                    spk_interpret_statement (context, darray_elem (statements, i));
+                }
+                break;
+            case SPK_BENCH_ENGINE_VM:
+                ok = spk_vm_run (chunk) == SPK_VM_RESULT_OK;
+                break;
+            case SPK_BENCH_ENGINE_CLOSURE:
+                ok = spk_closure_run (closure);
+                break;
+            default:
+                break;
+        }
+        fflush (stdout);
+        *samples[SPK_BENCH_PHASE_EXECUTE] = spk_bench_now () - start;
+
+        dup2 (saved_fd, STDOUT_FILENO);
+        close (saved_fd);
+    }
+
+    if (chunk) {
+        spk_chunk_free (chunk);
+    }
+
+    if (closure) {
+        spk_closure_program_free (closure);
+    }
+
+    // Globals can hold literals from the arena
+    spk_context_free (context);
+    if (statements) {
+        darray_free (statements);
+    }
+
+    spk_arena_release (&arena);
+    free (file.data);
+    return ok;
+}
+
+static int
+spk_bench_compare_double (const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+static double
+spk_bench_percentile (const double *sorted, uint32_t count, uint32_t percent)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static spk_bench_summary_t
+spk_bench_summarize (double *samples, uint32_t count)
+{
+    qsort (samples, count, sizeof (double), spk_bench_compare_double);
+
+    return (spk_bench_summary_t) {
+        .min = samples[0],
+        .median = spk_bench_percentile (samples, count, 50),
+        .p90 = spk_bench_percentile (samples, count, 90),
+        .p99 = spk_bench_percentile (samples, count, 99),
+        .max = samples[count - 1]
+    };
+}
+
+static double
+spk_bench_rate (size_t amount, double seconds)
+{
+    return seconds > 0.0 ? (double)amount / seconds : 0.0;
+}
+
+static void
+spk_bench_print_table (const char *name, const spk_bench_result_t *result,
+                       const spk_bench_summary_t summaries[SPK_BENCH_PHASE_COUNT])
+{
+    auto counts = &result->counts;
+    printf ("%s: %.2f MB, %zu tokens, %zu nodes, %zu statements\n", name,
+            (double)counts->bytes / 1e6, counts->tokens, counts->nodes, counts->statements);
+    printf ("  %-8s %10s %10s %10s %9s %11s %11s %11s\n", "phase", "median ms", "p90 ms",
+            "p99 ms", "MB/s", "Mtokens/s", "Mnodes/s", "Mstmts/s");
+
+    for (uint32_t phase = 0; phase < SPK_BENCH_PHASE_COUNT; ++phase) {
+        auto summary = &summaries[phase];
+        printf ("  %-8s %10.3f %10.3f %10.3f %9.1f %11.2f %11.2f %11.2f\n",
+                spk_bench_phase_names[phase], summary->median * 1e3, summary->p90 * 1e3,
+                summary->p99 * 1e3, spk_bench_rate (counts->bytes, summary->median) / 1e6,
+                spk_bench_rate (counts->tokens, summary->median) / 1e6,
+                spk_bench_rate (counts->nodes, summary->median) / 1e6,
+                spk_bench_rate (counts->statements, summary->median) / 1e6);
+    }
+
+    printf ("\n");
+}
+
+static void
+spk_bench_print_json (const char *name, const spk_bench_result_t *result,
+                      const spk_bench_summary_t summaries[SPK_BENCH_PHASE_COUNT], bool first)
+{
+    auto counts = &result->counts;
+    printf ("%s\n    {\n", first ? "" : ",");
+    printf ("      \"name\": \"%s\",\n", name);
+    printf ("      \"bytes\": %zu,\n      \"tokens\": %zu,\n      \"nodes\": %zu,\n"
+            "      \"statements\": %zu,\n", counts->bytes, counts->tokens, counts->nodes,
+            counts->statements);
+    printf ("      \"phases\": {");
+
+    for (uint32_t phase = 0; phase < SPK_BENCH_PHASE_COUNT; ++phase) {
+        auto summary = &summaries[phase];
+        printf ("%s\n        \"%s\": {\n", phase == 0 ? "" : ",", spk_bench_phase_names[phase]);
+        printf ("          \"min_ns\": %.0f,\n          \"median_ns\": %.0f,\n"
+                "          \"p90_ns\": %.0f,\n          \"p99_ns\": %.0f,\n"
+                "          \"max_ns\": %.0f,\n",
+                summary->min * 1e9, summary->median * 1e9, summary->p90 * 1e9,
+                summary->p99 * 1e9, summary->max * 1e9);
+        printf ("          \"mb_per_s\": %.3f,\n          \"tokens_per_s\": %.0f,\n"
+                "          \"nodes_per_s\": %.0f,\n          \"statements_per_s\": %.0f\n"
+                "        }",
+                spk_bench_rate (counts->bytes, summary->median) / 1e6,
+                spk_bench_rate (counts->tokens, summary->median),
+                spk_bench_rate (counts->nodes, summary->median),
+                spk_bench_rate (counts->statements, summary->median));
+    }
+
+    printf ("\n      }\n    }");
+}
+
+static bool
+spk_bench_write_file (const char *path, const spk_bench_source_t *src)
+{
+    auto file = fopen (path, "w");
+    if (!file) {
+        fprintf (stderr, "Failed opening '%s' for writing\n", path);
+        return false;
+    }
+
+    bool ok = fwrite (src->data, 1, src->size, file) == src->size;
+    ok = fclose (file) == 0 && ok;
+    if (!ok) {
+        fprintf (stderr, "Failed writing '%s'\n", path);
+    }
+
+    return ok;
+}
+
+static bool
+spk_bench_workload (const spk_bench_options_t *options, const spk_bench_workload_t *workload,
+                    const char *dir, int null_fd, bool first)
+{
+    spk_bench_source_t src;
+    spk_bench_build_workload (workload, &src, options->bytes);
+
+    char path[PATH_MAX];
+    snprintf (path, sizeof (path), "%s/%s.spk", dir, workload->name);
+    bool ok = spk_bench_write_file (path, &src);
+    free (src.data);
+
+    if (!ok || options->generate_dir) {
+        return ok;
+    }
+
+    spk_bench_result_t result = {};
+    for (uint32_t phase = 0; phase < SPK_BENCH_PHASE_COUNT; ++phase) {
+        result.samples[phase] = calloc (options->runs, sizeof (double));
+    }
+
+    for (uint32_t run = 0; run < options->runs && ok; ++run) {
+        ok = spk_bench_run_once (options, path, run, &result, null_fd);
+    }
+
+    if (ok) {
+        spk_bench_summary_t summaries[SPK_BENCH_PHASE_COUNT];
+        for (uint32_t phase = 0; phase < SPK_BENCH_PHASE_COUNT; ++phase) {
+            summaries[phase] = spk_bench_summarize (result.samples[phase], options->runs);
+        }
+
+        if (options->json) {
+            spk_bench_print_json (workload->name, &result, summaries, first);
+        } else {
+            spk_bench_print_table (workload->name, &result, summaries);
+        }
+    } else {
+        // stdout may be a --json document
+        fprintf (stderr, "%s failed to run\n", workload->name);
+    }
+
+    for (uint32_t phase = 0; phase < SPK_BENCH_PHASE_COUNT; ++phase) {
+        free (result.samples[phase]);
+    }
+
+    remove (path);
+    return ok;
+}
+
+static bool
+spk_bench_parse_options (int argc, char **argv, spk_bench_options_t *options)
+{
+    bool any_selected = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+
+        if (strncmp (arg, "--runs=", 7) == 0) {
+            options->runs = (uint32_t)strtoul (arg + 7, nullptr, 10);
+        } else if (strncmp (arg, "--size=", 7) == 0) {
+            options->bytes = (size_t)(strtod (arg + 7, nullptr) * 1e6);
+        } else if (strncmp (arg, "--engine=", 9) == 0) {
+            uint32_t engine = 0;
+            while (engine < SPK_BENCH_ENGINE_COUNT &&
+                   strcmp (arg + 9, spk_bench_engine_names[engine]) != 0) {
+                ++engine;
+            }
+
+            if (engine == SPK_BENCH_ENGINE_COUNT) {
+                printf ("Unknown engine '%s'\n", arg + 9);
+                return false;
+            }
+            options->engine = (SPK_bench_engine)engine;
+        } else if (strcmp (arg, "--json") == 0) {
+            options->json = true;
+        } else if (strncmp (arg, "--generate=", 11) == 0 && arg[11]) {
+            options->generate_dir = arg + 11;
+        } else {
+            uint32_t workload = 0;
+            while (workload < SPK_BENCH_WORKLOAD_COUNT &&
+                   strcmp (arg, spk_bench_workloads[workload].name) != 0) {
+                ++workload;
+            }
+
+            if (workload == SPK_BENCH_WORKLOAD_COUNT) {
+                printf ("Unknown option or workload '%s'\n", arg);
+                return false;
+            }
+            options->selected[workload] = true;
+            any_selected = true;
+        }
+    }
+
+    for (uint32_t i = 0; i < SPK_BENCH_WORKLOAD_COUNT && !any_selected; ++i) {
+        options->selected[i] = true;
+    }
+
+    return options->runs > 0 && options->bytes > 0;
+}
+
+int
+main (int argc, char **argv)
+{
+    spk_bench_options_t options = {
+        .runs = 10,
+        .bytes = 2000000,
+        .engine = SPK_BENCH_ENGINE_AST
+    };
+
+    if (!spk_bench_parse_options (argc, argv, &options)) {
+        printf ("Usage: spk-bench [--runs=<n>] [--size=<MB>] [--engine=<ast|vm|closure>] [--json]\n"
+                "                 [--generate=<dir>] [workload ...]\n");
+        return EXIT_FAILURE;
+    }
+
+    // Workloads go through a file, reading it is one of the phases
+    char tmp_dir[] = "/tmp/spk-bench-XXXXXX";
+    const char *dir = options.generate_dir;
+    if (!dir) {
+        dir = mkdtemp (tmp_dir);
+        if (!dir) {
+            printf ("Failed creating a temporary directory\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    int null_fd = open ("/dev/null", O_WRONLY);
+    if (options.json) {
+        printf ("{\n  \"runs\": %u,\n  \"size_bytes\": %zu,\n  \"engine\": \"%s\",\n"
+                "  \"workloads\": [", options.runs, options.bytes,
+                spk_bench_engine_names[options.engine]);
+    } else if (!options.generate_dir) {
+        printf ("%u runs per workload, %s engine\n\n", options.runs,
+                spk_bench_engine_names[options.engine]);
+    }
+
+    bool ok = true;
+    bool first = true;
+    for (uint32_t i = 0; i < SPK_BENCH_WORKLOAD_COUNT && ok; ++i) {
+        if (options.selected[i]) {
+            ok = spk_bench_workload (&options, &spk_bench_workloads[i], dir, null_fd, first);
+            first = false;
+        }
+    }
+
+    if (options.json) {
+        printf ("\n  ]\n}\n");
+    }
+
+    close (null_fd);
+    if (!options.generate_dir) {
+        remove (dir);
+    }
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
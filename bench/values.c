@@ -0,0 +1,260 @@
+#include "bench_common.h"
+
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/bytecode.h"
+#include "interpreter/compiler.h"
+#include "interpreter/value.h"
+#include "utils/arena.h"
+
+#include <inttypes.h>
+
+/*
+ Compares the lexer's 16-byte tagged union, which the engines used to run
+ on, with the 8-byte spk_value_t on arithmetic- and variable-heavy scripts.
+
+ Usage: spk-bench-values [size] [seconds]
+
+ size is the statement count of the arithmetic script and the number of
+ globals of the variable one.
+
+ Both layouts run the same compiled chunk through the same stack machine
+ (values_loop.h), only the value type differs. Checksums of every printed
+ and popped value have to match before the timings mean anything.
+*/
+
+typedef enum {
+    SPK_BENCH_LAYOUT_LITERAL,
+    SPK_BENCH_LAYOUT_VALUE,
+
+    SPK_BENCH_LAYOUT_COUNT
+} SPK_bench_layout;
+
+static const char *spk_bench_layout_names[SPK_BENCH_LAYOUT_COUNT] = {
+    [SPK_BENCH_LAYOUT_LITERAL] = "literal",
+    [SPK_BENCH_LAYOUT_VALUE] = "value",
+};
+
+static const size_t spk_bench_layout_sizes[SPK_BENCH_LAYOUT_COUNT] = {
+    [SPK_BENCH_LAYOUT_LITERAL] = sizeof (spk_token_literal_t),
+    [SPK_BENCH_LAYOUT_VALUE] = sizeof (spk_value_t),
+};
+
+static inline spk_token_literal_t
+spk_bench_literal_int (int32_t value)
+{
+    return (spk_token_literal_t) {
+        .type = SPK_TOKEN_LITERAL_INTEGER,
+        .integer = { value }
+    };
+}
+
+#define SPK_BENCH_LOOP_FN spk_bench_loop_literal
+#define SPK_BENCH_VALUE_T spk_token_literal_t
+#define SPK_BENCH_NIL() ((spk_token_literal_t) { .type = SPK_TOKEN_LITERAL_EMPTY })
+#define SPK_BENCH_INT(i) spk_bench_literal_int (i)
+#define SPK_BENCH_AS_INT(v) ((v).integer.value)
+#include "values_loop.h"
+#undef SPK_BENCH_AS_INT
+#undef SPK_BENCH_INT
+#undef SPK_BENCH_NIL
+#undef SPK_BENCH_VALUE_T
+#undef SPK_BENCH_LOOP_FN
+
+#define SPK_BENCH_LOOP_FN spk_bench_loop_value
+#define SPK_BENCH_VALUE_T spk_value_t
+#define SPK_BENCH_NIL() spk_value_nil ()
+#define SPK_BENCH_INT(i) spk_value_int (i)
+#define SPK_BENCH_AS_INT(v) spk_value_as_int (v)
+#include "values_loop.h"
+#undef SPK_BENCH_AS_INT
+#undef SPK_BENCH_INT
+#undef SPK_BENCH_NIL
+#undef SPK_BENCH_VALUE_T
+#undef SPK_BENCH_LOOP_FN
+
+typedef enum {
+    SPK_BENCH_WORKLOAD_ARITHMETIC,
+    SPK_BENCH_WORKLOAD_VARIABLES,
+
+    SPK_BENCH_WORKLOAD_COUNT
+} SPK_bench_workload;
+
+static const char *spk_bench_workload_names[SPK_BENCH_WORKLOAD_COUNT] = {
+    [SPK_BENCH_WORKLOAD_ARITHMETIC] = "arithmetic",
+    [SPK_BENCH_WORKLOAD_VARIABLES] = "variables",
+};
+
+// Deep expressions on constants, the stack does all the work
+static void
+spk_bench_build_arithmetic (spk_bench_source_t *src, uint32_t statements)
+{
+    spk_bench_source_begin (src);
+
+    for (uint32_t i = 0; i < statements; ++i) {
+        fprintf (src->stream,
+                 "((%u + %u) * (%u - %u) / %u + -%u) * ((%u + 1) < (%u * 2)) - %u;\n",
+                 i % 97, i % 13, i % 41, i % 7, i % 5 + 1, i % 11,
+                 i % 23, i % 29, i % 3);
+    }
+
+    spk_bench_source_end (src);
+}
+
+// Every global is defined from earlier ones and then read back at random,
+// the global slots are what doesn't fit in the cache
+static void
+spk_bench_build_variables (spk_bench_source_t *src, uint32_t globals)
+{
+    spk_bench_source_begin (src);
+
+    fprintf (src->stream, "var v0 = 1;\n");
+    for (uint32_t i = 1; i < globals; ++i) {
+        fprintf (src->stream, "var v%u = v%u + %u;\n", i, i / 2, i % 100);
+    }
+
+    uint32_t state = 0x9e3779b9;
+    for (uint32_t i = 0; i < globals; ++i) {
+        uint32_t slots[4];
+        for (uint32_t s = 0; s < 4; ++s) {
+            state = state * 1664525u + 1013904223u;
+            slots[s] = (state >> 8) % globals;
+        }
+        fprintf (src->stream, "print v%u + v%u * v%u - v%u;\n",
+                 slots[0], slots[1], slots[2], slots[3]);
+    }
+
+    spk_bench_source_end (src);
+}
+
+static spk_chunk_t *
+spk_bench_compile (const spk_bench_source_t *src)
+{
+    spk_arena_t arena;
+    spk_arena_init (&arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    auto symbols = spk_symbol_table_create ();
+
+    auto tokens = spk_tokenize_source (src->data, src->size, symbols);
+    auto statements = spk_parser_recursive_descent (tokens, &arena);
+    auto chunk = spk_resolve_statements (statements) &&
+                 spk_typecheck_statements (statements) ?
+                 spk_compile_statements (statements) :
+                 nullptr;
+
+    darray_free (statements);
+    spk_token_list_free (tokens);
+    spk_arena_release (&arena);
+    spk_symbol_table_free (symbols);
+    return chunk;
+}
+
+static uint64_t
+spk_bench_execute (SPK_bench_layout layout, const spk_chunk_t *chunk, const void *constants)
+{
+    switch (layout) {
+        case SPK_BENCH_LAYOUT_LITERAL:
+            return spk_bench_loop_literal (chunk, constants);
+        case SPK_BENCH_LAYOUT_VALUE:
+            return spk_bench_loop_value (chunk, constants);
+        default:
+            abort ();
+    }
+}
+
+// Returns the time per run
+static double
+spk_bench_run (SPK_bench_layout layout, const spk_chunk_t *chunk,
+               const void *constants, double seconds, uint64_t *checksum)
+{
+    // Warm up caches and the branch predictor
+    *checksum = spk_bench_execute (layout, chunk, constants);
+
+    uint64_t runs = 0;
+    double start = spk_bench_now ();
+    double elapsed = 0.0;
+    do {
+        (void)spk_bench_execute (layout, chunk, constants);
+        ++runs;
+        elapsed = spk_bench_now () - start;
+    } while (elapsed < seconds);
+
+    return elapsed / (double)runs;
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t size = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 65536;
+    double seconds = argc > 2 ? strtod (argv[2], nullptr) : 1.0;
+
+    // Global slots are u16 operands in the bytecode
+    if (size == 0 || size > UINT16_MAX + 1) {
+        size = UINT16_MAX + 1;
+    }
+
+    printf ("%-11s %-8s %6s %10s %10s %12s %9s\n",
+            "workload", "layout", "bytes", "instrs", "KiB/run", "ns/instr", "speedup");
+
+    for (uint32_t w = 0; w < SPK_BENCH_WORKLOAD_COUNT; ++w) {
+        spk_bench_source_t src;
+        if (w == SPK_BENCH_WORKLOAD_ARITHMETIC) {
+            spk_bench_build_arithmetic (&src, size);
+        } else {
+            spk_bench_build_variables (&src, size);
+        }
+
+        auto chunk = spk_bench_compile (&src);
+        free (src.data);
+        if (!chunk) {
+            printf ("Failed to compile the %s script\n", spk_bench_workload_names[w]);
+            return EXIT_FAILURE;
+        }
+
+        // The chunk holds spk_value_t constants, the literal layout gets a copy
+        size_t constant_count = chunk->constants->count;
+        const spk_value_t *values = chunk->constants->data;
+        spk_token_literal_t *literals = calloc (constant_count + 1, sizeof (spk_token_literal_t));
+        for (size_t i = 0; i < constant_count; ++i) {
+            literals[i] = spk_bench_literal_int (spk_value_as_int (values[i]));
+        }
+
+        const void *constants[SPK_BENCH_LAYOUT_COUNT] = {
+            [SPK_BENCH_LAYOUT_LITERAL] = literals,
+            [SPK_BENCH_LAYOUT_VALUE] = values,
+        };
+
+        size_t instructions = spk_chunk_instruction_count (chunk);
+        size_t slots = chunk->max_stack + chunk->global_count + constant_count;
+
+        double baseline = 0.0;
+        uint64_t expected = 0;
+        for (uint32_t l = 0; l < SPK_BENCH_LAYOUT_COUNT; ++l) {
+            uint64_t checksum;
+            double elapsed = spk_bench_run (l, chunk, constants[l], seconds, &checksum);
+
+            if (l == SPK_BENCH_LAYOUT_LITERAL) {
+                baseline = elapsed;
+                expected = checksum;
+            } else if (checksum != expected) {
+                printf ("%s computed a different checksum\n", spk_bench_layout_names[l]);
+                return EXIT_FAILURE;
+            }
+
+            printf ("%-11s %-8s %6zu %10zu %10.1f %12.2f %8.2fx\n",
+                    spk_bench_workload_names[w],
+                    spk_bench_layout_names[l],
+                    spk_bench_layout_sizes[l],
+                    instructions,
+                    (double)(slots * spk_bench_layout_sizes[l]) / 1024.0,
+                    elapsed / (double)instructions * 1e9,
+                    baseline / elapsed);
+        }
+
+        free (literals);
+        spk_chunk_free (chunk);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+// Stack machine loop shared by every value layout in values.c.
+// Not a regular header: values.c includes it once per layout after defining
+//  - SPK_BENCH_LOOP_FN    name of the generated function
+//  - SPK_BENCH_VALUE_T    the value type kept on the stack and in globals
+//  - SPK_BENCH_NIL()      a nil value
+//  - SPK_BENCH_INT(i)     an int value
+//  - SPK_BENCH_AS_INT(v)  the int held by a value, without checking its tag
+//
+// It runs the opcodes the compiler emits without the peephole pass and
+// folds printed and popped values into a checksum instead of printing them.
+
+static uint64_t
+SPK_BENCH_LOOP_FN (const spk_chunk_t *chunk, const SPK_BENCH_VALUE_T *constants)
+{
+    SPK_BENCH_VALUE_T *stack = calloc (chunk->max_stack + 1, sizeof (SPK_BENCH_VALUE_T));
+    SPK_BENCH_VALUE_T *globals = calloc (chunk->global_count + 1, sizeof (SPK_BENCH_VALUE_T));
+
+    const uint8_t *ip = chunk->code->data;
+    SPK_BENCH_VALUE_T *sp = stack;
+    uint64_t checksum = 0;
+
+#define SPK_BENCH_BINARY_OP(op) do { \
+        int32_t _right = SPK_BENCH_AS_INT (*--sp); \
+        sp[-1] = SPK_BENCH_INT (SPK_BENCH_AS_INT (sp[-1]) op _right); \
+    } while (false)
+
+    for (;;) {
+        switch ((SPK_opcode)*ip++) {
+            case SPK_OP_CONSTANT:
+                *sp++ = constants[spk_read_u16 (ip)];
+                ip += 2;
+                break;
+            case SPK_OP_CONSTANT_LONG:
+                *sp++ = constants[spk_read_u32 (ip)];
+                ip += 4;
+                break;
+            case SPK_OP_NIL:
+                *sp++ = SPK_BENCH_NIL ();
+                break;
+            case SPK_OP_DEFINE_GLOBAL:
+                globals[spk_read_u16 (ip)] = *--sp;
+                ip += 2;
+                break;
+            case SPK_OP_GET_GLOBAL:
+                *sp++ = globals[spk_read_u16 (ip)];
+                ip += 2;
+                break;
+            case SPK_OP_NEGATE:
+                sp[-1] = SPK_BENCH_INT (-SPK_BENCH_AS_INT (sp[-1]));
+                break;
+            case SPK_OP_NOT:
+                sp[-1] = SPK_BENCH_INT (!SPK_BENCH_AS_INT (sp[-1]));
+                break;
+            case SPK_OP_ADD:           SPK_BENCH_BINARY_OP (+); break;
+            case SPK_OP_SUBTRACT:      SPK_BENCH_BINARY_OP (-); break;
+            case SPK_OP_MULTIPLY:      SPK_BENCH_BINARY_OP (*); break;
+            case SPK_OP_DIVIDE:        SPK_BENCH_BINARY_OP (/); break;
+            case SPK_OP_GREATER:       SPK_BENCH_BINARY_OP (>); break;
+            case SPK_OP_GREATER_EQUAL: SPK_BENCH_BINARY_OP (>=); break;
+            case SPK_OP_LESS:          SPK_BENCH_BINARY_OP (<); break;
+            case SPK_OP_LESS_EQUAL:    SPK_BENCH_BINARY_OP (<=); break;
+            case SPK_OP_EQUAL:         SPK_BENCH_BINARY_OP (==); break;
+            case SPK_OP_NOT_EQUAL:     SPK_BENCH_BINARY_OP (!=); break;
+            case SPK_OP_PRINT:
+            case SPK_OP_POP:
+                checksum = checksum * 31 + (uint32_t)SPK_BENCH_AS_INT (*--sp);
+                break;
+            case SPK_OP_RETURN:
+                free (stack);
+                free (globals);
+                return checksum;
+            default:
+                // Superinstructions never show up, the chunks aren't peephole optimized
+                abort ();
+        }
+    }
+
+#undef SPK_BENCH_BINARY_OP
+}
@@ -0,0 +1,139 @@
+#include "bench_common.h"
+
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/bytecode.h"
+#include "interpreter/compiler.h"
+#include "interpreter/peephole.h"
+#include "interpreter/vm.h"
+
+#include <string.h>
+#include <inttypes.h>
+
+/*
+ Reports VM instructions per second for every dispatch strategy compiled
+ into spk-core, with and without superinstructions.
+
+ Usage: spk-bench-dispatch [statements] [seconds]
+
+ Chunks are straight-line code, so every instruction in the chunk is
+ executed exactly once per run and the static count is the dynamic count.
+*/
+
+#define SPK_BENCH_GLOBALS 16
+
+static void
+spk_bench_build_source (spk_bench_source_t *src, uint32_t statements)
+{
+    spk_bench_source_begin (src);
+
+    for (uint32_t i = 0; i < SPK_BENCH_GLOBALS; ++i) {
+        fprintf (src->stream, "var g%u = %u;\n", i, i + 1);
+    }
+
+    // Mix of the shapes spk_evaluate_binary sees most: arithmetic on
+    // constants and globals, followed by a comparison
+    for (uint32_t i = 0; i < statements; ++i) {
+        uint32_t a = i % SPK_BENCH_GLOBALS;
+        uint32_t b = (i * 7 + 3) % SPK_BENCH_GLOBALS;
+        fprintf (src->stream,
+                 "(g%u + %u) * g%u - %u / 2 < g%u * 3 + 10;\n",
+                 a, i % 100, b, i % 50 + 1, (a + b) % SPK_BENCH_GLOBALS);
+    }
+
+    spk_bench_source_end (src);
+}
+
+static spk_chunk_t *
+spk_bench_compile (const spk_bench_source_t *src, bool peephole)
+{
+    spk_arena_t arena;
+    spk_arena_init (&arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    auto symbols = spk_symbol_table_create ();
+
+    auto tokens = spk_tokenize_source (src->data, src->size, symbols);
+    auto statements = spk_parser_recursive_descent (tokens, &arena);
+    auto chunk = spk_resolve_statements (statements) &&
+                 spk_typecheck_statements (statements) ?
+                 spk_compile_statements (statements) :
+                 nullptr;
+
+    if (chunk && peephole) {
+        spk_peephole_optimize (chunk);
+    }
+
+    darray_free (statements);
+    spk_token_list_free (tokens);
+    spk_arena_release (&arena);
+    spk_symbol_table_free (symbols);
+    return chunk;
+}
+
+static void
+spk_bench_run (const spk_chunk_t *chunk, SPK_vm_dispatch dispatch,
+               bool peephole, double seconds)
+{
+    size_t instructions = spk_chunk_instruction_count (chunk);
+
+    // Warm up caches and the branch predictor
+    (void)spk_vm_run_with_dispatch (chunk, dispatch);
+
+    uint64_t runs = 0;
+    double start = spk_bench_now ();
+    double elapsed = 0.0;
+    do {
+        (void)spk_vm_run_with_dispatch (chunk, dispatch);
+        ++runs;
+        elapsed = spk_bench_now () - start;
+    } while (elapsed < seconds);
+
+    double total = (double)instructions * (double)runs;
+    printf ("%-10s %-9s %12zu %10" PRIu64 " %14.2f %12.2f\n",
+            spk_vm_dispatch_str (dispatch),
+            peephole ? "on" : "off",
+            instructions,
+            runs,
+            total / elapsed / 1e6,
+            elapsed / (double)runs * 1e6);
+}
+
+int
+main (int argc, char **argv)
+{
+    uint32_t statements = argc > 1 ? (uint32_t)strtoul (argv[1], nullptr, 10) : 20000;
+    double seconds = argc > 2 ? strtod (argv[2], nullptr) : 1.0;
+
+    spk_bench_source_t src;
+    spk_bench_build_source (&src, statements);
+
+    spk_chunk_t *chunks[2] = {
+        spk_bench_compile (&src, false),
+        spk_bench_compile (&src, true)
+    };
+
+    if (!chunks[0] || !chunks[1]) {
+        printf ("Failed to compile benchmark source\n");
+        return EXIT_FAILURE;
+    }
+
+    printf ("%u statements, %zu bytes of source\n\n", statements, src.size);
+    printf ("%-10s %-9s %12s %10s %14s %12s\n",
+            "dispatch", "peephole", "instrs/run", "runs", "Minstrs/s", "us/run");
+
+    for (uint32_t d = 0; d < SPK_VM_DISPATCH_COUNT; ++d) {
+        SPK_vm_dispatch dispatch = d;
+        if (!spk_vm_dispatch_available (dispatch)) {
+            continue;
+        }
+
+        spk_bench_run (chunks[0], dispatch, false, seconds);
+        spk_bench_run (chunks[1], dispatch, true, seconds);
+    }
+
+    spk_chunk_free (chunks[0]);
+    spk_chunk_free (chunks[1]);
+    free (src.data);
+    return EXIT_SUCCESS;
+}
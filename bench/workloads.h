@@ -0,0 +1,132 @@
+#pragma once
+
+#include "lexer_corpus.h"
+
+/*
+ Large synthetic scripts for spk-bench, each stressing one part of the
+ pipeline. Every workload is a valid program for all engines: scripts
+ stop growing at SPK_BENCH_MAX_GLOBALS declarations, below the vm's
+ global slot limit, even if that leaves them under the requested size.
+
+   deep      statements nesting expressions 64 levels deep
+   globals   thousands of globals, each reading two earlier ones
+   strings   long string literals, concatenated and compared
+   comments  mostly comment lines with a few statements in between
+   prints    print statements of ints and strings
+*/
+
+#define SPK_BENCH_MAX_GLOBALS 60000
+#define SPK_BENCH_DEEP_DEPTH  64
+
+typedef void (*spk_bench_workload_fn_t) (spk_bench_source_t *src, size_t bytes);
+
+static inline bool
+spk_bench_workload_full (const spk_bench_source_t *src, size_t bytes, uint32_t globals)
+{
+    return (size_t)ftell (src->stream) >= bytes || globals >= SPK_BENCH_MAX_GLOBALS;
+}
+
+static inline void
+spk_bench_workload_deep (spk_bench_source_t *src, size_t bytes)
+{
+    // Every 4 levels scale by 3/4, values stay below a few hundred
+    static const char *operators[] = { " + 7)", " * 3)", " - 11)", " / 4)" };
+
+    fprintf (src->stream, "var d0 = 1;\n");
+    for (uint32_t i = 1; !spk_bench_workload_full (src, bytes, i); ++i) {
+        fprintf (src->stream, "var d%u = ", i);
+        for (uint32_t depth = 0; depth < SPK_BENCH_DEEP_DEPTH; ++depth) {
+            fputc ('(', src->stream);
+        }
+
+        fprintf (src->stream, "d%u", i - 1);
+        for (uint32_t depth = 0; depth < SPK_BENCH_DEEP_DEPTH; ++depth) {
+            fputs (operators[(i + depth) % 4], src->stream);
+        }
+        fprintf (src->stream, ";\n");
+    }
+}
+
+static inline void
+spk_bench_workload_globals (spk_bench_source_t *src, size_t bytes)
+{
+    uint32_t state = 0x1b873593;
+
+    fprintf (src->stream, "var global_0 = 1;\n");
+    for (uint32_t i = 1; !spk_bench_workload_full (src, bytes, i); ++i) {
+        uint32_t a = spk_bench_rand (&state) % i;
+        uint32_t b = spk_bench_rand (&state) % i;
+        fprintf (src->stream, "var global_%u = global_%u + global_%u * %u;\n", i, a, b, i % 9);
+    }
+}
+
+static inline void
+spk_bench_workload_strings (spk_bench_source_t *src, size_t bytes)
+{
+    uint32_t state = 0xcc9e2d51;
+
+    for (uint32_t i = 0; !spk_bench_workload_full (src, bytes, i); ++i) {
+        if (i % 4 != 3 || i < 4) {
+            uint32_t length = 200 + spk_bench_rand (&state) % 1800;
+            fprintf (src->stream, "var s%u = \"", i);
+            for (uint32_t c = 0; c < length; ++c) {
+                fputc ("abcdefghijklmnopqrstuvwxyz ,.-"[(i + c * 7) % 30], src->stream);
+            }
+            fprintf (src->stream, "\";\n");
+        } else {
+            fprintf (src->stream, "var s%u = s%u + s%u;\ns%u == s%u;\n",
+                     i, i - 1, i - 3, i - 2, i - 1);
+        }
+    }
+}
+
+static inline void
+spk_bench_workload_comments (spk_bench_source_t *src, size_t bytes)
+{
+    uint32_t state = 0x85ebca6b;
+    uint32_t globals = 0;
+
+    fprintf (src->stream, "var c0 = 0;\n");
+    while (!spk_bench_workload_full (src, bytes, ++globals)) {
+        uint32_t lines = 5 + spk_bench_rand (&state) % 20;
+        for (uint32_t line = 0; line < lines; ++line) {
+            fprintf (src->stream, "# %u: this comment explains the statement below at length, "
+                                  "as generated code often does\n", line);
+        }
+        fprintf (src->stream, "var c%u = c%u + 1;\n", globals, globals - 1);
+    }
+}
+
+static inline void
+spk_bench_workload_prints (spk_bench_source_t *src, size_t bytes)
+{
+    fprintf (src->stream, "var p0 = 0;\n");
+    for (uint32_t i = 1; !spk_bench_workload_full (src, bytes, i); ++i) {
+        fprintf (src->stream, "var p%u = p%u + %u;\nprint p%u;\nprint \"line %u\";\nprint p%u * 2 - %u;\n",
+                 i, i - 1, i % 13, i, i, i, i % 5);
+    }
+}
+
+typedef struct spk_bench_workload_s {
+    const char              *name;
+    spk_bench_workload_fn_t build;
+} spk_bench_workload_t;
+
+static const spk_bench_workload_t spk_bench_workloads[] = {
+    { "deep", spk_bench_workload_deep },
+    { "globals", spk_bench_workload_globals },
+    { "strings", spk_bench_workload_strings },
+    { "comments", spk_bench_workload_comments },
+    { "prints", spk_bench_workload_prints },
+};
+
+#define SPK_BENCH_WORKLOAD_COUNT (sizeof (spk_bench_workloads) / sizeof (spk_bench_workloads[0]))
+
+static inline void
+spk_bench_build_workload (const spk_bench_workload_t *workload, spk_bench_source_t *src,
+                          size_t bytes)
+{
+    spk_bench_source_begin (src);
+    workload->build (src, bytes);
+    spk_bench_source_end (src);
+}
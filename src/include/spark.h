@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ libspark, Spark embedded in another program.
+
+ A program is compiled from source once and can then be run any number of
+ times. Every run starts from fresh globals, except for the inputs the
+ program was compiled with, which the host sets for each run. The globals
+ a script declares can be read back after a run until the next one.
+
+ Each program has its own interpreter context: different programs can run
+ on different threads at the same time, a single program can't. Errors
+ are printed to stdout, the same way spk-interp reports them.
+*/
+
+typedef enum {
+    SPK_ENGINE_VM,
+    SPK_ENGINE_AST,
+    SPK_ENGINE_CLOSURE
+} SPK_engine;
+
+typedef enum {
+    SPK_INPUT_INT,
+    SPK_INPUT_STRING
+} SPK_input_type;
+
+// Inputs are globals declared ahead of the script, which reads them like
+// any other variable and can't redeclare them
+typedef struct spk_input_s {
+    const char     *name;
+    SPK_input_type type;
+} spk_input_t;
+
+typedef struct spk_input_value_s {
+    union {
+        int32_t    integer;
+        const char *string; // Null-terminated, copied by the run
+    };
+} spk_input_value_t;
+
+typedef struct spk_program_options_s {
+    SPK_engine engine;
+    uint32_t   opt_level;     // 0 or 1, see -O0 and -O1
+    bool       peephole;      // vm engine only
+    bool       dump_ast;      // Prints the optimized AST once compiled
+    bool       dump_bytecode; // vm engine only
+    // vm engine only. Loads the compiled program from the cache in this
+    // directory when the source and options match, stores it there when
+    // they don't. nullptr disables the cache, as does dump_ast.
+    const char *cache_dir;
+    // ast engine only. Compiles statements to x86-64 machine code once
+    // they've run jit_threshold times, over all runs of the program.
+    // Ignored where the JIT isn't supported.
+    bool       jit;
+    uint32_t   jit_threshold;
+    // ast engine only. Samples which statements the runs spend their
+    // CPU time in, see spk_program_write_profile.
+    bool       profile;
+
+    const spk_input_t *inputs;
+    uint32_t          input_count;
+} spk_program_options_t;
+
+typedef struct spk_program_s spk_program_t;
+
+// The defaults of spk-interp: vm engine, -O1 and peephole optimization
+void spk_program_options_init (spk_program_options_t *options);
+
+// The source is only read during the call.
+// Returns nullptr once the errors are printed if it doesn't compile.
+spk_program_t *spk_program_compile (const char *source, size_t length,
+                                    const spk_program_options_t *options);
+void           spk_program_free (spk_program_t *program);
+
+// values has one value per input, in the order they were declared.
+// Returns false on a runtime error.
+bool spk_program_run (spk_program_t *program, const spk_input_value_t *values);
+
+// Globals as the last run left them. Both fail if the script has no
+// such global or it holds a value of another type.
+bool        spk_program_get_int (spk_program_t *program, const char *name, int32_t *value);
+// Null-terminated, valid until the next run
+const char *spk_program_get_string (spk_program_t *program, const char *name);
+
+// Write the program as x86-64 assembly or as C, see --emit-asm and
+// --emit-c. Both fail for programs with inputs and programs loaded
+// from the cache.
+bool spk_program_emit_asm (const spk_program_t *program, const char *path);
+bool spk_program_emit_c (const spk_program_t *program, const char *path);
+
+// Where the runs of a program compiled with profile spent their time, see
+// --profile. Writes one folded stack per statement, rooted at script, to
+// path and prints the 20 hottest source lines. Fails for programs compiled
+// without profile.
+bool spk_program_write_profile (const spk_program_t *program, const char *script,
+                                const char *path);
+
+// Memory used by the program's AST and literals, see --arena-stats
+void spk_program_print_stats (const spk_program_t *program);
@@ -1,174 +1,192 @@
 #include "ast_interpreter.h"
+#include "context.h"
 #include "expressions.h"
 #include "statements.h"
 
 #include "../utils/darray.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
-typedef struct spk_var_storage_s {
-    const char *name;
-    spk_token_literal_t value;
-} spk_var_storage_t;
-
-typedef struct spk_global_reg_s {
-    darray_t *var_storage; // [spk_var_storage_t, ...]
-} spk_global_reg_t;
-
-static spk_global_reg_t global_reg = {
-    .var_storage = nullptr
-};
-
-static const spk_token_literal_t *
-spk_global_reg_find_var (const char *name)
+// Evaluation goes on with a dummy result, the statement is dropped at its end
+static int32_t
+spk_interpreter_runtime_err (spk_context_t *context, const char *msg)
 {
-    // FIXME: Linear search = bad
-    for (size_t i = 0; i < global_reg.var_storage->count; ++i) {
-        spk_var_storage_t *storage = darray_elem (global_reg.var_storage, i);
-        if (strcmp (storage->name, name) == 0) {
-            return &storage->value;
-        }
+    if (!context->had_error) {
+        printf ("Runtime error: %s\n", msg);
     }
 
-    return nullptr;
+    context->had_error = true;
+    return 0;
 }
 
 static void
-spk_global_reg_add_var (const spk_var_statement_t *var)
+spk_interpreter_declare (spk_context_t *context, const spk_var_statement_t *var)
 {
-    if (!global_reg.var_storage) {
-        global_reg.var_storage = darray_empty (sizeof (spk_var_storage_t));
+    assert (var->slot != SPK_SLOT_UNRESOLVED);
+
+    auto value = spk_value_nil ();
+    if (var->initializer) {
+        value = spk_evaluate_expression (context, var->initializer);
     }
 
-    if (spk_global_reg_find_var (var->name.value)) {
-        // Variable already declared
-        assert (false);
+    if (context->had_error) {
+        spk_value_release (value);
         return;
     }
 
-    spk_var_storage_t storage = {
-        .name = strdup (var->name.value),
-        .value = {
-            .type = SPK_TOKEN_LITERAL_EMPTY
-        }
-    };
-
-    if (var->initializer) {
-        storage.value = spk_evaluate_expression (var->initializer);
-    }
+    spk_context_reserve_globals (context, var->slot + 1);
+    context->globals[var->slot] = value;
+}
 
-    darray_append (global_reg.var_storage, &storage);
+void
+spk_interpreter_reset (spk_context_t *context)
+{
+    spk_context_clear_globals (context);
 }
 
-static spk_token_literal_t
+static spk_value_t
 spk_evaluate_literal (const spk_literal_expr_t *expr)
 {
-    return expr->value;
+    // Streamed statements own their literals, values outlive them
+    auto value = spk_value_from_literal (&expr->value);
+    spk_value_retain (value);
+    return value;
 }
 
-static spk_token_literal_t
-spk_evaluate_grouping (const spk_grouping_expr_t *expr)
+static spk_value_t
+spk_evaluate_grouping (spk_context_t *context, const spk_grouping_expr_t *expr)
 {
-    return spk_evaluate_expression (expr->expr);
+    return spk_evaluate_expression (context, expr->expr);
 }
 
-static spk_token_literal_t
-spk_evaluate_unary (const spk_unary_expr_t *expr)
+// Operators only exist on ints and strings once the program is type
+// checked, the evaluators below never look at a value's tag
+static int32_t
+spk_evaluate_int (spk_context_t *context, const spk_expr_t *expr);
+
+static bool
+spk_evaluate_string_equal (spk_context_t *context, const spk_binary_expr_t *expr)
 {
-    auto right = spk_evaluate_expression (expr->right);
+    auto left = spk_evaluate_expression (context, expr->left);
+    auto right = spk_evaluate_expression (context, expr->right);
+    bool equal = spk_string_equal (spk_value_as_string (left), spk_value_as_string (right));
 
-    if (expr->operator.type == SPK_TOKEN_TYPE_MINUS) {
-        return (spk_token_literal_t) {
-            .type = SPK_TOKEN_LITERAL_INTEGER,
-            .integer = { -right.integer.value }
-        };
-    }
+    spk_value_release (left);
+    spk_value_release (right);
+    return equal;
+}
+
+static spk_value_t
+spk_evaluate_string_concat (spk_context_t *context, const spk_binary_expr_t *expr)
+{
+    assert (expr->operator == SPK_TOKEN_TYPE_PLUS);
 
-    return (spk_token_literal_t) {};
+    auto left = spk_evaluate_expression (context, expr->left);
+    auto right = spk_evaluate_expression (context, expr->right);
+    auto result = spk_string_concat (spk_value_as_string (left), spk_value_as_string (right));
+
+    spk_value_release (left);
+    spk_value_release (right);
+    return spk_value_string (result);
 }
 
-static spk_token_literal_t
-spk_evaluate_binary (const spk_binary_expr_t *expr)
+static int32_t
+spk_evaluate_int_unary (spk_context_t *context, const spk_unary_expr_t *expr)
 {
-    auto left = spk_evaluate_expression (expr->left);
-    auto right = spk_evaluate_expression (expr->right);
- 
-    assert (left.type == SPK_TOKEN_LITERAL_INTEGER);
-    assert (right.type == SPK_TOKEN_LITERAL_INTEGER);
-
-    int32_t result;
-    switch (expr->operator.type) {
-        case SPK_TOKEN_TYPE_PLUS:
-            result = left.integer.value + right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_MINUS:
-            result = left.integer.value - right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_MULTIPLY:
-            result = left.integer.value * right.integer.value;
-            break;
+    auto right = spk_evaluate_int (context, expr->right);
+
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_MINUS: return spk_int_neg (right);
+        case SPK_TOKEN_TYPE_NOT:   return !right;
+        default:
+            // Rejected by the type checker
+            assert (false);
+            return 0;
+    }
+}
+
+static int32_t
+spk_evaluate_int_binary (spk_context_t *context, const spk_binary_expr_t *expr)
+{
+    // == and != on strings are int-typed too
+    if (expr->left->value_type == SPK_VALUE_TYPE_STRING) {
+        bool equal = spk_evaluate_string_equal (context, expr);
+        return expr->operator == SPK_TOKEN_TYPE_EQUAL_EQUAL ? equal : !equal;
+    }
+
+    auto left = spk_evaluate_int (context, expr->left);
+    auto right = spk_evaluate_int (context, expr->right);
+
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:          return spk_int_add (left, right);
+        case SPK_TOKEN_TYPE_MINUS:         return spk_int_sub (left, right);
+        case SPK_TOKEN_TYPE_MULTIPLY:      return spk_int_mul (left, right);
         case SPK_TOKEN_TYPE_DIVIDE:
-            result = left.integer.value / right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_GREATER:
-            result = left.integer.value > right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_GREATER_EQUAL:
-            result = left.integer.value >= right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_LESS:
-            result = left.integer.value < right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_LESS_EQUAL:
-            result = left.integer.value <= right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_EQUAL_EQUAL:
-            result = left.integer.value == right.integer.value;
-            break;
-        case SPK_TOKEN_TYPE_NOT_EQUAL:
-            result = left.integer.value != right.integer.value;
-            break;
+            if (right == 0) {
+                return spk_interpreter_runtime_err (context, "Division by zero");
+            }
+            return spk_int_div (left, right);
+        case SPK_TOKEN_TYPE_GREATER:       return left > right;
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: return left >= right;
+        case SPK_TOKEN_TYPE_LESS:          return left < right;
+        case SPK_TOKEN_TYPE_LESS_EQUAL:    return left <= right;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:   return left == right;
+        case SPK_TOKEN_TYPE_NOT_EQUAL:     return left != right;
         default:
-            return (spk_token_literal_t) {};
+            // Rejected by the type checker
+            assert (false);
+            return 0;
     }
+}
 
-    return (spk_token_literal_t) {
-        .type = SPK_TOKEN_LITERAL_INTEGER,
-        .integer = { result }
-    };
+static int32_t
+spk_evaluate_int (spk_context_t *context, const spk_expr_t *expr)
+{
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            return expr->literal.value.integer.value;
+        case SPK_EXPR_TYPE_GROUPING:
+            return spk_evaluate_int (context, expr->grouping.expr);
+        case SPK_EXPR_TYPE_UNARY:
+            return spk_evaluate_int_unary (context, &expr->unary);
+        case SPK_EXPR_TYPE_BINARY:
+            return spk_evaluate_int_binary (context, &expr->binary);
+        case SPK_EXPR_TYPE_VAR:
+            return spk_value_as_int (context->globals[expr->var.slot]);
+        default:
+            assert (false);
+            return 0;
+    }
 }
 
-spk_token_literal_t
-spk_evaluate_expression (const spk_expr_t *expr)
+spk_value_t
+spk_evaluate_expression (spk_context_t *context, const spk_expr_t *expr)
 {
-    spk_token_literal_t evaluated_value = {
-        .type = SPK_TOKEN_LITERAL_EMPTY
-    };
+    // Int-typed trees are evaluated without ever building a tagged value
+    if (expr->value_type == SPK_VALUE_TYPE_INTEGER) {
+        return spk_value_int (spk_evaluate_int (context, expr));
+    }
+
+    auto evaluated_value = spk_value_nil ();
 
     switch (expr->type) {
         case SPK_EXPR_TYPE_LITERAL:
             evaluated_value = spk_evaluate_literal (&expr->literal);
             break;
         case SPK_EXPR_TYPE_GROUPING:
-            evaluated_value = spk_evaluate_grouping (&expr->grouping);
-            break;
-        case SPK_EXPR_TYPE_UNARY:
-            evaluated_value = spk_evaluate_unary (&expr->unary);
+            evaluated_value = spk_evaluate_grouping (context, &expr->grouping);
             break;
         case SPK_EXPR_TYPE_BINARY:
-            evaluated_value = spk_evaluate_binary (&expr->binary);
+            evaluated_value = spk_evaluate_string_concat (context, &expr->binary);
             break;
         case SPK_EXPR_TYPE_VAR:
-            auto var_storage = spk_global_reg_find_var (expr->var.name.value);
-
-            if (!var_storage) {
-                printf ("Error trying to evaluate unknown variable %s!\n", expr->var.name.value);
-                break;
-            }
-
-            evaluated_value = *var_storage;
+            // The resolver only binds uses to declarations that came first
+            assert (expr->var.slot < context->global_capacity);
+            evaluated_value = context->globals[expr->var.slot];
+            spk_value_retain (evaluated_value);
             break;
         default:
             assert (false);
@@ -177,48 +195,30 @@ spk_evaluate_expression (const spk_expr_t *expr)
     return evaluated_value;
 }
 
-void
-spk_interpret_statement (const spk_statement_t *stmt)
+bool
+spk_interpret_statement (spk_context_t *context, const spk_statement_t *stmt)
 {
+    context->had_error = false;
+
     switch (stmt->type) {
         case SPK_STATEMENT_TYPE_PRINT:
-            auto msg = spk_evaluate_expression (stmt->print.expr);
-            switch (msg.type) {
-                case SPK_TOKEN_LITERAL_EMPTY:
-                    printf ("empty\n");
-                    break;
-                case SPK_TOKEN_LITERAL_INTEGER:
-                    printf ("%d\n", msg.integer.value);
-                    break;
-                case SPK_TOKEN_LITERAL_STRING:
-                    printf ("%s\n", msg.string.value);
-                    break;
-                default:
-                    assert (false);
+            auto msg = spk_evaluate_expression (context, stmt->print.expr);
+            if (!context->had_error) {
+                spk_value_print (msg);
             }
-
+            spk_value_release (msg);
             break;
         case SPK_STATEMENT_TYPE_EXPR:
-            auto result = spk_evaluate_expression (stmt->expr.expr);
+            auto result = spk_evaluate_expression (context, stmt->expr.expr);
 #if 0
-            switch (result.type) {
-                case SPK_TOKEN_LITERAL_INTEGER:
-                    printf ("Evaluated to %d\n", result.integer.value);
-                    break;
-                case SPK_TOKEN_LITERAL_STRING:
-                    printf ("Evaluated to %s\n", result.string.value);
-                    break;
-                default:
-                    printf ("Couldn't evaluate. Invalid expression?\n");
-                    break;
-            }
-#else
-            (void)result;
+            printf ("Evaluated to ");
+            spk_value_print (result);
 #endif
+            spk_value_release (result);
             break;
         case SPK_STATEMENT_TYPE_VAR:
-            //printf ("Declaring variable %s", stmt->var.name.value);
-            spk_global_reg_add_var (&stmt->var);
+            //printf ("Declaring variable %s", stmt->var.name);
+            spk_interpreter_declare (context, &stmt->var);
 
             /*if (stmt->var.initializer) {
                 printf (" with value");
@@ -240,5 +240,7 @@ spk_interpret_statement (const spk_statement_t *stmt)
         default:
             assert (false);
     }
+
+    return !context->had_error;
 }
 
@@ -1,10 +1,18 @@
 #pragma once
 
-#include "token.h"
+#include "value.h"
 
 typedef struct spk_expr_s spk_expr_t;
 typedef struct spk_statement_s spk_statement_t;
+typedef struct spk_context_s spk_context_t;
 
-spk_token_literal_t spk_evaluate_expression (const spk_expr_t *expr);
-void spk_interpret_statement (const spk_statement_t *stmt);
+// Globals are read from and declared in the context
+
+// Returns a new reference to the value
+spk_value_t spk_evaluate_expression (spk_context_t *context, const spk_expr_t *expr);
+// Statements have to be resolved and type checked before they're interpreted.
+// Returns false once a runtime error is printed, the statement then has no effect.
+bool spk_interpret_statement (spk_context_t *context, const spk_statement_t *stmt);
+// Forgets every global declared in the context so far
+void spk_interpreter_reset (spk_context_t *context);
 
@@ -0,0 +1,128 @@
+#include "bytecode.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+spk_chunk_t *
+spk_chunk_create ()
+{
+    spk_chunk_t *chunk = calloc (1, sizeof (spk_chunk_t));
+    chunk->code = darray_empty (sizeof (uint8_t));
+    chunk->constants = darray_empty (sizeof (spk_value_t));
+    return chunk;
+}
+
+void
+spk_chunk_free (spk_chunk_t *chunk)
+{
+    darray_free (chunk->code);
+    darray_free (chunk->constants);
+    free (chunk);
+}
+
+void
+spk_chunk_write (spk_chunk_t *chunk, uint8_t byte)
+{
+    darray_append (chunk->code, &byte);
+}
+
+void
+spk_chunk_write_u16 (spk_chunk_t *chunk, uint16_t value)
+{
+    spk_chunk_write (chunk, (uint8_t)(value & 0xff));
+    spk_chunk_write (chunk, (uint8_t)(value >> 8));
+}
+
+void
+spk_chunk_write_u32 (spk_chunk_t *chunk, uint32_t value)
+{
+    for (uint32_t i = 0; i < 4; ++i) {
+        spk_chunk_write (chunk, (uint8_t)((value >> (i * 8)) & 0xff));
+    }
+}
+
+uint32_t
+spk_chunk_add_constant (spk_chunk_t *chunk, spk_value_t value)
+{
+    darray_append (chunk->constants, &value);
+    return (uint32_t)(chunk->constants->count - 1);
+}
+
+const char *
+spk_opcode_str (SPK_opcode op)
+{
+#define SPK_OPCODE(name, ...) \
+    case name: \
+        str = #name; \
+        break;
+
+    const char *str = "Unknown";
+    switch (op) {
+        SPK_OPCODE_ENUM_ITER()
+        default:
+            break;
+    }
+#undef SPK_OPCODE
+
+    return str;
+}
+
+size_t
+spk_opcode_operand_bytes (SPK_opcode op)
+{
+#define SPK_OPCODE(name, operand_bytes) \
+    case name: \
+        return operand_bytes;
+
+    switch (op) {
+        SPK_OPCODE_ENUM_ITER()
+        default:
+            break;
+    }
+#undef SPK_OPCODE
+
+    return 0;
+}
+
+void
+spk_chunk_disassemble (const spk_chunk_t *chunk)
+{
+    const uint8_t *code = chunk->code->data;
+    size_t offset = 0;
+
+    printf ("Chunk (max stack %u, globals %u):\n",
+            chunk->max_stack, chunk->global_count);
+
+    while (offset < chunk->code->count) {
+        SPK_opcode op = code[offset];
+        size_t operand_bytes = spk_opcode_operand_bytes (op);
+        printf ("\t%04zu %-24s", offset, spk_opcode_str (op));
+
+        switch (operand_bytes) {
+            case 2:
+                printf (" %u", spk_read_u16 (code + offset + 1));
+                break;
+            case 4:
+                printf (" %u", spk_read_u32 (code + offset + 1));
+                break;
+            default:
+                break;
+        }
+
+        printf ("\n");
+        offset += 1 + operand_bytes;
+    }
+}
+
+size_t
+spk_chunk_instruction_count (const spk_chunk_t *chunk)
+{
+    const uint8_t *code = chunk->code->data;
+    size_t count = 0;
+
+    for (size_t offset = 0; offset < chunk->code->count; ++count) {
+        offset += 1 + spk_opcode_operand_bytes (code[offset]);
+    }
+
+    return count;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "value.h"
+#include "../utils/darray.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SPK_OPCODE(name, operand_bytes)
+#define SPK_OPCODE(...)
+#define SPK_OPCODE_ENUM_ITER() \
+    SPK_OPCODE(SPK_OP_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_CONSTANT_LONG, 4) \
+    SPK_OPCODE(SPK_OP_NIL, 0) \
+    \
+    SPK_OPCODE(SPK_OP_DEFINE_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_GET_GLOBAL, 2) \
+    \
+    SPK_OPCODE(SPK_OP_NEGATE, 0) \
+    SPK_OPCODE(SPK_OP_NOT, 0) \
+    \
+    SPK_OPCODE(SPK_OP_ADD, 0) \
+    SPK_OPCODE(SPK_OP_SUBTRACT, 0) \
+    SPK_OPCODE(SPK_OP_MULTIPLY, 0) \
+    SPK_OPCODE(SPK_OP_DIVIDE, 0) \
+    SPK_OPCODE(SPK_OP_GREATER, 0) \
+    SPK_OPCODE(SPK_OP_GREATER_EQUAL, 0) \
+    SPK_OPCODE(SPK_OP_LESS, 0) \
+    SPK_OPCODE(SPK_OP_LESS_EQUAL, 0) \
+    SPK_OPCODE(SPK_OP_EQUAL, 0) \
+    SPK_OPCODE(SPK_OP_NOT_EQUAL, 0) \
+    \
+    /* String operands are owned references, the ops release them. */ \
+    SPK_OPCODE(SPK_OP_CONCAT, 0) \
+    SPK_OPCODE(SPK_OP_EQUAL_STRING, 0) \
+    SPK_OPCODE(SPK_OP_NOT_EQUAL_STRING, 0) \
+    /* Follows GET_GLOBAL for strings, the stack owns its values. */ \
+    SPK_OPCODE(SPK_OP_RETAIN, 0) \
+    \
+    SPK_OPCODE(SPK_OP_PRINT, 0) \
+    SPK_OPCODE(SPK_OP_POP, 0) \
+    SPK_OPCODE(SPK_OP_RETURN, 0) \
+    \
+    /* Superinstructions, only emitted by the peephole pass. */ \
+    /* The right-hand operand is an integer constant or a global. */ \
+    SPK_OPCODE(SPK_OP_ADD_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_SUBTRACT_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_MULTIPLY_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_DIVIDE_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_GREATER_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_GREATER_EQUAL_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_LESS_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_LESS_EQUAL_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_EQUAL_CONSTANT, 2) \
+    SPK_OPCODE(SPK_OP_NOT_EQUAL_CONSTANT, 2) \
+    \
+    SPK_OPCODE(SPK_OP_ADD_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_SUBTRACT_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_MULTIPLY_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_DIVIDE_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_GREATER_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_GREATER_EQUAL_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_LESS_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_LESS_EQUAL_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_EQUAL_GLOBAL, 2) \
+    SPK_OPCODE(SPK_OP_NOT_EQUAL_GLOBAL, 2)
+#undef SPK_OPCODE
+
+#define SPK_OPCODE(name, ...) name,
+typedef enum {
+    SPK_OPCODE_ENUM_ITER()
+    SPK_OP_COUNT
+} SPK_opcode;
+#undef SPK_OPCODE
+
+typedef struct spk_chunk_s {
+    darray_t *code;      // [uint8_t, ...]
+    darray_t *constants; // [spk_value_t, ...]
+
+    // Filled in by the compiler so the VM can size
+    // its stack and global slots up front
+    uint32_t max_stack;
+    uint32_t global_count;
+} spk_chunk_t;
+
+spk_chunk_t *spk_chunk_create ();
+void         spk_chunk_free (spk_chunk_t *chunk);
+
+void     spk_chunk_write (spk_chunk_t *chunk, uint8_t byte);
+void     spk_chunk_write_u16 (spk_chunk_t *chunk, uint16_t value);
+void     spk_chunk_write_u32 (spk_chunk_t *chunk, uint32_t value);
+uint32_t spk_chunk_add_constant (spk_chunk_t *chunk, spk_value_t value);
+
+const char *spk_opcode_str (SPK_opcode op);
+size_t      spk_opcode_operand_bytes (SPK_opcode op);
+
+void   spk_chunk_disassemble (const spk_chunk_t *chunk);
+size_t spk_chunk_instruction_count (const spk_chunk_t *chunk);
+
+static inline uint16_t
+spk_read_u16 (const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static inline uint32_t
+spk_read_u32 (const uint8_t *bytes)
+{
+    return (uint32_t)bytes[0]         |
+           ((uint32_t)bytes[1] << 8)  |
+           ((uint32_t)bytes[2] << 16) |
+           ((uint32_t)bytes[3] << 24);
+}
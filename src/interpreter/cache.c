@@ -0,0 +1,351 @@
+#include "cache.h"
+#include "object.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SPK_CACHE_MAGIC "SPKC"
+#define SPK_CACHE_ALIGN 8
+
+typedef struct spk_cache_header_s {
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;
+
+    // Layout the file was written with, a build that differs rejects it
+    uint16_t value_size;
+    uint16_t string_size;
+    uint16_t opcode_count;
+    uint16_t reserved;
+
+    uint32_t max_stack;
+    uint32_t chunk_global_count;
+    uint32_t global_count;
+
+    uint32_t code_offset;
+    uint32_t code_size;
+    uint32_t constants_offset;
+    uint32_t constant_count;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint32_t names_offset;
+    uint32_t names_size;
+} spk_cache_header_t;
+
+struct spk_cache_s {
+    uint8_t *map;
+    size_t  size;
+
+    // Views of the mapping, nothing of it is owned by the chunk
+    darray_t    code;
+    darray_t    constants;
+    spk_chunk_t chunk;
+};
+
+uint64_t
+spk_cache_hash (uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    const uint64_t prime = UINT64_C (0x100000001b3);
+
+    // Eight bytes per step, sources can be large
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy (&word, bytes + i, sizeof (word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 29;
+    }
+
+    for (; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    // The size keeps "ab" + "c" apart from "a" + "bc"
+    hash = (hash ^ size) * prime;
+    return hash ^ (hash >> 32);
+}
+
+char *
+spk_cache_path (const char *dir, uint64_t key)
+{
+    size_t size = strlen (dir) + sizeof ("/0123456789abcdef.spkc");
+    char *path = malloc (size);
+    snprintf (path, size, "%s/%016llx.spkc", dir, (unsigned long long)key);
+    return path;
+}
+
+static uint32_t
+spk_cache_align (uint32_t offset)
+{
+    return (offset + SPK_CACHE_ALIGN - 1) & ~(uint32_t)(SPK_CACHE_ALIGN - 1);
+}
+
+static uint32_t
+spk_cache_string_size (const spk_string_t *string)
+{
+    return spk_cache_align ((uint32_t)(sizeof (spk_string_t) + string->length + 1));
+}
+
+bool
+spk_cache_write (const char *path, uint64_t key, const spk_chunk_t *chunk,
+                 const char *const *names, uint32_t global_count)
+{
+    const spk_value_t *constants = chunk->constants->data;
+    uint32_t constant_count = (uint32_t)chunk->constants->count;
+
+    uint32_t strings_size = 0;
+    for (uint32_t i = 0; i < constant_count; ++i) {
+        if (spk_value_tag (constants[i]) == SPK_VALUE_TAG_STRING) {
+            strings_size += spk_cache_string_size (spk_value_as_string (constants[i]));
+        }
+    }
+
+    uint32_t names_size = global_count * (uint32_t)sizeof (uint32_t);
+    for (uint32_t i = 0; i < global_count; ++i) {
+        names_size += (uint32_t)strlen (names[i]) + 1;
+    }
+
+    spk_cache_header_t header = {
+        .magic = { 'S', 'P', 'K', 'C' },
+        .version = SPK_CACHE_VERSION,
+        .key = key,
+        .value_size = sizeof (spk_value_t),
+        .string_size = sizeof (spk_string_t),
+        .opcode_count = SPK_OP_COUNT,
+        .max_stack = chunk->max_stack,
+        .chunk_global_count = chunk->global_count,
+        .global_count = global_count,
+        .code_offset = sizeof (spk_cache_header_t),
+        .code_size = (uint32_t)chunk->code->count,
+        .constant_count = constant_count,
+        .strings_size = strings_size,
+        .names_size = names_size
+    };
+    header.constants_offset = spk_cache_align (header.code_offset + header.code_size);
+    header.strings_offset = header.constants_offset + constant_count * (uint32_t)sizeof (spk_value_t);
+    header.names_offset = header.strings_offset + strings_size;
+
+    size_t size = (size_t)header.names_offset + names_size;
+    uint8_t *data = calloc (size, 1);
+    memcpy (data, &header, sizeof (header));
+    memcpy (data + header.code_offset, chunk->code->data, header.code_size);
+
+    // Strings go right after each other, constants refer to them by offset
+    uint32_t string_offset = header.strings_offset;
+    spk_value_t *file_constants = (spk_value_t *)(data + header.constants_offset);
+    for (uint32_t i = 0; i < constant_count; ++i) {
+        if (spk_value_tag (constants[i]) != SPK_VALUE_TAG_STRING) {
+            file_constants[i] = constants[i];
+            continue;
+        }
+
+        auto source = spk_value_as_string (constants[i]);
+        spk_string_t string;
+        memset (&string, 0, sizeof (string));
+        string.refcount = SPK_STRING_IMMORTAL;
+        string.length = source->length;
+        string.kind = SPK_STRING_KIND_INLINE;
+
+        memcpy (data + string_offset, &string, sizeof (string));
+        memcpy (data + string_offset + offsetof (spk_string_t, inline_chars),
+                spk_string_chars (source), source->length);
+
+        file_constants[i] = spk_value_make (SPK_VALUE_TAG_STRING, string_offset);
+        string_offset += spk_cache_string_size (source);
+    }
+
+    uint32_t *name_offsets = (uint32_t *)(data + header.names_offset);
+    uint32_t name_offset = global_count * (uint32_t)sizeof (uint32_t);
+    for (uint32_t i = 0; i < global_count; ++i) {
+        size_t length = strlen (names[i]) + 1;
+        name_offsets[i] = name_offset;
+        memcpy (data + header.names_offset + name_offset, names[i], length);
+        name_offset += (uint32_t)length;
+    }
+
+    size_t tmp_size = strlen (path) + 32;
+    char *tmp_path = malloc (tmp_size);
+    snprintf (tmp_path, tmp_size, "%s.%ld.tmp", path, (long)getpid ());
+
+    bool ok = false;
+    auto file = fopen (tmp_path, "wb");
+    if (file) {
+        ok = fwrite (data, 1, size, file) == size;
+        ok = fclose (file) == 0 && ok;
+        ok = ok && rename (tmp_path, path) == 0;
+        if (!ok) {
+            remove (tmp_path);
+        }
+    }
+
+    free (tmp_path);
+    free (data);
+    return ok;
+}
+
+static bool
+spk_cache_section_valid (size_t file_size, uint32_t offset, uint64_t size)
+{
+    return offset <= file_size && size <= file_size - offset;
+}
+
+static bool
+spk_cache_header_valid (const spk_cache_header_t *header, size_t size, uint64_t key)
+{
+    return memcmp (header->magic, SPK_CACHE_MAGIC, sizeof (header->magic)) == 0 &&
+           header->version == SPK_CACHE_VERSION &&
+           header->key == key &&
+           header->value_size == sizeof (spk_value_t) &&
+           header->string_size == sizeof (spk_string_t) &&
+           header->opcode_count == SPK_OP_COUNT &&
+           header->code_size > 0 &&
+           header->constants_offset % SPK_CACHE_ALIGN == 0 &&
+           header->strings_offset % SPK_CACHE_ALIGN == 0 &&
+           header->names_offset % sizeof (uint32_t) == 0 &&
+           spk_cache_section_valid (size, header->code_offset, header->code_size) &&
+           spk_cache_section_valid (size, header->constants_offset,
+                                    (uint64_t)header->constant_count * sizeof (spk_value_t)) &&
+           spk_cache_section_valid (size, header->strings_offset, header->strings_size) &&
+           spk_cache_section_valid (size, header->names_offset, header->names_size) &&
+           (uint64_t)header->global_count * sizeof (uint32_t) <= header->names_size;
+}
+
+// Points string constants at their strings in the mapping
+static bool
+spk_cache_relocate (spk_cache_t *cache, const spk_cache_header_t *header)
+{
+    spk_value_t *constants = (spk_value_t *)(cache->map + header->constants_offset);
+    uint64_t strings_end = (uint64_t)header->strings_offset + header->strings_size;
+
+    for (uint32_t i = 0; i < header->constant_count; ++i) {
+        if (spk_value_tag (constants[i]) != SPK_VALUE_TAG_STRING) {
+            continue;
+        }
+
+        uint64_t offset = constants[i].bits & SPK_VALUE_PAYLOAD_MASK;
+        if (offset < header->strings_offset || offset % SPK_CACHE_ALIGN != 0 ||
+            offset + sizeof (spk_string_t) > strings_end) {
+            return false;
+        }
+
+        spk_string_t *string = (spk_string_t *)(cache->map + offset);
+        if (offset + sizeof (spk_string_t) + string->length + 1 > strings_end ||
+            string->kind != SPK_STRING_KIND_INLINE ||
+            string->refcount != SPK_STRING_IMMORTAL) {
+            return false;
+        }
+
+        constants[i] = spk_value_string (string);
+    }
+
+    return true;
+}
+
+static bool
+spk_cache_names_valid (const spk_cache_t *cache, const spk_cache_header_t *header)
+{
+    const uint8_t *names = cache->map + header->names_offset;
+    if (header->global_count > 0 && names[header->names_size - 1] != '\0') {
+        return false;
+    }
+
+    const uint32_t *offsets = (const uint32_t *)names;
+    for (uint32_t i = 0; i < header->global_count; ++i) {
+        if (offsets[i] < header->global_count * sizeof (uint32_t) ||
+            offsets[i] >= header->names_size) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+spk_cache_t *
+spk_cache_open (const char *path, uint64_t key)
+{
+    int fd = open (path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat (fd, &st) != 0 || (size_t)st.st_size < sizeof (spk_cache_header_t) ||
+        (uint64_t)st.st_size > UINT32_MAX) {
+        close (fd);
+        return nullptr;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap (nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        return nullptr;
+    }
+
+    spk_cache_t *cache = calloc (1, sizeof (spk_cache_t));
+    cache->map = map;
+    cache->size = size;
+
+    const spk_cache_header_t *header = map;
+    if (!spk_cache_header_valid (header, size, key) ||
+        !spk_cache_relocate (cache, header) ||
+        !spk_cache_names_valid (cache, header)) {
+        spk_cache_close (cache);
+        return nullptr;
+    }
+
+    cache->code = (darray_t) {
+        .data = cache->map + header->code_offset,
+        .count = header->code_size,
+        .capacity = header->code_size,
+        .elem_size = sizeof (uint8_t)
+    };
+    cache->constants = (darray_t) {
+        .data = cache->map + header->constants_offset,
+        .count = header->constant_count,
+        .capacity = header->constant_count,
+        .elem_size = sizeof (spk_value_t)
+    };
+    cache->chunk = (spk_chunk_t) {
+        .code = &cache->code,
+        .constants = &cache->constants,
+        .max_stack = header->max_stack,
+        .global_count = header->chunk_global_count
+    };
+
+    return cache;
+}
+
+void
+spk_cache_close (spk_cache_t *cache)
+{
+    munmap (cache->map, cache->size);
+    free (cache);
+}
+
+const spk_chunk_t *
+spk_cache_chunk (const spk_cache_t *cache)
+{
+    return &cache->chunk;
+}
+
+uint32_t
+spk_cache_global_count (const spk_cache_t *cache)
+{
+    return ((const spk_cache_header_t *)cache->map)->global_count;
+}
+
+const char *
+spk_cache_global_name (const spk_cache_t *cache, uint32_t slot)
+{
+    auto header = (const spk_cache_header_t *)cache->map;
+    auto names = (const char *)cache->map + header->names_offset;
+    return names + ((const uint32_t *)names)[slot];
+}
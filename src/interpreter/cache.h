@@ -0,0 +1,48 @@
+#pragma once
+
+#include "bytecode.h"
+
+/*
+ Compiled bytecode cache, .spkc files. A cache file holds a chunk that is
+ run straight from an mmap of the file:
+
+   header     magic, version, key and the offsets of the sections below
+   code       the chunk's bytecode
+   constants  spk_value_t[], string constants hold the file offset of
+              their string instead of its address
+   strings    immortal inline spk_string_t objects
+   names      offsets of the program's global names in slot order,
+              followed by the null-terminated names
+
+ The mapping is private and writable. Opening a file checks its header
+ and rebases the string constants onto the mapping, nothing is copied
+ or decoded. Files are named after a key the caller derives from the
+ source and whatever else changes the generated code, the key is stored
+ and checked as well. Writers go through a temporary file renamed into
+ place, concurrent runs never map a partial file.
+
+ Like the rest of the cache directory, the bytecode is trusted.
+*/
+
+#define SPK_CACHE_VERSION   1
+#define SPK_CACHE_HASH_SEED UINT64_C (0x9e3779b97f4a7c15)
+
+typedef struct spk_cache_s spk_cache_t;
+
+// Chains, hash the parts of a key one after the other from SPK_CACHE_HASH_SEED
+uint64_t spk_cache_hash (uint64_t hash, const void *data, size_t size);
+// "<dir>/<key in hex>.spkc", the caller frees it
+char    *spk_cache_path (const char *dir, uint64_t key);
+
+// names holds the name of every global of the program in slot order
+bool spk_cache_write (const char *path, uint64_t key, const spk_chunk_t *chunk,
+                      const char *const *names, uint32_t global_count);
+
+// Returns nullptr if there's no valid cache file for key at path
+spk_cache_t *spk_cache_open (const char *path, uint64_t key);
+void         spk_cache_close (spk_cache_t *cache);
+
+// All of them live until the cache is closed
+const spk_chunk_t *spk_cache_chunk (const spk_cache_t *cache);
+uint32_t           spk_cache_global_count (const spk_cache_t *cache);
+const char        *spk_cache_global_name (const spk_cache_t *cache, uint32_t slot);
@@ -0,0 +1,536 @@
+#include "closure.h"
+#include "expressions.h"
+#include "statements.h"
+#include "value.h"
+#include "../utils/stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+
+typedef struct spk_closure_env_s {
+    spk_value_t *globals;
+    bool        had_error;
+} spk_closure_env_t;
+
+typedef struct spk_closure_s spk_closure_t;
+typedef spk_value_t (*spk_closure_fn_t) (const spk_closure_t *self,
+                                         spk_closure_env_t *env);
+
+typedef struct spk_closure_s {
+    spk_closure_fn_t fn;
+
+    // Operands resolved at compile time
+    union {
+        spk_value_t constant;
+        int32_t     imm;
+    };
+    uint32_t slot;
+    uint32_t right_slot;
+
+    spk_closure_t *left;
+    spk_closure_t *right;
+} spk_closure_t;
+
+typedef struct spk_closure_program_s {
+    darray_t *statements; // [spk_closure_t *, ...]
+    uint32_t global_count;
+} spk_closure_program_t;
+
+typedef struct spk_closure_compiler_s {
+    uint32_t global_count;
+    bool     had_error;
+} spk_closure_compiler_t;
+
+#define SPK_CLOSURE_CALL(closure, env) ((closure)->fn ((closure), (env)))
+
+static spk_value_t
+spk_closure_runtime_err (spk_closure_env_t *env, const char *msg)
+{
+    if (!env->had_error) {
+        printf ("Runtime error: %s\n", msg);
+    }
+
+    env->had_error = true;
+    return spk_value_nil ();
+}
+
+/* Leaves */
+
+static spk_value_t
+spk_closure_constant (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    return self->constant;
+}
+
+static spk_value_t
+spk_closure_global (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    return env->globals[self->slot];
+}
+
+// Every string a closure returns is a reference its caller owns
+static spk_value_t
+spk_closure_global_string (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto value = env->globals[self->slot];
+    spk_value_retain (value);
+    return value;
+}
+
+/* Unary operators */
+
+// Programs are type checked, int operators only ever see ints and
+// none of the closures below look at a value's tag
+
+static spk_value_t
+spk_closure_negate (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto right = SPK_CLOSURE_CALL (self->right, env);
+    return spk_value_int (spk_int_neg (spk_value_as_int (right)));
+}
+
+static spk_value_t
+spk_closure_not (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto right = SPK_CLOSURE_CALL (self->right, env);
+    return spk_value_int (!spk_value_as_int (right));
+}
+
+/* Binary operators */
+
+// Comparisons as functions, applied the same way as the wrapping
+// spk_int_ arithmetic from value.h
+#define SPK_CLOSURE_COMPARE(name, op) \
+    static inline int32_t \
+    spk_closure_int_##name (int32_t left, int32_t right) \
+    { \
+        return left op right; \
+    }
+SPK_CLOSURE_COMPARE (greater, >)
+SPK_CLOSURE_COMPARE (greater_equal, >=)
+SPK_CLOSURE_COMPARE (less, <)
+SPK_CLOSURE_COMPARE (less_equal, <=)
+SPK_CLOSURE_COMPARE (equal, ==)
+SPK_CLOSURE_COMPARE (not_equal, !=)
+#undef SPK_CLOSURE_COMPARE
+
+// SPK_CLOSURE_BINARY(token_type, name, fn, divides)
+#define SPK_CLOSURE_BINARY(...)
+#define SPK_CLOSURE_BINARY_ITER() \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_PLUS, add, spk_int_add, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_MINUS, subtract, spk_int_sub, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_MULTIPLY, multiply, spk_int_mul, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_DIVIDE, divide, spk_int_div, true) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_GREATER, greater, spk_closure_int_greater, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_GREATER_EQUAL, greater_equal, spk_closure_int_greater_equal, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_LESS, less, spk_closure_int_less, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_LESS_EQUAL, less_equal, spk_closure_int_less_equal, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_EQUAL_EQUAL, equal, spk_closure_int_equal, false) \
+    SPK_CLOSURE_BINARY(SPK_TOKEN_TYPE_NOT_EQUAL, not_equal, spk_closure_int_not_equal, false)
+#undef SPK_CLOSURE_BINARY
+
+// Every operator gets one closure per operand shape:
+//  - any_any:       both operands are arbitrary closures
+//  - any_imm:       right operand is an integer constant
+//  - global_imm:    left operand is a global, right an integer constant
+//  - global_global: both operands are globals
+// Immediate divisors are never zero, the compiler keeps those generic.
+#define SPK_CLOSURE_BINARY(token_type, name, fn, divides) \
+    static spk_value_t \
+    spk_closure_##name##_any_any (const spk_closure_t *self, spk_closure_env_t *env) \
+    { \
+        auto left = SPK_CLOSURE_CALL (self->left, env); \
+        auto right = SPK_CLOSURE_CALL (self->right, env); \
+        if (divides && spk_value_as_int (right) == 0) { \
+            return spk_closure_runtime_err (env, "Division by zero"); \
+        } \
+        return spk_value_int (fn (spk_value_as_int (left), spk_value_as_int (right))); \
+    } \
+    \
+    static spk_value_t \
+    spk_closure_##name##_any_imm (const spk_closure_t *self, spk_closure_env_t *env) \
+    { \
+        auto left = SPK_CLOSURE_CALL (self->left, env); \
+        return spk_value_int (fn (spk_value_as_int (left), self->imm)); \
+    } \
+    \
+    static spk_value_t \
+    spk_closure_##name##_global_imm (const spk_closure_t *self, spk_closure_env_t *env) \
+    { \
+        auto left = env->globals[self->slot]; \
+        return spk_value_int (fn (spk_value_as_int (left), self->imm)); \
+    } \
+    \
+    static spk_value_t \
+    spk_closure_##name##_global_global (const spk_closure_t *self, spk_closure_env_t *env) \
+    { \
+        auto left = env->globals[self->slot]; \
+        auto right = env->globals[self->right_slot]; \
+        if (divides && spk_value_as_int (right) == 0) { \
+            return spk_closure_runtime_err (env, "Division by zero"); \
+        } \
+        return spk_value_int (fn (spk_value_as_int (left), spk_value_as_int (right))); \
+    }
+SPK_CLOSURE_BINARY_ITER()
+#undef SPK_CLOSURE_BINARY
+
+/* String operators, they release both operands */
+
+static spk_value_t
+spk_closure_concat (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto left = spk_value_as_string (SPK_CLOSURE_CALL (self->left, env));
+    auto right = spk_value_as_string (SPK_CLOSURE_CALL (self->right, env));
+    auto result = spk_string_concat (left, right);
+    spk_string_release (left);
+    spk_string_release (right);
+    return spk_value_string (result);
+}
+
+static spk_value_t
+spk_closure_equal_string (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto left = spk_value_as_string (SPK_CLOSURE_CALL (self->left, env));
+    auto right = spk_value_as_string (SPK_CLOSURE_CALL (self->right, env));
+    bool equal = spk_string_equal (left, right);
+    spk_string_release (left);
+    spk_string_release (right);
+    return spk_value_int (equal);
+}
+
+static spk_value_t
+spk_closure_not_equal_string (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto equal = spk_closure_equal_string (self, env);
+    return spk_value_int (!spk_value_as_int (equal));
+}
+
+typedef struct spk_closure_binary_family_s {
+    spk_closure_fn_t any_any;
+    spk_closure_fn_t any_imm;
+    spk_closure_fn_t global_imm;
+    spk_closure_fn_t global_global;
+} spk_closure_binary_family_t;
+
+static const spk_closure_binary_family_t *
+spk_closure_binary_family (SPK_token_type type)
+{
+#define SPK_CLOSURE_BINARY(token_type, name, ...) \
+    case token_type: { \
+        static const spk_closure_binary_family_t family = { \
+            .any_any = spk_closure_##name##_any_any, \
+            .any_imm = spk_closure_##name##_any_imm, \
+            .global_imm = spk_closure_##name##_global_imm, \
+            .global_global = spk_closure_##name##_global_global \
+        }; \
+        return &family; \
+    }
+
+    switch (type) {
+        SPK_CLOSURE_BINARY_ITER()
+        default:
+            return nullptr;
+    }
+#undef SPK_CLOSURE_BINARY
+}
+
+/* Statements, their return value is released and otherwise ignored */
+
+static spk_value_t
+spk_closure_print (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    auto value = SPK_CLOSURE_CALL (self->right, env);
+    if (!env->had_error) {
+        spk_value_print (value);
+    }
+
+    return value;
+}
+
+static spk_value_t
+spk_closure_define_global (const spk_closure_t *self, spk_closure_env_t *env)
+{
+    // The global takes over the initializer's reference
+    env->globals[self->slot] = self->right ?
+                                 SPK_CLOSURE_CALL (self->right, env) :
+                                 spk_value_nil ();
+    return spk_value_nil ();
+}
+
+/* Compiler */
+
+// Nodes the closures have no implementation for, the program isn't run
+static void
+spk_closure_report_err (spk_closure_compiler_t *compiler, const char *fmt, ...)
+{
+    va_list args;
+    va_start (args);
+    printf ("Compiler error: ");
+    vprintf (fmt, args);
+    printf ("\n");
+    va_end (args);
+
+    compiler->had_error = true;
+}
+
+static spk_closure_t *
+spk_alloc_closure (spk_closure_fn_t fn)
+{
+    spk_closure_t *closure = calloc (1, sizeof (spk_closure_t));
+    closure->fn = fn;
+    return closure;
+}
+
+static void
+spk_free_closure (spk_closure_t *closure)
+{
+    if (!closure) {
+        return;
+    }
+
+    spk_free_closure (closure->left);
+    spk_free_closure (closure->right);
+    free (closure);
+}
+
+static spk_closure_t *
+spk_closure_compile_expression (spk_closure_compiler_t *compiler, const spk_expr_t *expr);
+
+static bool
+spk_closure_is_int_constant (const spk_closure_t *closure)
+{
+    return closure->fn == spk_closure_constant &&
+           spk_value_is_int (closure->constant);
+}
+
+static spk_closure_t *
+spk_closure_compile_string_binary (spk_closure_compiler_t *compiler, const spk_binary_expr_t *expr)
+{
+    spk_closure_fn_t fn;
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:        fn = spk_closure_concat; break;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL: fn = spk_closure_equal_string; break;
+        case SPK_TOKEN_TYPE_NOT_EQUAL:   fn = spk_closure_not_equal_string; break;
+        default:
+            spk_closure_report_err (compiler, "Unsupported string operator %s",
+                                    spk_token_type_str (expr->operator));
+            return nullptr;
+    }
+
+    auto closure = spk_alloc_closure (fn);
+    closure->left = spk_closure_compile_expression (compiler, expr->left);
+    closure->right = spk_closure_compile_expression (compiler, expr->right);
+    return closure;
+}
+
+static spk_closure_t *
+spk_closure_compile_binary (spk_closure_compiler_t *compiler, const spk_binary_expr_t *expr)
+{
+    if (expr->left->value_type == SPK_VALUE_TYPE_STRING) {
+        assert (expr->right->value_type == SPK_VALUE_TYPE_STRING);
+        return spk_closure_compile_string_binary (compiler, expr);
+    }
+
+    auto family = spk_closure_binary_family (expr->operator);
+    if (!family) {
+        spk_closure_report_err (compiler, "Unsupported binary operator %s",
+                                spk_token_type_str (expr->operator));
+        return nullptr;
+    }
+
+    assert (expr->left->value_type == SPK_VALUE_TYPE_INTEGER &&
+            expr->right->value_type == SPK_VALUE_TYPE_INTEGER);
+
+    auto left = spk_closure_compile_expression (compiler, expr->left);
+    auto right = spk_closure_compile_expression (compiler, expr->right);
+    if (!left || !right) {
+        spk_free_closure (left);
+        spk_free_closure (right);
+        return nullptr;
+    }
+
+    bool left_global = left->fn == spk_closure_global;
+    bool right_global = right->fn == spk_closure_global;
+    bool right_imm = spk_closure_is_int_constant (right) &&
+                     (expr->operator != SPK_TOKEN_TYPE_DIVIDE ||
+                      spk_value_as_int (right->constant) != 0);
+
+    spk_closure_t *closure = nullptr;
+    if (left_global && right_imm) {
+        closure = spk_alloc_closure (family->global_imm);
+        closure->slot = left->slot;
+        closure->imm = spk_value_as_int (right->constant);
+        spk_free_closure (left);
+        spk_free_closure (right);
+    } else if (left_global && right_global) {
+        closure = spk_alloc_closure (family->global_global);
+        closure->slot = left->slot;
+        closure->right_slot = right->slot;
+        spk_free_closure (left);
+        spk_free_closure (right);
+    } else if (right_imm) {
+        closure = spk_alloc_closure (family->any_imm);
+        closure->imm = spk_value_as_int (right->constant);
+        closure->left = left;
+        spk_free_closure (right);
+    } else {
+        closure = spk_alloc_closure (family->any_any);
+        closure->left = left;
+        closure->right = right;
+    }
+
+    return closure;
+}
+
+static spk_closure_t *
+spk_closure_compile_expression (spk_closure_compiler_t *compiler, const spk_expr_t *expr)
+{
+    spk_closure_t *closure = nullptr;
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            closure = spk_alloc_closure (spk_closure_constant);
+            closure->constant = spk_value_from_literal (&expr->literal.value);
+            break;
+        case SPK_EXPR_TYPE_GROUPING:
+            // Groupings only exist for the parser, they don't need a closure
+            closure = spk_closure_compile_expression (compiler, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            closure = spk_alloc_closure (expr->unary.operator == SPK_TOKEN_TYPE_MINUS ?
+                                            spk_closure_negate :
+                                            spk_closure_not);
+            closure->right = spk_closure_compile_expression (compiler, expr->unary.right);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            closure = spk_closure_compile_binary (compiler, &expr->binary);
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            assert (expr->var.slot != SPK_SLOT_UNRESOLVED);
+            closure = spk_alloc_closure (expr->value_type == SPK_VALUE_TYPE_STRING ?
+                                            spk_closure_global_string :
+                                            spk_closure_global);
+            closure->slot = expr->var.slot;
+            break;
+        default:
+            spk_closure_report_err (compiler, "Unsupported expression type %d", (int)expr->type);
+    }
+
+    return closure;
+}
+
+static spk_closure_t *
+spk_closure_compile_statement (spk_closure_compiler_t *compiler, const spk_statement_t *stmt)
+{
+    spk_closure_t *closure = nullptr;
+
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            closure = spk_alloc_closure (spk_closure_print);
+            closure->right = spk_closure_compile_expression (compiler, stmt->print.expr);
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            // The result is discarded, the expression closure runs as is
+            closure = spk_closure_compile_expression (compiler, stmt->expr.expr);
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            assert (stmt->var.slot != SPK_SLOT_UNRESOLVED);
+            closure = spk_alloc_closure (spk_closure_define_global);
+            if (stmt->var.initializer) {
+                closure->right = spk_closure_compile_expression (compiler, stmt->var.initializer);
+            }
+
+            closure->slot = stmt->var.slot;
+            if (closure->slot >= compiler->global_count) {
+                compiler->global_count = closure->slot + 1;
+            }
+            break;
+        default:
+            spk_closure_report_err (compiler, "Unsupported statement type %d", (int)stmt->type);
+    }
+
+    return closure;
+}
+
+spk_closure_program_t *
+spk_closure_compile (darray_t *statements)
+{
+    spk_closure_compiler_t compiler = {
+        .global_count = 0,
+        .had_error = false
+    };
+
+    spk_closure_program_t *program = calloc (1, sizeof (spk_closure_program_t));
+    program->statements = darray_empty (sizeof (spk_closure_t *));
+
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_statement_t *stmt = darray_elem (statements, i);
+        auto closure = spk_closure_compile_statement (&compiler, stmt);
+        if (closure) {
+            darray_append_v (program->statements, closure);
+        }
+    }
+
+    program->global_count = compiler.global_count;
+
+    if (compiler.had_error) {
+        spk_closure_program_free (program);
+        return nullptr;
+    }
+
+    return program;
+}
+
+void
+spk_closure_program_free (spk_closure_program_t *program)
+{
+    for (size_t i = 0; i < program->statements->count; ++i) {
+        spk_closure_t **closure = darray_elem (program->statements, i);
+        spk_free_closure (*closure);
+    }
+
+    darray_free (program->statements);
+    free (program);
+}
+
+uint32_t
+spk_closure_global_count (const spk_closure_program_t *program)
+{
+    return program->global_count;
+}
+
+bool
+spk_closure_run_with_globals (const spk_closure_program_t *program, spk_value_t *globals)
+{
+    spk_closure_env_t env = {
+        .globals = globals,
+        .had_error = false
+    };
+
+    spk_closure_t **statements = program->statements->data;
+    size_t count = program->statements->count;
+
+    size_t executed = 0;
+    for (; executed < count && !env.had_error; ++executed) {
+        spk_value_release (SPK_CLOSURE_CALL (statements[executed], &env));
+    }
+
+    SPK_STATS_ADD (statements, executed);
+    return !env.had_error;
+}
+
+bool
+spk_closure_run (const spk_closure_program_t *program)
+{
+    spk_value_t *globals = calloc (program->global_count + 1, sizeof (spk_value_t));
+    auto ok = spk_closure_run_with_globals (program, globals);
+
+    for (uint32_t i = 0; i < program->global_count; ++i) {
+        spk_value_release (globals[i]);
+    }
+
+    free (globals);
+    return ok;
+}
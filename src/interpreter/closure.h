@@ -0,0 +1,25 @@
+#pragma once
+
+#include "value.h"
+
+#include "../utils/darray.h"
+
+/*
+ Closure compilation: every expression and statement is converted once into
+ a tree of small specialized C functions. Node types, operators and operand
+ kinds (constant, global) are resolved when the tree is built, so execution
+ only makes indirect calls and never switches on the AST.
+*/
+
+typedef struct spk_closure_program_s spk_closure_program_t;
+
+// Statements have to be resolved and type checked,
+// returns nullptr if the program failed to compile
+spk_closure_program_t *spk_closure_compile (darray_t *statements);
+void                   spk_closure_program_free (spk_closure_program_t *program);
+
+bool spk_closure_run (const spk_closure_program_t *program);
+// Same as spk_vm_run_with_globals, globals has at least
+// spk_closure_global_count (program) slots
+bool     spk_closure_run_with_globals (const spk_closure_program_t *program, spk_value_t *globals);
+uint32_t spk_closure_global_count (const spk_closure_program_t *program);
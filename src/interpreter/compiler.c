@@ -0,0 +1,216 @@
+#include "compiler.h"
+#include "bytecode.h"
+#include "expressions.h"
+#include "statements.h"
+
+#include <stdio.h>
+#include <assert.h>
+
+typedef struct spk_compiler_ctx_s {
+    spk_chunk_t *chunk;
+
+    uint32_t stack_depth;
+    bool     had_error;
+} spk_compiler_ctx_t;
+
+static void
+spk_compiler_report_err (spk_compiler_ctx_t *ctx, const char *msg, const char *name)
+{
+    printf ("Compiler error: %s '%s'\n", msg, name);
+    ctx->had_error = true;
+}
+
+static void
+spk_emit_op (spk_compiler_ctx_t *ctx, SPK_opcode op, int32_t stack_effect)
+{
+    spk_chunk_write (ctx->chunk, (uint8_t)op);
+
+    ctx->stack_depth = (uint32_t)((int32_t)ctx->stack_depth + stack_effect);
+    if (ctx->stack_depth > ctx->chunk->max_stack) {
+        ctx->chunk->max_stack = ctx->stack_depth;
+    }
+}
+
+static void
+spk_emit_constant (spk_compiler_ctx_t *ctx, spk_value_t value)
+{
+    uint32_t idx = spk_chunk_add_constant (ctx->chunk, value);
+    if (idx <= UINT16_MAX) {
+        spk_emit_op (ctx, SPK_OP_CONSTANT, 1);
+        spk_chunk_write_u16 (ctx->chunk, (uint16_t)idx);
+    } else {
+        spk_emit_op (ctx, SPK_OP_CONSTANT_LONG, 1);
+        spk_chunk_write_u32 (ctx->chunk, idx);
+    }
+}
+
+static void
+spk_compile_expression (spk_compiler_ctx_t *ctx, const spk_expr_t *expr);
+
+static void
+spk_compile_unary (spk_compiler_ctx_t *ctx, const spk_unary_expr_t *expr)
+{
+    // Operators don't check tags in the VM, the type checker has
+    assert (expr->right->value_type == SPK_VALUE_TYPE_INTEGER);
+    spk_compile_expression (ctx, expr->right);
+
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_MINUS:
+            spk_emit_op (ctx, SPK_OP_NEGATE, 0);
+            break;
+        case SPK_TOKEN_TYPE_NOT:
+            spk_emit_op (ctx, SPK_OP_NOT, 0);
+            break;
+        default:
+            assert (false);
+    }
+}
+
+static void
+spk_compile_string_binary (spk_compiler_ctx_t *ctx, const spk_binary_expr_t *expr)
+{
+    SPK_opcode op;
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:        op = SPK_OP_CONCAT; break;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL: op = SPK_OP_EQUAL_STRING; break;
+        case SPK_TOKEN_TYPE_NOT_EQUAL:   op = SPK_OP_NOT_EQUAL_STRING; break;
+        default:
+            assert (false);
+            return;
+    }
+
+    spk_emit_op (ctx, op, -1);
+}
+
+static void
+spk_compile_binary (spk_compiler_ctx_t *ctx, const spk_binary_expr_t *expr)
+{
+    spk_compile_expression (ctx, expr->left);
+    spk_compile_expression (ctx, expr->right);
+
+    if (expr->left->value_type == SPK_VALUE_TYPE_STRING) {
+        assert (expr->right->value_type == SPK_VALUE_TYPE_STRING);
+        spk_compile_string_binary (ctx, expr);
+        return;
+    }
+
+    assert (expr->left->value_type == SPK_VALUE_TYPE_INTEGER &&
+            expr->right->value_type == SPK_VALUE_TYPE_INTEGER);
+
+    SPK_opcode op;
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:          op = SPK_OP_ADD; break;
+        case SPK_TOKEN_TYPE_MINUS:         op = SPK_OP_SUBTRACT; break;
+        case SPK_TOKEN_TYPE_MULTIPLY:      op = SPK_OP_MULTIPLY; break;
+        case SPK_TOKEN_TYPE_DIVIDE:        op = SPK_OP_DIVIDE; break;
+        case SPK_TOKEN_TYPE_GREATER:       op = SPK_OP_GREATER; break;
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: op = SPK_OP_GREATER_EQUAL; break;
+        case SPK_TOKEN_TYPE_LESS:          op = SPK_OP_LESS; break;
+        case SPK_TOKEN_TYPE_LESS_EQUAL:    op = SPK_OP_LESS_EQUAL; break;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:   op = SPK_OP_EQUAL; break;
+        case SPK_TOKEN_TYPE_NOT_EQUAL:     op = SPK_OP_NOT_EQUAL; break;
+        default:
+            assert (false);
+            return;
+    }
+
+    spk_emit_op (ctx, op, -1);
+}
+
+static void
+spk_compile_expression (spk_compiler_ctx_t *ctx, const spk_expr_t *expr)
+{
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            spk_emit_constant (ctx, spk_value_from_literal (&expr->literal.value));
+            break;
+        case SPK_EXPR_TYPE_GROUPING:
+            spk_compile_expression (ctx, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            spk_compile_unary (ctx, &expr->unary);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            spk_compile_binary (ctx, &expr->binary);
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            assert (expr->var.slot != SPK_SLOT_UNRESOLVED);
+            spk_emit_op (ctx, SPK_OP_GET_GLOBAL, 1);
+            spk_chunk_write_u16 (ctx->chunk, (uint16_t)expr->var.slot);
+            if (expr->value_type == SPK_VALUE_TYPE_STRING) {
+                spk_emit_op (ctx, SPK_OP_RETAIN, 0);
+            }
+            break;
+        default:
+            assert (false);
+    }
+}
+
+static void
+spk_compile_var (spk_compiler_ctx_t *ctx, const spk_var_statement_t *var)
+{
+    assert (var->slot != SPK_SLOT_UNRESOLVED);
+
+    if (var->slot > UINT16_MAX) {
+        spk_compiler_report_err (ctx, "Too many global variables, can't declare",
+                                 var->name);
+        return;
+    }
+
+    if (var->initializer) {
+        spk_compile_expression (ctx, var->initializer);
+    } else {
+        spk_emit_op (ctx, SPK_OP_NIL, 1);
+    }
+
+    if (var->slot >= ctx->chunk->global_count) {
+        ctx->chunk->global_count = var->slot + 1;
+    }
+
+    spk_emit_op (ctx, SPK_OP_DEFINE_GLOBAL, -1);
+    spk_chunk_write_u16 (ctx->chunk, (uint16_t)var->slot);
+}
+
+static void
+spk_compile_statement (spk_compiler_ctx_t *ctx, const spk_statement_t *stmt)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            spk_compile_expression (ctx, stmt->print.expr);
+            spk_emit_op (ctx, SPK_OP_PRINT, -1);
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            spk_compile_expression (ctx, stmt->expr.expr);
+            spk_emit_op (ctx, SPK_OP_POP, -1);
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            spk_compile_var (ctx, &stmt->var);
+            break;
+        default:
+            assert (false);
+    }
+
+    assert (ctx->stack_depth == 0);
+}
+
+spk_chunk_t *
+spk_compile_statements (darray_t *statements)
+{
+    spk_compiler_ctx_t ctx = {
+        .chunk = spk_chunk_create ()
+    };
+
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_statement_t *stmt = darray_elem (statements, i);
+        spk_compile_statement (&ctx, stmt);
+    }
+
+    spk_emit_op (&ctx, SPK_OP_RETURN, 0);
+
+    if (ctx.had_error) {
+        spk_chunk_free (ctx.chunk);
+        return nullptr;
+    }
+
+    return ctx.chunk;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "../utils/darray.h"
+
+typedef struct spk_chunk_s spk_chunk_t;
+
+// Lowers a list of parsed, resolved and type checked statements ([spk_statement_t, ...])
+// into a bytecode chunk. Returns nullptr if the program failed to compile.
+spk_chunk_t *spk_compile_statements (darray_t *statements);
@@ -0,0 +1,49 @@
+#include "context.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+spk_context_t *
+spk_context_create ()
+{
+    spk_context_t *context = calloc (1, sizeof (spk_context_t));
+    context->symbols = spk_symbol_table_create ();
+    return context;
+}
+
+void
+spk_context_free (spk_context_t *context)
+{
+    spk_context_clear_globals (context);
+    free (context->globals);
+    spk_symbol_table_free (context->symbols);
+    free (context);
+}
+
+void
+spk_context_reserve_globals (spk_context_t *context, uint32_t count)
+{
+    if (count <= context->global_capacity) {
+        return;
+    }
+
+    uint32_t capacity = context->global_capacity ? context->global_capacity : 16;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    context->globals = reallocarray (context->globals, capacity, sizeof (spk_value_t));
+    // Zero bits are the int 0, releasing them is a no-op
+    memset (context->globals + context->global_capacity, 0,
+            (capacity - context->global_capacity) * sizeof (spk_value_t));
+    context->global_capacity = capacity;
+}
+
+void
+spk_context_clear_globals (spk_context_t *context)
+{
+    for (uint32_t i = 0; i < context->global_capacity; ++i) {
+        spk_value_release (context->globals[i]);
+        context->globals[i] = spk_value_int (0);
+    }
+}
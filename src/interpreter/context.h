@@ -0,0 +1,32 @@
+#pragma once
+
+#include "value.h"
+#include "symbols.h"
+
+/*
+ One interpreter instance. Whatever a script run keeps between calls is
+ reached through a context, so contexts share no mutable state and
+ separate threads can each run scripts in their own context.
+ A context is used by one thread at a time, and values (strings are
+ refcounted without atomics) never move from one context to another.
+
+ The lexer and parser only need the symbol table, the vm and closure
+ engines keep their state in the program they run.
+*/
+
+typedef struct spk_context_s {
+    spk_symbol_table_t *symbols; // Identifiers of every script run in the context
+
+    // ast engine globals, indexed by the slots the resolver assigned
+    spk_value_t *globals;
+    uint32_t    global_capacity;
+    bool        had_error; // Runtime error in the ast engine's current statement
+} spk_context_t;
+
+spk_context_t *spk_context_create ();
+void           spk_context_free (spk_context_t *context);
+
+// Makes room for count global slots, new slots hold the int 0
+void spk_context_reserve_globals (spk_context_t *context, uint32_t count);
+// Releases every global, the slots keep their memory
+void spk_context_clear_globals (spk_context_t *context);
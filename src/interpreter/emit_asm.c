@@ -0,0 +1,400 @@
+#include "emit_asm.h"
+#include "statements.h"
+#include "object.h"
+
+#include "../runtime/runtime.h"
+
+#include <stddef.h>
+#include <assert.h>
+
+// Literals are emitted with the runtime's string layout
+static_assert (offsetof (spk_rt_string_t, length) == 4);
+static_assert (offsetof (spk_rt_string_t, chars) == 8);
+
+typedef struct spk_asm_emitter_s {
+    FILE     *out;
+    uint32_t depth;        // 8-byte values pushed, calls keep rsp 16 byte aligned
+    uint32_t global_count;
+    darray_t *strings;     // [spk_string_t *, ...], label .Lstring<index>
+    uint32_t divisions;    // Labels .Ldivide<index> and .Ldivided<index>
+} spk_asm_emitter_t;
+
+#define SPK_ASM_GLOBAL_OFFSET(slot) ((uint64_t)(slot) * 8)
+
+static void
+spk_asm_push (spk_asm_emitter_t *emitter)
+{
+    fprintf (emitter->out, "\tpushq\t%%rax\n");
+    ++emitter->depth;
+}
+
+static void
+spk_asm_pop (spk_asm_emitter_t *emitter, const char *reg)
+{
+    fprintf (emitter->out, "\tpopq\t%%%s\n", reg);
+    --emitter->depth;
+}
+
+static void
+spk_asm_call (spk_asm_emitter_t *emitter, const char *function)
+{
+    bool pad = emitter->depth % 2 != 0;
+    if (pad) {
+        fprintf (emitter->out, "\tsubq\t$8, %%rsp\n");
+    }
+
+    fprintf (emitter->out, "\tcall\t%s@PLT\n", function);
+
+    if (pad) {
+        fprintf (emitter->out, "\taddq\t$8, %%rsp\n");
+    }
+}
+
+static void
+spk_asm_load_global (spk_asm_emitter_t *emitter, const char *mov, uint32_t slot, const char *reg)
+{
+    fprintf (emitter->out, "\t%s\tspk_globals+%llu(%%rip), %%%s\n", mov,
+             (unsigned long long)SPK_ASM_GLOBAL_OFFSET (slot), reg);
+}
+
+static void
+spk_asm_store_global (spk_asm_emitter_t *emitter, uint32_t slot)
+{
+    fprintf (emitter->out, "\tmovq\t%%rax, spk_globals+%llu(%%rip)\n",
+             (unsigned long long)SPK_ASM_GLOBAL_OFFSET (slot));
+}
+
+static const spk_expr_t *
+spk_asm_skip_groupings (const spk_expr_t *expr)
+{
+    while (expr->type == SPK_EXPR_TYPE_GROUPING) {
+        expr = expr->grouping.expr;
+    }
+
+    return expr;
+}
+
+/* Ints, the result is left in eax */
+
+static void
+spk_asm_emit_int (spk_asm_emitter_t *emitter, const spk_expr_t *expr);
+static void
+spk_asm_emit_string (spk_asm_emitter_t *emitter, const spk_expr_t *expr);
+
+// Loads literals and globals into reg without going through eax,
+// returns false for anything else
+static bool
+spk_asm_emit_int_leaf (spk_asm_emitter_t *emitter, const spk_expr_t *expr, const char *reg)
+{
+    expr = spk_asm_skip_groupings (expr);
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            fprintf (emitter->out, "\tmovl\t$%d, %%%s\n", expr->literal.value.integer.value, reg);
+            return true;
+        case SPK_EXPR_TYPE_VAR:
+            spk_asm_load_global (emitter, "movl", expr->var.slot, reg);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void
+spk_asm_emit_unary (spk_asm_emitter_t *emitter, const spk_unary_expr_t *expr)
+{
+    spk_asm_emit_int (emitter, expr->right);
+
+    if (expr->operator == SPK_TOKEN_TYPE_MINUS) {
+        fprintf (emitter->out, "\tnegl\t%%eax\n");
+    } else {
+        fprintf (emitter->out, "\ttestl\t%%eax, %%eax\n"
+                               "\tsete\t%%al\n"
+                               "\tmovzbl\t%%al, %%eax\n");
+    }
+}
+
+// == and != on strings are int-typed
+static void
+spk_asm_emit_string_equal (spk_asm_emitter_t *emitter, const spk_binary_expr_t *expr)
+{
+    spk_asm_emit_string (emitter, expr->left);
+    spk_asm_push (emitter);
+    spk_asm_emit_string (emitter, expr->right);
+    fprintf (emitter->out, "\tmovq\t%%rax, %%rsi\n");
+    spk_asm_pop (emitter, "rdi");
+    spk_asm_call (emitter, "spk_rt_string_equal");
+
+    if (expr->operator == SPK_TOKEN_TYPE_NOT_EQUAL) {
+        fprintf (emitter->out, "\txorl\t$1, %%eax\n");
+    }
+}
+
+static const char *
+spk_asm_setcc (SPK_token_type operator)
+{
+    switch (operator) {
+        case SPK_TOKEN_TYPE_GREATER:       return "setg";
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: return "setge";
+        case SPK_TOKEN_TYPE_LESS:          return "setl";
+        case SPK_TOKEN_TYPE_LESS_EQUAL:    return "setle";
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:   return "sete";
+        case SPK_TOKEN_TYPE_NOT_EQUAL:     return "setne";
+        default:
+            assert (false);
+            return nullptr;
+    }
+}
+
+static void
+spk_asm_emit_binary (spk_asm_emitter_t *emitter, const spk_binary_expr_t *expr)
+{
+    if (expr->left->value_type == SPK_VALUE_TYPE_STRING) {
+        spk_asm_emit_string_equal (emitter, expr);
+        return;
+    }
+
+    // Left ends up in eax and right in ecx
+    spk_asm_emit_int (emitter, expr->left);
+    if (!spk_asm_emit_int_leaf (emitter, expr->right, "ecx")) {
+        spk_asm_push (emitter);
+        spk_asm_emit_int (emitter, expr->right);
+        fprintf (emitter->out, "\tmovl\t%%eax, %%ecx\n");
+        spk_asm_pop (emitter, "rax");
+    }
+
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:
+            fprintf (emitter->out, "\taddl\t%%ecx, %%eax\n");
+            break;
+        case SPK_TOKEN_TYPE_MINUS:
+            fprintf (emitter->out, "\tsubl\t%%ecx, %%eax\n");
+            break;
+        case SPK_TOKEN_TYPE_MULTIPLY:
+            fprintf (emitter->out, "\timull\t%%ecx, %%eax\n");
+            break;
+        case SPK_TOKEN_TYPE_DIVIDE:
+            // idivl faults on a zero divisor and on INT32_MIN / -1, neither reaches it
+            fprintf (emitter->out, "\ttestl\t%%ecx, %%ecx\n"
+                                   "\tjz\t.Ldivision_by_zero\n"
+                                   "\tcmpl\t$-1, %%ecx\n"
+                                   "\tjne\t.Ldivide%u\n"
+                                   "\tnegl\t%%eax\n"
+                                   "\tjmp\t.Ldivided%u\n"
+                                   ".Ldivide%u:\n"
+                                   "\tcltd\n"
+                                   "\tidivl\t%%ecx\n"
+                                   ".Ldivided%u:\n",
+                     emitter->divisions, emitter->divisions, emitter->divisions,
+                     emitter->divisions);
+            ++emitter->divisions;
+            break;
+        default:
+            fprintf (emitter->out, "\tcmpl\t%%ecx, %%eax\n"
+                                   "\t%s\t%%al\n"
+                                   "\tmovzbl\t%%al, %%eax\n", spk_asm_setcc (expr->operator));
+            break;
+    }
+}
+
+static void
+spk_asm_emit_int (spk_asm_emitter_t *emitter, const spk_expr_t *expr)
+{
+    if (spk_asm_emit_int_leaf (emitter, expr, "eax")) {
+        return;
+    }
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_GROUPING:
+            spk_asm_emit_int (emitter, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            spk_asm_emit_unary (emitter, &expr->unary);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            spk_asm_emit_binary (emitter, &expr->binary);
+            break;
+        default:
+            assert (false);
+    }
+}
+
+/* Strings, a reference the code owns is left in rax */
+
+static void
+spk_asm_emit_string (spk_asm_emitter_t *emitter, const spk_expr_t *expr)
+{
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            // Immortal, owning it takes nothing
+            fprintf (emitter->out, "\tleaq\t.Lstring%zu(%%rip), %%rax\n", emitter->strings->count);
+            darray_append_v (emitter->strings, expr->literal.value.string.value);
+            break;
+        case SPK_EXPR_TYPE_GROUPING:
+            spk_asm_emit_string (emitter, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            assert (expr->binary.operator == SPK_TOKEN_TYPE_PLUS);
+            spk_asm_emit_string (emitter, expr->binary.left);
+            spk_asm_push (emitter);
+            spk_asm_emit_string (emitter, expr->binary.right);
+            fprintf (emitter->out, "\tmovq\t%%rax, %%rsi\n");
+            spk_asm_pop (emitter, "rdi");
+            spk_asm_call (emitter, "spk_rt_concat");
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            spk_asm_load_global (emitter, "movq", expr->var.slot, "rdi");
+            spk_asm_call (emitter, "spk_rt_retain");
+            break;
+        default:
+            assert (false);
+    }
+}
+
+// Nil has no representation, nil expressions emit nothing
+static void
+spk_asm_emit_expression (spk_asm_emitter_t *emitter, const spk_expr_t *expr)
+{
+    switch (expr->value_type) {
+        case SPK_VALUE_TYPE_INTEGER:
+            spk_asm_emit_int (emitter, expr);
+            break;
+        case SPK_VALUE_TYPE_STRING:
+            spk_asm_emit_string (emitter, expr);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Statements */
+
+static void
+spk_asm_emit_print (spk_asm_emitter_t *emitter, const spk_expr_t *expr)
+{
+    spk_asm_emit_expression (emitter, expr);
+
+    switch (expr->value_type) {
+        case SPK_VALUE_TYPE_INTEGER:
+            fprintf (emitter->out, "\tmovl\t%%eax, %%edi\n");
+            spk_asm_call (emitter, "spk_rt_print_int");
+            break;
+        case SPK_VALUE_TYPE_STRING:
+            fprintf (emitter->out, "\tmovq\t%%rax, %%rdi\n");
+            spk_asm_call (emitter, "spk_rt_print_string");
+            break;
+        default:
+            spk_asm_call (emitter, "spk_rt_print_nil");
+            break;
+    }
+}
+
+static void
+spk_asm_emit_statement (spk_asm_emitter_t *emitter, const spk_statement_t *stmt)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            spk_asm_emit_print (emitter, stmt->print.expr);
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            spk_asm_emit_expression (emitter, stmt->expr.expr);
+            if (stmt->expr.expr->value_type == SPK_VALUE_TYPE_STRING) {
+                fprintf (emitter->out, "\tmovq\t%%rax, %%rdi\n");
+                spk_asm_call (emitter, "spk_rt_release");
+            }
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            assert (stmt->var.slot != SPK_SLOT_UNRESOLVED);
+            if (stmt->var.slot >= emitter->global_count) {
+                emitter->global_count = stmt->var.slot + 1;
+            }
+
+            // Int slots are only ever read back with movl, nil slots never
+            if (stmt->var.initializer &&
+                stmt->var.initializer->value_type != SPK_VALUE_TYPE_NIL) {
+                spk_asm_emit_expression (emitter, stmt->var.initializer);
+                spk_asm_store_global (emitter, stmt->var.slot);
+            }
+            break;
+        default:
+            break;
+    }
+
+    assert (emitter->depth == 0);
+}
+
+static void
+spk_asm_emit_literal (spk_asm_emitter_t *emitter, size_t index, spk_string_t *string)
+{
+    auto out = emitter->out;
+    auto chars = spk_string_chars (string);
+
+    fprintf (out, "\t.p2align 3\n.Lstring%zu:\n", index);
+    fprintf (out, "\t.long\t%u, %u\n", SPK_RT_STRING_IMMORTAL, string->length);
+    fprintf (out, "\t.ascii\t\"");
+
+    for (uint32_t i = 0; i < string->length; ++i) {
+        auto c = (unsigned char)chars[i];
+        if (c == '"' || c == '\\') {
+            fprintf (out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf (out, "\\%03o", c);
+        } else {
+            fputc (c, out);
+        }
+    }
+
+    fprintf (out, "\\0\"\n");
+}
+
+bool
+spk_emit_asm (darray_t *statements, FILE *out)
+{
+    spk_asm_emitter_t emitter = {
+        .out = out,
+        .strings = darray_empty (sizeof (spk_string_t *))
+    };
+
+    fprintf (out, "# Generated by spk-interp --emit-asm, link with libspk-runtime\n");
+    fprintf (out, "\t.text\n"
+                  "\t.globl\tmain\n"
+                  "\t.type\tmain, @function\n"
+                  "main:\n"
+                  "\tpushq\t%%rbp\n"
+                  "\tmovq\t%%rsp, %%rbp\n");
+
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_asm_emit_statement (&emitter, darray_elem (statements, i));
+    }
+
+    fprintf (out, "\txorl\t%%eax, %%eax\n"
+                  "\tpopq\t%%rbp\n"
+                  "\tret\n");
+
+    // Doesn't return, the stack only has to be aligned for the call
+    if (emitter.divisions > 0) {
+        fprintf (out, ".Ldivision_by_zero:\n"
+                      "\tandq\t$-16, %%rsp\n"
+                      "\tcall\tspk_rt_division_by_zero@PLT\n");
+    }
+
+    fprintf (out, "\t.size\tmain, .-main\n");
+
+    if (emitter.strings->count > 0) {
+        fprintf (out, "\n\t.section\t.rodata\n");
+        for (size_t i = 0; i < emitter.strings->count; ++i) {
+            spk_string_t **string = darray_elem (emitter.strings, i);
+            spk_asm_emit_literal (&emitter, i, *string);
+        }
+    }
+
+    // .comm needs a size, programs without globals get an unused slot
+    uint32_t slots = emitter.global_count > 0 ? emitter.global_count : 1;
+    fprintf (out, "\n\t.local\tspk_globals\n"
+                  "\t.comm\tspk_globals, %llu, 8\n",
+             (unsigned long long)SPK_ASM_GLOBAL_OFFSET (slots));
+    fprintf (out, "\t.section\t.note.GNU-stack, \"\", @progbits\n");
+
+    darray_free (emitter.strings);
+    return !ferror (out);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../utils/darray.h"
+
+#include <stdio.h>
+
+/*
+ Ahead-of-time backend: lowers a whole program to x86-64 GNU assembler
+ (AT&T syntax, System V ABI) defining main, to be linked with the
+ runtime in src/runtime into a standalone executable.
+
+ Every global gets an 8-byte slot in .bss and every expression is
+ emitted from a fixed template, the same ones as the JIT's. Ints are
+ computed in eax with ecx as the second operand, strings are runtime
+ pointers in rax and intermediates go on the machine stack. Types are
+ known statically, the code never checks one at run time.
+*/
+
+// Statements have to be resolved and type checked ([spk_statement_t, ...]).
+// Returns false if writing to out failed.
+bool spk_emit_asm (darray_t *statements, FILE *out);
@@ -0,0 +1,310 @@
+#include "emit_c.h"
+#include "statements.h"
+#include "object.h"
+
+#include <assert.h>
+
+typedef struct spk_c_emitter_s {
+    FILE *out;
+} spk_c_emitter_t;
+
+// Everything the generated code calls. All of it is static inline, unused
+// helpers cost nothing and don't warn.
+static const char *spk_c_prelude =
+    "#include <stdint.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "#define SPK_STRING_IMMORTAL UINT32_MAX\n"
+    "\n"
+    "typedef struct spk_string_s {\n"
+    "    uint32_t refcount;\n"
+    "    uint32_t length;\n"
+    "    const char *chars;\n"
+    "} spk_string_t;\n"
+    "\n"
+    "static inline int32_t spk_add (int32_t a, int32_t b) { return (int32_t)((uint32_t)a + (uint32_t)b); }\n"
+    "static inline int32_t spk_sub (int32_t a, int32_t b) { return (int32_t)((uint32_t)a - (uint32_t)b); }\n"
+    "static inline int32_t spk_mul (int32_t a, int32_t b) { return (int32_t)((uint32_t)a * (uint32_t)b); }\n"
+    "static inline int32_t spk_neg (int32_t a) { return (int32_t)(0u - (uint32_t)a); }\n"
+    "\n"
+    "static inline int32_t\n"
+    "spk_div (int32_t a, int32_t b)\n"
+    "{\n"
+    "    if (b == 0) {\n"
+    "        printf (\"Runtime error: Division by zero\\n\");\n"
+    "        exit (EXIT_FAILURE);\n"
+    "    }\n"
+    "    return b == -1 ? spk_neg (a) : a / b;\n"
+    "}\n"
+    "\n"
+    "static inline spk_string_t *\n"
+    "spk_retain (spk_string_t *s)\n"
+    "{\n"
+    "    if (s->refcount != SPK_STRING_IMMORTAL) {\n"
+    "        ++s->refcount;\n"
+    "    }\n"
+    "    return s;\n"
+    "}\n"
+    "\n"
+    "static inline void\n"
+    "spk_release (spk_string_t *s)\n"
+    "{\n"
+    "    if (s->refcount != SPK_STRING_IMMORTAL && --s->refcount == 0) {\n"
+    "        free (s);\n"
+    "    }\n"
+    "}\n"
+    "\n"
+    "static inline spk_string_t *\n"
+    "spk_concat (spk_string_t *a, spk_string_t *b)\n"
+    "{\n"
+    "    size_t length = (size_t)a->length + b->length;\n"
+    "    spk_string_t *s = malloc (sizeof (spk_string_t) + length + 1);\n"
+    "    char *chars = (char *)(s + 1);\n"
+    "    memcpy (chars, a->chars, a->length);\n"
+    "    memcpy (chars + a->length, b->chars, b->length + 1);\n"
+    "    s->refcount = 1;\n"
+    "    s->length = (uint32_t)length;\n"
+    "    s->chars = chars;\n"
+    "    spk_release (a);\n"
+    "    spk_release (b);\n"
+    "    return s;\n"
+    "}\n"
+    "\n"
+    "static inline int32_t\n"
+    "spk_equal (spk_string_t *a, spk_string_t *b)\n"
+    "{\n"
+    "    int32_t equal = a->length == b->length && memcmp (a->chars, b->chars, a->length) == 0;\n"
+    "    spk_release (a);\n"
+    "    spk_release (b);\n"
+    "    return equal;\n"
+    "}\n"
+    "\n"
+    "static inline void spk_print_int (int32_t value) { printf (\"%d\\n\", value); }\n"
+    "static inline void spk_print_nil (void) { printf (\"empty\\n\"); }\n"
+    "\n"
+    "static inline void\n"
+    "spk_print_string (spk_string_t *s)\n"
+    "{\n"
+    "    printf (\"%s\\n\", s->chars);\n"
+    "    spk_release (s);\n"
+    "}\n";
+
+// Literals are immortal compound literals in main, which outlive every use
+static void
+spk_c_emit_string_literal (spk_c_emitter_t *emitter, spk_string_t *string)
+{
+    auto out = emitter->out;
+    auto chars = spk_string_chars (string);
+
+    fprintf (out, "&(spk_string_t) { SPK_STRING_IMMORTAL, %u, \"", string->length);
+
+    // Octal escapes end after three digits, unlike hex ones
+    for (uint32_t i = 0; i < string->length; ++i) {
+        auto c = (unsigned char)chars[i];
+        if (c == '"' || c == '\\') {
+            fprintf (out, "\\%c", c);
+        } else if (c < 0x20 || c >= 0x7f || c == '?') {
+            fprintf (out, "\\%03o", c);
+        } else {
+            fputc (c, out);
+        }
+    }
+
+    fprintf (out, "\" }");
+}
+
+static void
+spk_c_emit_expression (spk_c_emitter_t *emitter, const spk_expr_t *expr);
+
+static void
+spk_c_emit_unary (spk_c_emitter_t *emitter, const spk_unary_expr_t *expr)
+{
+    fprintf (emitter->out, expr->operator == SPK_TOKEN_TYPE_MINUS ? "spk_neg (" : "!(");
+    spk_c_emit_expression (emitter, expr->right);
+    fprintf (emitter->out, ")");
+}
+
+static const char *
+spk_c_comparison (SPK_token_type operator)
+{
+    switch (operator) {
+        case SPK_TOKEN_TYPE_GREATER:       return ">";
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: return ">=";
+        case SPK_TOKEN_TYPE_LESS:          return "<";
+        case SPK_TOKEN_TYPE_LESS_EQUAL:    return "<=";
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:   return "==";
+        case SPK_TOKEN_TYPE_NOT_EQUAL:     return "!=";
+        default:
+            assert (false);
+            return nullptr;
+    }
+}
+
+// Operators that are a function call in C, nullptr for the ones that are an operator
+static const char *
+spk_c_binary_function (const spk_binary_expr_t *expr)
+{
+    if (expr->left->value_type == SPK_VALUE_TYPE_STRING) {
+        switch (expr->operator) {
+            case SPK_TOKEN_TYPE_PLUS:        return "spk_concat";
+            case SPK_TOKEN_TYPE_EQUAL_EQUAL: return "spk_equal";
+            case SPK_TOKEN_TYPE_NOT_EQUAL:   return "!spk_equal";
+            default:
+                assert (false);
+                return nullptr;
+        }
+    }
+
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:     return "spk_add";
+        case SPK_TOKEN_TYPE_MINUS:    return "spk_sub";
+        case SPK_TOKEN_TYPE_MULTIPLY: return "spk_mul";
+        case SPK_TOKEN_TYPE_DIVIDE:   return "spk_div";
+        default:                      return nullptr;
+    }
+}
+
+static void
+spk_c_emit_binary (spk_c_emitter_t *emitter, const spk_binary_expr_t *expr)
+{
+    auto function = spk_c_binary_function (expr);
+    if (function) {
+        fprintf (emitter->out, "%s (", function);
+        spk_c_emit_expression (emitter, expr->left);
+        fprintf (emitter->out, ", ");
+        spk_c_emit_expression (emitter, expr->right);
+        fprintf (emitter->out, ")");
+        return;
+    }
+
+    // Comparisons on ints, C's give the same 0 or 1
+    fprintf (emitter->out, "(");
+    spk_c_emit_expression (emitter, expr->left);
+    fprintf (emitter->out, " %s ", spk_c_comparison (expr->operator));
+    spk_c_emit_expression (emitter, expr->right);
+    fprintf (emitter->out, ")");
+}
+
+// Strings are emitted as a reference the enclosing code owns
+static void
+spk_c_emit_expression (spk_c_emitter_t *emitter, const spk_expr_t *expr)
+{
+    auto out = emitter->out;
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            if (expr->value_type == SPK_VALUE_TYPE_STRING) {
+                spk_c_emit_string_literal (emitter, expr->literal.value.string.value);
+            } else if (expr->literal.value.integer.value == INT32_MIN) {
+                // Folding can produce it, C has no literal for it
+                fprintf (out, "INT32_MIN");
+            } else {
+                fprintf (out, "%d", expr->literal.value.integer.value);
+            }
+            break;
+        case SPK_EXPR_TYPE_GROUPING:
+            spk_c_emit_expression (emitter, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            spk_c_emit_unary (emitter, &expr->unary);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            spk_c_emit_binary (emitter, &expr->binary);
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            if (expr->value_type == SPK_VALUE_TYPE_STRING) {
+                fprintf (out, "spk_retain (spk_global_%u)", expr->var.slot);
+            } else {
+                fprintf (out, "spk_global_%u", expr->var.slot);
+            }
+            break;
+        default:
+            assert (false);
+    }
+}
+
+// Nil has no representation, nil globals aren't declared at all
+static void
+spk_c_emit_global (spk_c_emitter_t *emitter, const spk_var_statement_t *var)
+{
+    auto type = var->initializer ? var->initializer->value_type : SPK_VALUE_TYPE_NIL;
+
+    switch (type) {
+        case SPK_VALUE_TYPE_INTEGER:
+            fprintf (emitter->out, "static int32_t spk_global_%u; // %s\n", var->slot, var->name);
+            break;
+        case SPK_VALUE_TYPE_STRING:
+            fprintf (emitter->out, "static spk_string_t *spk_global_%u; // %s\n", var->slot, var->name);
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+spk_c_emit_statement (spk_c_emitter_t *emitter, const spk_statement_t *stmt)
+{
+    auto out = emitter->out;
+    const spk_expr_t *expr = nullptr;
+
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            expr = stmt->print.expr;
+            if (expr->value_type == SPK_VALUE_TYPE_INTEGER) {
+                fprintf (out, "    spk_print_int (");
+            } else if (expr->value_type == SPK_VALUE_TYPE_STRING) {
+                fprintf (out, "    spk_print_string (");
+            } else {
+                fprintf (out, "    spk_print_nil ();\n");
+                return;
+            }
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            expr = stmt->expr.expr;
+            if (expr->value_type == SPK_VALUE_TYPE_INTEGER) {
+                fprintf (out, "    (void)(");
+            } else if (expr->value_type == SPK_VALUE_TYPE_STRING) {
+                fprintf (out, "    spk_release (");
+            } else {
+                return;
+            }
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            expr = stmt->var.initializer;
+            if (!expr || expr->value_type == SPK_VALUE_TYPE_NIL) {
+                return;
+            }
+            fprintf (out, "    spk_global_%u = (", stmt->var.slot);
+            break;
+        default:
+            return;
+    }
+
+    spk_c_emit_expression (emitter, expr);
+    fprintf (out, ");\n");
+}
+
+bool
+spk_emit_c (darray_t *statements, FILE *out)
+{
+    spk_c_emitter_t emitter = { .out = out };
+
+    fprintf (out, "// Generated by spk-interp --emit-c\n\n%s\n", spk_c_prelude);
+
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_statement_t *stmt = darray_elem (statements, i);
+        if (stmt->type == SPK_STATEMENT_TYPE_VAR) {
+            spk_c_emit_global (&emitter, &stmt->var);
+        }
+    }
+
+    fprintf (out, "\nint\nmain (void)\n{\n");
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_c_emit_statement (&emitter, darray_elem (statements, i));
+    }
+    fprintf (out, "    return 0;\n}\n");
+
+    return !ferror (out);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../utils/darray.h"
+
+#include <stdio.h>
+
+/*
+ C backend: translates a whole program into a single C file that needs
+ nothing but the C library, for the system compiler to optimize and
+ build. Globals become typed static variables, int operators native
+ int32_t operations and strings pointers to refcounted strings, with the
+ few string and print helpers the program calls defined in the file.
+
+ Ints wrap on overflow and division by zero stops the program with a
+ runtime error, the file never relies on undefined behavior.
+*/
+
+// Statements have to be resolved and type checked ([spk_statement_t, ...]).
+// Returns false if writing to out failed.
+bool spk_emit_c (darray_t *statements, FILE *out);
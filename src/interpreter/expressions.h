@@ -6,6 +6,9 @@
 
 typedef struct spk_expr_s spk_expr_t;
 
+// Slot of a variable the resolver hasn't bound (yet)
+#define SPK_SLOT_UNRESOLVED UINT32_MAX
+
 typedef struct spk_literal_expr_s {
     spk_token_literal_t value;
 } spk_literal_expr_t;
@@ -15,18 +18,20 @@ typedef struct spk_grouping_expr_s {
 } spk_grouping_expr_t;
 
 typedef struct spk_unary_expr_s {
-    spk_token_t operator;
-    spk_expr_t  *right;
+    SPK_token_type operator;
+    spk_expr_t     *right;
 } spk_unary_expr_t;
 
 typedef struct spk_binary_expr_s {
-    spk_expr_t  *left;
-    spk_token_t operator;
-    spk_expr_t  *right;
+    spk_expr_t     *left;
+    SPK_token_type operator;
+    spk_expr_t     *right;
 } spk_binary_expr_t;
 
 typedef struct spk_var_expr_s {
-    spk_token_t name;
+    spk_symbol_t symbol;
+    const char   *name; // Interned, only kept around for error messages
+    uint32_t     slot;  // Global slot, filled in by the resolver
 } spk_var_expr_t;
 
 typedef enum {
@@ -37,8 +42,17 @@ typedef enum {
     SPK_EXPR_TYPE_VAR,
 } SPK_expr_type;
 
+// Static type of an expression's value, filled in by the type checker
+typedef enum {
+    SPK_VALUE_TYPE_UNKNOWN,
+    SPK_VALUE_TYPE_NIL,
+    SPK_VALUE_TYPE_INTEGER,
+    SPK_VALUE_TYPE_STRING,
+} SPK_value_type;
+
 typedef struct spk_expr_s {
-    SPK_expr_type type;
+    SPK_expr_type  type;
+    SPK_value_type value_type;
     union {
         spk_literal_expr_t  literal;
         spk_grouping_expr_t grouping;
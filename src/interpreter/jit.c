@@ -0,0 +1,486 @@
+#include "jit.h"
+#include "ast_interpreter.h"
+#include "context.h"
+#include "statements.h"
+#include "value.h"
+
+#include "../utils/darray.h"
+#include "../utils/vec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#if defined (__x86_64__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// What a compiled statement is called with, its globals already reserved.
+// Returns false on a division by zero, before the statement had any effect.
+typedef bool (*spk_jit_fn_t) (spk_value_t *globals);
+
+SPK_VEC_DECLARE (spk_jit_offset_vec, uint32_t)
+
+typedef enum {
+    SPK_JIT_STATE_COLD,        // Interpreted, still counting
+    SPK_JIT_STATE_COMPILED,    // Runs natively
+    SPK_JIT_STATE_UNSUPPORTED, // Interpreted for good
+} SPK_jit_state;
+
+typedef struct spk_jit_entry_s {
+    SPK_jit_state state;
+    uint32_t      hits;
+    spk_jit_fn_t  fn;
+} spk_jit_entry_t;
+
+typedef struct spk_jit_region_s {
+    uint8_t *base;
+    size_t  size;
+    size_t  used;
+} spk_jit_region_t;
+
+struct spk_jit_s {
+    spk_jit_entry_t *entries;
+    size_t          entry_count;
+    uint32_t        threshold;
+    size_t          compiled_count;
+
+    darray_t *regions; // [spk_jit_region_t, ...], the last one is filled
+    darray_t *code;    // [uint8_t, ...], statement being emitted
+    // Where the rel32 of each jump to the statement's error exit is
+    spk_jit_offset_vec_t error_jumps;
+};
+
+#define SPK_JIT_REGION_SIZE ((size_t)64 * 1024)
+
+spk_jit_t *
+spk_jit_create (size_t statement_count, uint32_t threshold)
+{
+    spk_jit_t *jit = calloc (1, sizeof (spk_jit_t));
+    jit->entries = calloc (statement_count + 1, sizeof (spk_jit_entry_t));
+    jit->entry_count = statement_count;
+    jit->threshold = threshold;
+    jit->regions = darray_empty (sizeof (spk_jit_region_t));
+    jit->code = darray_empty (sizeof (uint8_t));
+    spk_jit_offset_vec_init (&jit->error_jumps);
+    return jit;
+}
+
+size_t
+spk_jit_compiled_count (const spk_jit_t *jit)
+{
+    return jit->compiled_count;
+}
+
+#if defined (__x86_64__)
+
+bool
+spk_jit_supported ()
+{
+    return true;
+}
+
+void
+spk_jit_free (spk_jit_t *jit)
+{
+    for (size_t i = 0; i < jit->regions->count; ++i) {
+        spk_jit_region_t *region = darray_elem (jit->regions, i);
+        munmap (region->base, region->size);
+    }
+
+    darray_free (jit->regions);
+    darray_free (jit->code);
+    spk_jit_offset_vec_free (&jit->error_jumps);
+    free (jit->entries);
+    free (jit);
+}
+
+/* Executable memory */
+
+// Regions are only ever writable or executable. Appending remaps the
+// pages it touches writable for the copy, nothing runs meanwhile.
+static void *
+spk_jit_install (spk_jit_t *jit, const uint8_t *code, size_t size)
+{
+    spk_jit_region_t *region = nullptr;
+    if (jit->regions->count > 0) {
+        region = darray_elem (jit->regions, jit->regions->count - 1);
+        if (region->size - region->used < size) {
+            region = nullptr;
+        }
+    }
+
+    size_t page_size = (size_t)sysconf (_SC_PAGESIZE);
+    if (!region) {
+        size_t region_size = SPK_JIT_REGION_SIZE;
+        if (size > region_size) {
+            region_size = (size + page_size - 1) & ~(page_size - 1);
+        }
+
+        void *base = mmap (nullptr, region_size, PROT_READ | PROT_EXEC,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return nullptr;
+        }
+
+        darray_append_v (jit->regions, ((spk_jit_region_t) { base, region_size, 0 }));
+        region = darray_elem (jit->regions, jit->regions->count - 1);
+    }
+
+    uint8_t *target = region->base + region->used;
+    uint8_t *first_page = (uint8_t *)((uintptr_t)target & ~(uintptr_t)(page_size - 1));
+    size_t span = (size_t)(target + size - first_page);
+
+    if (mprotect (first_page, span, PROT_READ | PROT_WRITE) != 0) {
+        return nullptr;
+    }
+
+    memcpy (target, code, size);
+    if (mprotect (first_page, span, PROT_READ | PROT_EXEC) != 0) {
+        return nullptr;
+    }
+
+    // Keeps the next statement 16 bytes aligned
+    region->used += (size + 15) & ~(size_t)15;
+    if (region->used > region->size) {
+        region->used = region->size;
+    }
+
+    return target;
+}
+
+/* Emitter */
+
+// Largest slot a disp32 operand reaches
+#define SPK_JIT_MAX_SLOT ((uint32_t)(INT32_MAX / sizeof (spk_value_t)))
+
+static void
+spk_jit_emit (spk_jit_t *jit, const uint8_t *bytes, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        darray_append (jit->code, &bytes[i]);
+    }
+}
+
+#define SPK_JIT_EMIT(jit, ...) do { \
+    const uint8_t _bytes[] = { __VA_ARGS__ }; \
+    spk_jit_emit ((jit), _bytes, sizeof (_bytes)); \
+} while (false)
+
+static void
+spk_jit_emit_u32 (spk_jit_t *jit, uint32_t value)
+{
+    SPK_JIT_EMIT (jit, (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16),
+                       (uint8_t)(value >> 24));
+}
+
+static void
+spk_jit_emit_u64 (spk_jit_t *jit, uint64_t value)
+{
+    spk_jit_emit_u32 (jit, (uint32_t)value);
+    spk_jit_emit_u32 (jit, (uint32_t)(value >> 32));
+}
+
+// Whether expr is an int tree made of nothing but what the templates cover
+static bool
+spk_jit_int_supported (const spk_expr_t *expr)
+{
+    if (expr->value_type != SPK_VALUE_TYPE_INTEGER) {
+        return false;
+    }
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            return true;
+        case SPK_EXPR_TYPE_GROUPING:
+            return spk_jit_int_supported (expr->grouping.expr);
+        case SPK_EXPR_TYPE_UNARY:
+            return (expr->unary.operator == SPK_TOKEN_TYPE_MINUS ||
+                    expr->unary.operator == SPK_TOKEN_TYPE_NOT) &&
+                   spk_jit_int_supported (expr->unary.right);
+        case SPK_EXPR_TYPE_BINARY:
+            // String == and != are int-typed, their operands aren't
+            return spk_jit_int_supported (expr->binary.left) &&
+                   spk_jit_int_supported (expr->binary.right);
+        case SPK_EXPR_TYPE_VAR:
+            return expr->var.slot <= SPK_JIT_MAX_SLOT;
+        default:
+            return false;
+    }
+}
+
+// Operands that are loaded into a register straight away
+static const spk_expr_t *
+spk_jit_leaf (const spk_expr_t *expr)
+{
+    while (expr->type == SPK_EXPR_TYPE_GROUPING) {
+        expr = expr->grouping.expr;
+    }
+
+    if (expr->type == SPK_EXPR_TYPE_LITERAL || expr->type == SPK_EXPR_TYPE_VAR) {
+        return expr;
+    }
+
+    return nullptr;
+}
+
+// mov eax, imm32 / mov eax, [rdi + disp32], or ecx for second_register
+static void
+spk_jit_emit_leaf (spk_jit_t *jit, const spk_expr_t *leaf, bool second_register)
+{
+    if (leaf->type == SPK_EXPR_TYPE_LITERAL) {
+        SPK_JIT_EMIT (jit, second_register ? 0xB9 : 0xB8);
+        spk_jit_emit_u32 (jit, (uint32_t)leaf->literal.value.integer.value);
+    } else {
+        SPK_JIT_EMIT (jit, 0x8B, second_register ? 0x8F : 0x87);
+        spk_jit_emit_u32 (jit, leaf->var.slot * (uint32_t)sizeof (spk_value_t));
+    }
+}
+
+// Leaves the result in eax, clobbers ecx and edx
+static void
+spk_jit_emit_int (spk_jit_t *jit, const spk_expr_t *expr);
+
+static void
+spk_jit_emit_unary (spk_jit_t *jit, const spk_unary_expr_t *expr)
+{
+    spk_jit_emit_int (jit, expr->right);
+
+    if (expr->operator == SPK_TOKEN_TYPE_MINUS) {
+        SPK_JIT_EMIT (jit, 0xF7, 0xD8);             // neg eax
+    } else {
+        SPK_JIT_EMIT (jit, 0x85, 0xC0,              // test eax, eax
+                           0x0F, 0x94, 0xC0,        // sete al
+                           0x0F, 0xB6, 0xC0);       // movzx eax, al
+    }
+}
+
+// Second byte of setcc, left is compared to right
+static uint8_t
+spk_jit_setcc (SPK_token_type operator)
+{
+    switch (operator) {
+        case SPK_TOKEN_TYPE_GREATER:       return 0x9F;
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: return 0x9D;
+        case SPK_TOKEN_TYPE_LESS:          return 0x9C;
+        case SPK_TOKEN_TYPE_LESS_EQUAL:    return 0x9E;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:   return 0x94;
+        case SPK_TOKEN_TYPE_NOT_EQUAL:     return 0x95;
+        default:
+            assert (false);
+            return 0;
+    }
+}
+
+static void
+spk_jit_emit_binary (spk_jit_t *jit, const spk_binary_expr_t *expr)
+{
+    // Left ends up in eax and right in ecx
+    spk_jit_emit_int (jit, expr->left);
+
+    auto right_leaf = spk_jit_leaf (expr->right);
+    if (right_leaf) {
+        spk_jit_emit_leaf (jit, right_leaf, true);
+    } else {
+        SPK_JIT_EMIT (jit, 0x50);                   // push rax
+        spk_jit_emit_int (jit, expr->right);
+        SPK_JIT_EMIT (jit, 0x89, 0xC1,              // mov ecx, eax
+                           0x58);                   // pop rax
+    }
+
+    switch (expr->operator) {
+        case SPK_TOKEN_TYPE_PLUS:
+            SPK_JIT_EMIT (jit, 0x01, 0xC8);         // add eax, ecx
+            break;
+        case SPK_TOKEN_TYPE_MINUS:
+            SPK_JIT_EMIT (jit, 0x29, 0xC8);         // sub eax, ecx
+            break;
+        case SPK_TOKEN_TYPE_MULTIPLY:
+            SPK_JIT_EMIT (jit, 0x0F, 0xAF, 0xC1);   // imul eax, ecx
+            break;
+        case SPK_TOKEN_TYPE_DIVIDE:
+            // idiv faults on a zero divisor and on INT32_MIN / -1, neither reaches it
+            SPK_JIT_EMIT (jit, 0x85, 0xC9,          // test ecx, ecx
+                               0x0F, 0x84);         // jz error exit
+            spk_jit_offset_vec_push (&jit->error_jumps, (uint32_t)jit->code->count);
+            spk_jit_emit_u32 (jit, 0);
+            SPK_JIT_EMIT (jit, 0x83, 0xF9, 0xFF,    // cmp ecx, -1
+                               0x75, 0x04,          // jne divide
+                               0xF7, 0xD8,          // neg eax
+                               0xEB, 0x03,          // jmp done
+                               0x99,                // divide: cdq
+                               0xF7, 0xF9);         // idiv ecx
+                                                    // done:
+            break;
+        default:
+            SPK_JIT_EMIT (jit, 0x39, 0xC8,                          // cmp eax, ecx
+                               0x0F, spk_jit_setcc (expr->operator), 0xC0, // setcc al
+                               0x0F, 0xB6, 0xC0);                   // movzx eax, al
+            break;
+    }
+}
+
+static void
+spk_jit_emit_int (spk_jit_t *jit, const spk_expr_t *expr)
+{
+    auto leaf = spk_jit_leaf (expr);
+    if (leaf) {
+        spk_jit_emit_leaf (jit, leaf, false);
+        return;
+    }
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_GROUPING:
+            spk_jit_emit_int (jit, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            spk_jit_emit_unary (jit, &expr->unary);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            spk_jit_emit_binary (jit, &expr->binary);
+            break;
+        default:
+            assert (false);
+    }
+}
+
+static void
+spk_jit_print_int (int32_t value)
+{
+    spk_value_print (spk_value_int (value));
+}
+
+static const spk_expr_t *
+spk_jit_statement_expr (const spk_statement_t *stmt)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_EXPR:  return stmt->expr.expr;
+        case SPK_STATEMENT_TYPE_PRINT: return stmt->print.expr;
+        case SPK_STATEMENT_TYPE_VAR:   return stmt->var.initializer;
+        default:                       return nullptr;
+    }
+}
+
+// Returns nullptr if the statement has to stay in the interpreter
+static spk_jit_fn_t
+spk_jit_compile (spk_jit_t *jit, const spk_statement_t *stmt)
+{
+    auto expr = spk_jit_statement_expr (stmt);
+    if (!expr || !spk_jit_int_supported (expr) ||
+        (stmt->type == SPK_STATEMENT_TYPE_VAR && stmt->var.slot > SPK_JIT_MAX_SLOT)) {
+        return nullptr;
+    }
+
+    jit->code->count = 0;
+    spk_jit_offset_vec_clear (&jit->error_jumps);
+    SPK_JIT_EMIT (jit, 0x55,                        // push rbp
+                       0x48, 0x89, 0xE5);           // mov rbp, rsp
+
+    spk_jit_emit_int (jit, expr);
+
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_VAR:
+            // eax is zero-extended into rax, an int value is its payload
+            SPK_JIT_EMIT (jit, 0x48, 0x89, 0x87);   // mov [rdi + disp32], rax
+            spk_jit_emit_u32 (jit, stmt->var.slot * (uint32_t)sizeof (spk_value_t));
+            break;
+        case SPK_STATEMENT_TYPE_PRINT:
+            // The stack is balanced again, rsp is 16 byte aligned
+            SPK_JIT_EMIT (jit, 0x89, 0xC7,          // mov edi, eax
+                               0x48, 0xB8);         // mov rax, imm64
+            spk_jit_emit_u64 (jit, (uint64_t)(uintptr_t)spk_jit_print_int);
+            SPK_JIT_EMIT (jit, 0xFF, 0xD0);         // call rax
+            break;
+        default:
+            break;
+    }
+
+    SPK_JIT_EMIT (jit, 0xB8, 0x01, 0x00, 0x00, 0x00, // mov eax, 1
+                       0x5D,                        // pop rbp
+                       0xC3);                       // ret
+
+    // Error exit, whatever the templates pushed is dropped with the frame
+    if (jit->error_jumps.count > 0) {
+        auto exit = (uint32_t)jit->code->count;
+        for (size_t i = 0; i < jit->error_jumps.count; ++i) {
+            auto jump = jit->error_jumps.data[i];
+            uint32_t rel = exit - (jump + 4);
+            memcpy ((uint8_t *)jit->code->data + jump, &rel, sizeof (rel));
+        }
+
+        SPK_JIT_EMIT (jit, 0x48, 0x89, 0xEC,        // mov rsp, rbp
+                           0x31, 0xC0,              // xor eax, eax
+                           0x5D,                    // pop rbp
+                           0xC3);                   // ret
+    }
+
+    void *code = spk_jit_install (jit, jit->code->data, jit->code->count);
+    if (!code) {
+        printf ("Warning: failed to map memory for jitted code\n");
+        return nullptr;
+    }
+
+    spk_jit_fn_t fn;
+    static_assert (sizeof (fn) == sizeof (code));
+    memcpy (&fn, &code, sizeof (fn));
+    return fn;
+}
+
+bool
+spk_jit_run_statement (spk_jit_t *jit, spk_context_t *context, size_t index,
+                       const spk_statement_t *stmt)
+{
+    assert (index < jit->entry_count);
+    auto entry = &jit->entries[index];
+
+    if (entry->state == SPK_JIT_STATE_COLD && entry->hits++ >= jit->threshold) {
+        entry->fn = spk_jit_compile (jit, stmt);
+        entry->state = entry->fn ? SPK_JIT_STATE_COMPILED : SPK_JIT_STATE_UNSUPPORTED;
+        jit->compiled_count += entry->fn != nullptr;
+    }
+
+    if (entry->state != SPK_JIT_STATE_COMPILED) {
+        return spk_interpret_statement (context, stmt);
+    }
+
+    if (stmt->type == SPK_STATEMENT_TYPE_VAR) {
+        spk_context_reserve_globals (context, stmt->var.slot + 1);
+    }
+
+    if (!entry->fn (context->globals)) {
+        // The only error compiled statements have
+        printf ("Runtime error: Division by zero\n");
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+bool
+spk_jit_supported ()
+{
+    return false;
+}
+
+void
+spk_jit_free (spk_jit_t *jit)
+{
+    darray_free (jit->regions);
+    darray_free (jit->code);
+    spk_jit_offset_vec_free (&jit->error_jumps);
+    free (jit->entries);
+    free (jit);
+}
+
+bool
+spk_jit_run_statement (spk_jit_t *jit, spk_context_t *context, size_t index,
+                       const spk_statement_t *stmt)
+{
+    return spk_interpret_statement (context, stmt);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ Baseline template JIT for the ast engine, x86-64 System V only.
+
+ Statements are counted as the ast engine runs them. Once a statement has
+ run threshold times it is compiled on its own into a native function
+ taking the global slots: every AST node is emitted as a fixed template
+ (operands in eax and ecx, intermediates on the machine stack), there is
+ no register allocation. Int arithmetic, comparisons, int globals and the
+ three statement kinds are supported; a statement that touches a string
+ keeps running in the interpreter. Code lives in mmap'd regions that are
+ never writable and executable at the same time.
+
+ Results are the same as the interpreter's, down to wrapping overflow
+ and the runtime error a division by zero reports.
+*/
+
+typedef struct spk_jit_s spk_jit_t;
+typedef struct spk_statement_s spk_statement_t;
+typedef struct spk_context_s spk_context_t;
+
+// Whether this build can emit code for the machine it runs on
+bool spk_jit_supported ();
+
+// Statements are numbered by the caller, from 0 to statement_count - 1
+spk_jit_t *spk_jit_create (size_t statement_count, uint32_t threshold);
+void       spk_jit_free (spk_jit_t *jit);
+
+// Runs the statement the same way spk_interpret_statement does, natively
+// once it's hot and supported. Returns false after a runtime error.
+bool spk_jit_run_statement (spk_jit_t *jit, spk_context_t *context, size_t index,
+                            const spk_statement_t *stmt);
+
+// Statements running natively so far
+size_t spk_jit_compiled_count (const spk_jit_t *jit);
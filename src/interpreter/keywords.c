@@ -0,0 +1,122 @@
+#include "keywords.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+// Must be a power of two, at least twice the number of keywords
+// so that a collision-free multiplier is quick to find
+#define SPK_KEYWORD_TABLE_SIZE 64
+
+typedef struct spk_keyword_s {
+    const char     *spelling;
+    uint32_t       len;
+    SPK_token_type type;
+} spk_keyword_t;
+
+// Entries without a spelling are skipped, their len is meaningless
+#define SPK_TOKEN_TYPE(t, n) { n, sizeof (n) - 1, t },
+static const spk_keyword_t spk_token_spellings[] = {
+    SPK_TOKEN_ENUM_ITER()
+};
+#undef SPK_TOKEN_TYPE
+
+// Table slots keep the spelling inline so a lookup touches one cache line
+#define SPK_KEYWORD_MAX_LEN 11
+
+#define SPK_TOKEN_TYPE(t, n) \
+    static_assert (sizeof (n) <= SPK_KEYWORD_MAX_LEN + 1, "Keyword " #n " is too long");
+SPK_TOKEN_ENUM_ITER()
+#undef SPK_TOKEN_TYPE
+
+typedef struct spk_keyword_slot_s {
+    char           spelling[SPK_KEYWORD_MAX_LEN + 1];
+    uint8_t        len;
+    SPK_token_type type;
+} spk_keyword_slot_t;
+
+static struct {
+    spk_keyword_slot_t table[SPK_KEYWORD_TABLE_SIZE];
+    uint32_t           multiplier;
+} spk_keywords;
+
+static inline uint32_t
+spk_keyword_hash (uint32_t multiplier, const char *text, uint32_t len)
+{
+    uint32_t key = (uint32_t)(uint8_t)text[0] << 16 |
+                   (uint32_t)(uint8_t)text[len - 1] << 8 |
+                   len;
+    return (key * multiplier) >> (32 - __builtin_ctz (SPK_KEYWORD_TABLE_SIZE));
+}
+
+static bool
+spk_keywords_try_build (uint32_t multiplier)
+{
+    memset (spk_keywords.table, 0, sizeof (spk_keywords.table));
+
+    for (size_t i = 0; i < sizeof (spk_token_spellings) / sizeof (spk_token_spellings[0]); ++i) {
+        auto keyword = &spk_token_spellings[i];
+        if (!keyword->spelling) {
+            continue;
+        }
+
+        auto slot = &spk_keywords.table[spk_keyword_hash (multiplier, keyword->spelling, keyword->len)];
+        if (slot->len) {
+            return false;
+        }
+
+        memcpy (slot->spelling, keyword->spelling, keyword->len);
+        slot->len = (uint8_t)keyword->len;
+        slot->type = keyword->type;
+    }
+
+    return true;
+}
+
+// The keyword set is fixed at compile time, so the table is built once
+// before main and is read-only afterwards
+__attribute__((constructor)) static void
+spk_keywords_init ()
+{
+    // Odd multipliers from a fixed sequence, the first one without
+    // collisions makes the hash perfect for this keyword set
+    uint32_t multiplier = 0x9e3779b1u;
+    for (uint32_t attempt = 0; attempt < 100000; ++attempt) {
+        if (spk_keywords_try_build (multiplier)) {
+            spk_keywords.multiplier = multiplier;
+            return;
+        }
+
+        multiplier = multiplier * 1664525u + 1013904223u;
+        multiplier |= 1;
+    }
+
+    printf ("Failed to build a perfect hash for the keyword table\n");
+    abort ();
+}
+
+SPK_token_type
+spk_keyword_lookup (const char *text, size_t len)
+{
+    // Identifiers are never empty. Over-long ones hash like any other
+    // identifier and are rejected by the length check below
+    assert (len > 0);
+
+    auto entry = &spk_keywords.table[spk_keyword_hash (spk_keywords.multiplier, text, (uint32_t)len)];
+    if (entry->len != len) {
+        return SPK_TOKEN_TYPE_IDENTIFIER;
+    }
+
+    // First and last characters are part of the hash key, so only the
+    // middle of the spelling is left to compare
+    for (size_t i = 1; i + 1 < len; ++i) {
+        if (entry->spelling[i] != text[i]) {
+            return SPK_TOKEN_TYPE_IDENTIFIER;
+        }
+    }
+
+    return entry->spelling[0] == text[0] && entry->spelling[len - 1] == text[len - 1] ?
+           entry->type : SPK_TOKEN_TYPE_IDENTIFIER;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "token.h"
+
+#include <stddef.h>
+
+// Classifies an identifier, returning the keyword's token type or
+// SPK_TOKEN_TYPE_IDENTIFIER. The lookup is a perfect hash over the
+// keywords in SPK_TOKEN_ENUM_ITER() followed by a single compare
+// against the one candidate keyword. len must be greater than zero.
+SPK_token_type spk_keyword_lookup (const char *text, size_t len);
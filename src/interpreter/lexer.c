@@ -1,26 +1,50 @@
 #include "lexer.h"
 #include "token.h"
+#include "keywords.h"
+#include "scan.h"
+#include "../utils/stats.h"
 
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
 
-static uint32_t curr_line = 1;
+typedef struct spk_lexer_error_s {
+    uint32_t   line;
+    const char *msg;
+    char       character; // The offending character, if any
+} spk_lexer_error_t;
+
+SPK_VEC_DECLARE (spk_lexer_error_vec, spk_lexer_error_t)
 
 typedef struct spk_lexer_ctx_s {
     const char *source;
-    
+    const char *end;
+
     const char *start;
     const char *current;
 
-    spk_token_list_t tokens;
+    spk_token_vec_t    tokens;
+    spk_symbol_table_t *symbols;
+
+    uint32_t line;
+    // Reported once lexing is done, chunks lexed on other threads only
+    // know their lines relative to where they started
+    spk_lexer_error_vec_t errors;
+
+    // More source follows end, lexemes that run into it are retried
+    // once the window grew (see spk_token_stream_t)
+    bool partial;
 } spk_lexer_ctx_t;
 
 static inline bool
 spk_lexer_at_end (spk_lexer_ctx_t *ctx)
 {
-    return *(ctx->current) == '\0';
+    return ctx->current >= ctx->end;
 }
 
 static char
@@ -46,82 +70,89 @@ spk_lexer_match (spk_lexer_ctx_t *ctx, char c)
 }
 
 static void
-spk_lexer_report_err (uint32_t line, const char *msg)
+spk_lexer_print_err (uint32_t line, const char *msg)
 {
     printf ("Error: %s, line %d\n", msg, line);
 }
 
 static void
-spk_insert_token (spk_lexer_ctx_t *ctx, SPK_token_type type)
+spk_lexer_report_err (spk_lexer_ctx_t *ctx, const char *msg, char character)
 {
-    char *buf = nullptr;
-    if (!spk_lexer_at_end (ctx) && ctx->start && ctx->current) {
-        size_t len = (size_t)(ctx->current - ctx->start) + 1;
-        buf = calloc (len, sizeof (char));
-        memcpy (buf, ctx->start, len - 1);
+    spk_lexer_error_vec_push (&ctx->errors, (spk_lexer_error_t) {
+        .line = ctx->line,
+        .msg = msg,
+        .character = character
+    });
+}
+
+// Returns whether there were any
+static bool
+spk_lexer_flush_errors (spk_lexer_ctx_t *ctx, uint32_t line_base)
+{
+    bool any = ctx->errors.count > 0;
+    for (size_t i = 0; i < ctx->errors.count; ++i) {
+        auto error = &ctx->errors.data[i];
+        spk_lexer_print_err (line_base + error->line, error->msg);
+        if (error->character) {
+            printf ("Character = %c\n", error->character);
+        }
     }
 
-    spk_token_literal_t literal = {
-        .type = SPK_TOKEN_LITERAL_EMPTY
-    };
+    spk_lexer_error_vec_clear (&ctx->errors);
+    return any;
+}
 
-    switch (type) {
-        case SPK_TOKEN_TYPE_IDENTIFIER:
-#define SPK_TOKEN_TYPE(t, n) \
-            if (n && strcmp(n, buf) == 0) { \
-                type = t; \
-            }
-            SPK_TOKEN_ENUM_ITER();
-#undef SPK_TOKEN_TYPE
-            break;
-        case SPK_TOKEN_TYPE_STRING:
-            literal.type = SPK_TOKEN_LITERAL_STRING;
-            literal.string.value = buf;
-            break;
-        case SPK_TOKEN_TYPE_INTEGER:
-            literal.type = SPK_TOKEN_LITERAL_INTEGER;
-            // atoi should be safe here as we've already
-            // verified that the token is a valid integer
-            literal.integer.value = atoi (buf);
-            break;
-        default:
-            break;
+static void
+spk_insert_token (spk_lexer_ctx_t *ctx, SPK_token_type type)
+{
+    size_t len = (size_t)(ctx->current - ctx->start);
+    spk_symbol_t symbol = SPK_SYMBOL_NONE;
+
+    if (type == SPK_TOKEN_TYPE_IDENTIFIER) {
+        type = spk_keyword_lookup (ctx->start, len);
+    }
+
+    if (type == SPK_TOKEN_TYPE_IDENTIFIER) {
+        symbol = spk_symbol_intern (ctx->symbols, ctx->start, len);
     }
 
-    darray_append_v (ctx->tokens, ((spk_token_t) {
+    spk_token_vec_push (&ctx->tokens, (spk_token_t) {
         .type = type,
-        .value = buf,
-        .literal = literal,
-        .line = curr_line
-    }));
+        .line = ctx->line,
+        .offset = (uint32_t)(ctx->start - ctx->source),
+        .length = (uint32_t)len,
+        .symbol = symbol
+    });
 }
 
 static void
 spk_consume_comment (spk_lexer_ctx_t *ctx)
 {
     if (spk_lexer_at_end (ctx)) {
-        spk_lexer_report_err (curr_line,
-                              "Tried to consume comment at end of file");
+        spk_lexer_report_err (ctx, "Tried to consume comment at end of file", '\0');
         return;
     }
-    
-    while (*ctx->current != '\n') {
-        ctx->current++;
-    }
+
+    ctx->current = spk_scan_until (ctx->current, ctx->end, '\n', nullptr);
 }
 
-static void
+// Returns false if the string runs past the end of a partial window
+static bool
 spk_try_consume_string (spk_lexer_ctx_t *ctx)
 {
-    while (!spk_lexer_at_end (ctx) && *ctx->current != '"') {
-        if (spk_lexer_advance (ctx) == '\n') {
-            curr_line++;
-        }
+    uint32_t lines = 0;
+    ctx->current = spk_scan_until (ctx->current, ctx->end, '"', &lines);
+
+    if (spk_lexer_at_end (ctx) && ctx->partial) {
+        ctx->current = ctx->start;
+        return false;
     }
 
+    ctx->line += lines;
+
     if (spk_lexer_at_end (ctx)) {
-        spk_lexer_report_err(curr_line, "Unterminated string");
-        return;
+        spk_lexer_report_err (ctx, "Unterminated string", '\0');
+        return true;
     }
 
     // FIXME: Strip new lines for multi-line stings
@@ -131,6 +162,7 @@ spk_try_consume_string (spk_lexer_ctx_t *ctx)
     ctx->start++;
     spk_insert_token (ctx, SPK_TOKEN_TYPE_STRING);
     ctx->current++;
+    return true;
 }
 
 static inline bool
@@ -142,24 +174,35 @@ spk_is_digit (char c)
 static void
 spk_consume_number (spk_lexer_ctx_t *ctx)
 {
-    while (spk_is_digit(*ctx->current)) {
+    while (!spk_lexer_at_end (ctx) && spk_is_digit (*ctx->current)) {
         spk_lexer_advance (ctx);
     }
 
-    if (*ctx->current == '.') {
-        spk_lexer_report_err (curr_line, "Fractional numbers not supported");
+    if (!spk_lexer_at_end (ctx) && *ctx->current == '.') {
+        spk_lexer_report_err (ctx, "Fractional numbers not supported", '\0');
 
         // Consume '.'
         spk_lexer_advance (ctx);
 
         // Consume fractional part
-        while (spk_is_digit(*ctx->current)) {
+        while (!spk_lexer_at_end (ctx) && spk_is_digit (*ctx->current)) {
             spk_lexer_advance (ctx);
         }
 
         return;
     }
-    
+
+    // Stops accumulating once too large, the digits can go on for a while
+    uint64_t value = 0;
+    for (auto digit = ctx->start; digit < ctx->current && value <= INT32_MAX; ++digit) {
+        value = value * 10 + (uint64_t)(*digit - '0');
+    }
+
+    if (value > INT32_MAX) {
+        spk_lexer_report_err (ctx, "Integer literal doesn't fit in 32 bits", '\0');
+        return;
+    }
+
     spk_insert_token (ctx, SPK_TOKEN_TYPE_INTEGER);
 }
 
@@ -171,122 +214,544 @@ spk_is_valid_ident_start (char c)
             c == '_'; // FIXME: Should _ be a valid ident start?
 }
 
-static inline bool
-spk_is_valid_ident_char (char c)
+static void
+spk_consume_identifier (spk_lexer_ctx_t *ctx)
+{
+    ctx->current = spk_scan_identifier (ctx->current, ctx->end);
+
+    spk_insert_token (ctx, SPK_TOKEN_TYPE_IDENTIFIER);
+}
+
+// Lexes the lexeme starting at ctx->current, returns false if it needs
+// more source than the window holds and consumed nothing
+static bool
+spk_lexer_scan (spk_lexer_ctx_t *ctx)
+{
+    ctx->start = ctx->current;
+    auto curr = spk_lexer_advance (ctx);
+
+    switch (curr) {
+        case '#':
+            spk_consume_comment (ctx);
+            break;
+        case '=':
+            spk_insert_token (ctx,
+                    spk_lexer_match (ctx, '=') ?
+                        SPK_TOKEN_TYPE_EQUAL_EQUAL :
+                        SPK_TOKEN_TYPE_EQUAL);
+            break;
+        case '&':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_AND);
+            break;
+        case '|':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_OR);
+            break;
+        case '!':
+            spk_insert_token (ctx,
+                    spk_lexer_match (ctx, '=') ?
+                        SPK_TOKEN_TYPE_NOT_EQUAL :
+                        SPK_TOKEN_TYPE_NOT);
+            break;
+        case '>':
+            spk_insert_token (ctx,
+                    spk_lexer_match (ctx, '=') ?
+                        SPK_TOKEN_TYPE_GREATER_EQUAL :
+                        SPK_TOKEN_TYPE_GREATER);
+            break;
+        case '<':
+            spk_insert_token (ctx,
+                    spk_lexer_match (ctx, '=') ?
+                        SPK_TOKEN_TYPE_LESS_EQUAL :
+                        SPK_TOKEN_TYPE_LESS);
+            break;
+        case '+':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_PLUS);
+            break;
+        case '-':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_MINUS);
+            break;
+        case '/':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_DIVIDE);
+            break;
+        case '*':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_MULTIPLY);
+            break;
+        case '(':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_LEFT_PAREN);
+            break;
+        case ')':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_RIGHT_PAREN);
+            break;
+        case '{':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_LEFT_BRACE);
+            break;
+        case '}':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_RIGHT_BRACE);
+            break;
+        case ';':
+            spk_insert_token (ctx, SPK_TOKEN_TYPE_SEMICOLON);
+            break;
+        case '"':
+            return spk_try_consume_string (ctx);
+        case '\n':
+            ctx->line++;
+            [[fallthrough]];
+        case ' ':
+        case '\r':
+        case '\t':
+            // Indentation and blank lines come in runs
+            ctx->current = spk_scan_whitespace (ctx->current, ctx->end, &ctx->line);
+            break;
+        default:
+            if (spk_is_digit (curr)) {
+                spk_consume_number (ctx);
+            } else if (spk_is_valid_ident_start (curr)) {
+                spk_consume_identifier (ctx);
+            } else {
+                spk_lexer_report_err (ctx, "Unknown character", curr);
+            }
+
+            break;
+    }
+
+    return true;
+}
+
+static void
+spk_lexer_init (spk_lexer_ctx_t *ctx, const char *source, const char *begin,
+                const char *end, spk_symbol_table_t *symbols, bool partial)
 {
-    return spk_is_valid_ident_start (c) || spk_is_digit (c);
+    *ctx = (spk_lexer_ctx_t) {
+        .source = source,
+        .end = end,
+        .start = begin,
+        .current = begin,
+        .symbols = symbols,
+        .line = 1,
+        .partial = partial
+    };
+
+    spk_token_vec_init (&ctx->tokens);
+    spk_lexer_error_vec_init (&ctx->errors);
 }
 
 static void
-spk_consume_identifier (spk_lexer_ctx_t *ctx)
+spk_lexer_destroy (spk_lexer_ctx_t *ctx)
+{
+    spk_lexer_error_vec_free (&ctx->errors);
+    spk_token_vec_free (&ctx->tokens);
+}
+
+// Stops early, at the start of the string, if a string runs past a partial end
+static void
+spk_lexer_run (spk_lexer_ctx_t *ctx)
 {
-    while (spk_is_valid_ident_char(*ctx->current)) {
-        (void)spk_lexer_advance (ctx);
+    while (!spk_lexer_at_end (ctx) && spk_lexer_scan (ctx)) {
     }
+}
 
-    spk_insert_token (ctx, SPK_TOKEN_TYPE_IDENTIFIER);
+// Returns nullptr, the errors printed, if failed
+static spk_token_list_t *
+spk_lexer_finish (spk_lexer_ctx_t *ctx, size_t len, bool failed)
+{
+    if (failed) {
+        spk_lexer_destroy (ctx);
+        return nullptr;
+    }
+
+    ctx->start = ctx->current;
+    spk_insert_token (ctx, SPK_TOKEN_TYPE_EOF);
+
+    spk_token_list_t *list = calloc (1, sizeof (spk_token_list_t));
+    spk_token_vec_shrink (&ctx->tokens);
+    list->tokens = ctx->tokens;
+    list->source = ctx->source;
+    list->source_len = len;
+    list->symbols = ctx->symbols;
+    SPK_STATS_ADD (tokens, list->tokens.count);
+
+    spk_token_vec_init (&ctx->tokens);
+    spk_lexer_destroy (ctx);
+    return list;
+}
+
+static uint32_t
+spk_lexer_default_threads ()
+{
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    return cpus > 1 ? (uint32_t)cpus : 1;
+}
+
+spk_token_list_t *
+spk_tokenize_source (const char *src, size_t len, spk_symbol_table_t *symbols)
+{
+    return spk_tokenize_source_parallel (src, len, symbols, spk_lexer_default_threads ());
+}
+
+/*
+ Parallel lexing. The source is cut into chunks right after newlines,
+ which can only be inside a string, never inside a comment or any other
+ token. Every chunk is lexed on its own, interning into a table of its
+ own, on the assumption that it doesn't start inside a string.
+
+ The chunks are then walked in order on the calling thread. A chunk's
+ lexer that runs into the end of the chunk in the middle of a string
+ stops at the string's opening quote, the next chunk is lexed again from
+ there. Symbols are interned into the caller's table in order of first
+ use and errors printed with their real lines. Last, every chunk copies
+ its tokens into place with rebased lines and symbols, so the result is
+ the same as lexing the source in one go.
+*/
+
+typedef struct spk_lexer_chunk_s {
+    spk_lexer_ctx_t    ctx;
+    const char         *begin;
+    spk_symbol_table_t *symbols;
+
+    // Filled in once every chunk before this one is known
+    spk_symbol_t *remap;     // Chunk symbol -> caller's symbol
+    uint32_t     line_base;
+    spk_token_t  *out;
+} spk_lexer_chunk_t;
+
+typedef void (*spk_lexer_job_fn_t) (spk_lexer_chunk_t *chunk);
+
+typedef struct spk_lexer_pool_s {
+    spk_lexer_chunk_t  *chunks;
+    uint32_t           chunk_count;
+    atomic_uint        next;
+    spk_lexer_job_fn_t job;
+} spk_lexer_pool_t;
+
+static void *
+spk_lexer_worker (void *arg)
+{
+    spk_lexer_pool_t *pool = arg;
+
+    for (;;) {
+        uint32_t i = atomic_fetch_add (&pool->next, 1);
+        if (i >= pool->chunk_count) {
+            return nullptr;
+        }
+
+        pool->job (&pool->chunks[i]);
+    }
+}
+
+// The calling thread is one of the workers, chunks left over by
+// threads that failed to start are picked up by the others
+static void
+spk_lexer_pool_run (spk_lexer_pool_t *pool, spk_lexer_job_fn_t job, uint32_t threads)
+{
+    pool->job = job;
+    atomic_store (&pool->next, 0);
+
+    pthread_t *workers = calloc (threads, sizeof (pthread_t));
+    uint32_t started = 0;
+    while (started + 1 < threads &&
+           pthread_create (&workers[started], nullptr, spk_lexer_worker, pool) == 0) {
+        ++started;
+    }
+
+    spk_lexer_worker (pool);
+    for (uint32_t i = 0; i < started; ++i) {
+        pthread_join (workers[i], nullptr);
+    }
+    free (workers);
+}
+
+static void
+spk_lexer_lex_chunk (spk_lexer_chunk_t *chunk)
+{
+    spk_lexer_run (&chunk->ctx);
+}
+
+static void
+spk_lexer_copy_chunk (spk_lexer_chunk_t *chunk)
+{
+    const spk_token_t *tokens = chunk->ctx.tokens.data;
+    size_t count = chunk->ctx.tokens.count;
+
+    for (size_t i = 0; i < count; ++i) {
+        spk_token_t token = tokens[i];
+        token.line += chunk->line_base;
+        if (token.symbol != SPK_SYMBOL_NONE) {
+            token.symbol = chunk->remap[token.symbol];
+        }
+        chunk->out[i] = token;
+    }
+}
+
+// Lexes the chunk again starting at resume, inside a string
+// the previous chunk ran into
+static void
+spk_lexer_relex_chunk (spk_lexer_chunk_t *chunk, const char *resume)
+{
+    // Symbols from the first attempt would otherwise show up in the remap
+    spk_symbol_table_free (chunk->symbols);
+    chunk->symbols = spk_symbol_table_create ();
+
+    chunk->ctx.symbols = chunk->symbols;
+    spk_token_vec_clear (&chunk->ctx.tokens);
+    spk_lexer_error_vec_clear (&chunk->ctx.errors);
+    chunk->ctx.line = 1;
+    chunk->ctx.start = resume;
+    chunk->ctx.current = resume;
+    spk_lexer_run (&chunk->ctx);
+}
+
+spk_token_list_t *
+spk_tokenize_source_parallel (const char *src, size_t len, spk_symbol_table_t *symbols,
+                              uint32_t threads)
+{
+    if (len > UINT32_MAX) {
+        spk_lexer_print_err (1, "Source file too large");
+        return nullptr;
+    }
+
+    spk_lexer_ctx_t ctx;
+    spk_lexer_init (&ctx, src, src, src + len, symbols, false);
+
+    uint32_t chunk_count = (uint32_t)(len / SPK_LEXER_MIN_CHUNK);
+    if (chunk_count > threads * 4) {
+        chunk_count = threads * 4;
+    }
+
+    if (threads <= 1 || chunk_count <= 1) {
+        spk_lexer_run (&ctx);
+        bool failed = spk_lexer_flush_errors (&ctx, 0);
+        return spk_lexer_finish (&ctx, len, failed);
+    }
+
+    spk_lexer_pool_t pool = {
+        .chunks = calloc (chunk_count, sizeof (spk_lexer_chunk_t)),
+        .chunk_count = 0
+    };
+
+    const char *end = src + len;
+    const char *begin = src;
+    for (uint32_t i = 1; i <= chunk_count && begin < end; ++i) {
+        const char *cut = end;
+        if (i < chunk_count) {
+            size_t target = len / chunk_count * i;
+            cut = memchr (src + target, '\n', len - target);
+            cut = cut ? cut + 1 : end;
+        }
+
+        if (cut <= begin) {
+            continue;
+        }
+
+        auto chunk = &pool.chunks[pool.chunk_count++];
+        chunk->begin = begin;
+        chunk->symbols = spk_symbol_table_create ();
+        spk_lexer_init (&chunk->ctx, src, begin, cut, chunk->symbols, cut < end);
+        begin = cut;
+    }
+
+    if (threads > pool.chunk_count) {
+        threads = pool.chunk_count;
+    }
+
+    spk_lexer_pool_run (&pool, spk_lexer_lex_chunk, threads);
+
+    // Only this pass is sequential: it fixes up chunks that started
+    // inside a string and interns symbols in the order they first
+    // appear, a chunk's own symbols are numbered in that order already
+    uint32_t line_base = 0;
+    size_t token_count = 0;
+    bool failed = false;
+    const char *resume = src;
+    for (uint32_t i = 0; i < pool.chunk_count; ++i) {
+        auto chunk = &pool.chunks[i];
+        if (chunk->begin != resume) {
+            spk_lexer_relex_chunk (chunk, resume);
+        }
+
+        uint32_t local_count = spk_symbol_count (chunk->symbols);
+        chunk->remap = malloc ((local_count + 1) * sizeof (spk_symbol_t));
+        spk_symbol_table_merge (symbols, chunk->symbols, chunk->remap);
+
+        failed = spk_lexer_flush_errors (&chunk->ctx, line_base) || failed;
+
+        chunk->line_base = line_base;
+        line_base += chunk->ctx.line - 1;
+        token_count += chunk->ctx.tokens.count;
+        resume = chunk->ctx.current;
+    }
+
+    spk_token_vec_reserve (&ctx.tokens, token_count + 1);
+    spk_token_t *out = ctx.tokens.data;
+    for (uint32_t i = 0; i < pool.chunk_count; ++i) {
+        pool.chunks[i].out = out;
+        out += pool.chunks[i].ctx.tokens.count;
+    }
+
+    spk_lexer_pool_run (&pool, spk_lexer_copy_chunk, threads);
+    ctx.tokens.count = token_count;
+
+    for (uint32_t i = 0; i < pool.chunk_count; ++i) {
+        free (pool.chunks[i].remap);
+        spk_lexer_destroy (&pool.chunks[i].ctx);
+        spk_symbol_table_free (pool.chunks[i].symbols);
+    }
+    free (pool.chunks);
+
+    ctx.line = line_base + 1;
+    ctx.current = end;
+    return spk_lexer_finish (&ctx, len, failed);
 }
 
-spk_token_list_t
-spk_tokenize_source (const char *src, size_t len)
+void
+spk_token_list_free (spk_token_list_t *list)
 {
-    spk_lexer_ctx_t ctx = {
-        .source = src,
-        .start = src,
-        .current = src,
-        .tokens = darray_empty (sizeof (spk_token_t))
+    spk_token_vec_free (&list->tokens);
+    free (list);
+}
+
+
+struct spk_token_stream_s {
+    FILE *file;
+    bool eof;
+
+    // Window onto the file, tokens' offsets are relative to its start
+    char   *buffer;
+    size_t length;
+    size_t capacity;
+
+    spk_lexer_ctx_t  lexer;
+    spk_token_list_t list; // Exposes the window to the parser, tokens is unused
+
+    // Token i is kept in ring[i % SPK_TOKEN_STREAM_RING]
+    spk_token_t ring[SPK_TOKEN_STREAM_RING];
+    size_t      produced;
+    bool        done; // The EOF token was produced
+};
+
+spk_token_stream_t *
+spk_token_stream_open (FILE *file, spk_symbol_table_t *symbols)
+{
+    spk_token_stream_t *stream = calloc (1, sizeof (spk_token_stream_t));
+    stream->file = file;
+    stream->capacity = SPK_TOKEN_STREAM_WINDOW;
+    stream->buffer = malloc (stream->capacity);
+
+    spk_lexer_init (&stream->lexer, stream->buffer, stream->buffer, stream->buffer,
+                    symbols, true);
+
+    stream->list = (spk_token_list_t) {
+        .source = stream->buffer,
+        .symbols = symbols
     };
 
-    while (!spk_lexer_at_end (&ctx)) {
-        ctx.start = ctx.current;
-        auto curr = spk_lexer_advance (&ctx);
-
-        switch (curr) {
-            case '#':
-                spk_consume_comment (&ctx);
-                continue;
-            case '=':
-                spk_insert_token (&ctx,
-                        spk_lexer_match (&ctx, '=') ?
-                            SPK_TOKEN_TYPE_EQUAL_EQUAL :
-                            SPK_TOKEN_TYPE_EQUAL);
-                break;
-            case '&':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_AND);
-                break;
-            case '|':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_OR);
-                break;
-            case '!':
-                spk_insert_token (&ctx,
-                        spk_lexer_match (&ctx, '=') ?
-                            SPK_TOKEN_TYPE_NOT_EQUAL :
-                            SPK_TOKEN_TYPE_NOT);
-                break;
-            case '>':
-                spk_insert_token (&ctx,
-                        spk_lexer_match (&ctx, '=') ?
-                            SPK_TOKEN_TYPE_GREATER_EQUAL :
-                            SPK_TOKEN_TYPE_GREATER);
-                break;
-            case '<':
-                spk_insert_token (&ctx,
-                        spk_lexer_match (&ctx, '=') ?
-                            SPK_TOKEN_TYPE_LESS_EQUAL :
-                            SPK_TOKEN_TYPE_LESS);
-                break;
-            case '+':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_PLUS);
-                break;
-            case '-':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_MINUS);
-                break;
-            case '/':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_DIVIDE);
-                break;
-            case '*':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_MULTIPLY);
-                break;
-            case '(':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_LEFT_PAREN);
-                break;
-            case ')':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_RIGHT_PAREN);
-                break;
-            case '{':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_LEFT_BRACE);
-                break;
-            case '}':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_RIGHT_BRACE);
-                break;
-            case ';':
-                spk_insert_token (&ctx, SPK_TOKEN_TYPE_SEMICOLON);
-                break;
-            case '"':
-                spk_try_consume_string (&ctx);
-                break;
-            case '\n':
-                curr_line++;
-                break;
-            case ' ':
-            case '\r':
-            case '\t':
-                break;
-            default:
-                if (spk_is_digit (curr)) {
-                    spk_consume_number (&ctx);
-                } else if (spk_is_valid_ident_start (curr)) {
-                    spk_consume_identifier (&ctx);
-                } else {
-                    spk_lexer_report_err (curr_line, "Unknown character");
-                    printf ("Character = %c\n", curr);
-                }
-
-                break;
+    return stream;
+}
+
+void
+spk_token_stream_free (spk_token_stream_t *stream)
+{
+    spk_lexer_destroy (&stream->lexer);
+    free (stream->buffer);
+    free (stream);
+}
+
+const spk_token_list_t *
+spk_token_stream_list (const spk_token_stream_t *stream)
+{
+    return &stream->list;
+}
+
+// Slides the window forward over the file. Bytes before the oldest token
+// in the ring are dropped, the window only grows when a single line or
+// string doesn't fit. The lexer stops at the last newline read so far,
+// only strings can span lines and those are retried when they hit it.
+static void
+spk_token_stream_refill (spk_token_stream_t *stream)
+{
+    auto lexer = &stream->lexer;
+    size_t keep = (size_t)(lexer->current - lexer->source);
+
+    size_t live = stream->produced < SPK_TOKEN_STREAM_RING ?
+                    stream->produced :
+                    SPK_TOKEN_STREAM_RING;
+    for (size_t i = stream->produced - live; i < stream->produced; ++i) {
+        auto token = &stream->ring[i % SPK_TOKEN_STREAM_RING];
+        if (token->offset < keep) {
+            keep = token->offset;
         }
     }
 
-    spk_insert_token (&ctx, SPK_TOKEN_TYPE_EOF);
-    return ctx.tokens;
+    memmove (stream->buffer, stream->buffer + keep, stream->length - keep);
+    stream->length -= keep;
+    for (size_t i = stream->produced - live; i < stream->produced; ++i) {
+        stream->ring[i % SPK_TOKEN_STREAM_RING].offset -= (uint32_t)keep;
+    }
+
+    if (stream->length == stream->capacity) {
+        stream->capacity *= 2;
+        stream->buffer = realloc (stream->buffer, stream->capacity);
+    }
+
+    if (!stream->eof) {
+        stream->length += fread (stream->buffer + stream->length, 1,
+                                 stream->capacity - stream->length, stream->file);
+        stream->eof = feof (stream->file) || ferror (stream->file);
+    }
+
+    size_t position = (size_t)(lexer->current - lexer->source) - keep;
+    size_t lexable = stream->length;
+    if (!stream->eof) {
+        while (lexable > position && stream->buffer[lexable - 1] != '\n') {
+            --lexable;
+        }
+    }
+
+    lexer->source = stream->buffer;
+    lexer->current = stream->buffer + position;
+    lexer->end = stream->buffer + lexable;
+    lexer->partial = lexable < stream->length || !stream->eof;
+
+    stream->list.source = stream->buffer;
+    stream->list.source_len = stream->length;
 }
 
+// Lexes until the next token lands in the ring
+static void
+spk_token_stream_advance (spk_token_stream_t *stream)
+{
+    auto lexer = &stream->lexer;
+
+    while (lexer->tokens.count == 0) {
+        if (spk_lexer_at_end (lexer) && !lexer->partial) {
+            lexer->start = lexer->current;
+            spk_insert_token (lexer, SPK_TOKEN_TYPE_EOF);
+            stream->done = true;
+            break;
+        }
+
+        if (spk_lexer_at_end (lexer) || !spk_lexer_scan (lexer)) {
+            spk_token_stream_refill (stream);
+        }
+    }
+
+    spk_lexer_flush_errors (lexer, 0);
+
+    assert (lexer->tokens.count == 1);
+    stream->ring[stream->produced++ % SPK_TOKEN_STREAM_RING] = lexer->tokens.data[0];
+    spk_token_vec_clear (&lexer->tokens);
+    SPK_STATS_ADD (tokens, 1);
+}
+
+const spk_token_t *
+spk_token_stream_peek (spk_token_stream_t *stream, size_t index)
+{
+    while (index >= stream->produced && !stream->done) {
+        spk_token_stream_advance (stream);
+    }
+
+    if (index >= stream->produced || index + SPK_TOKEN_STREAM_RING < stream->produced) {
+        return nullptr;
+    }
+
+    return &stream->ring[index % SPK_TOKEN_STREAM_RING];
+}
@@ -1,11 +1,54 @@
 #pragma once
 
-#include "../utils/darray.h"
+#include "token.h"
+#include "symbols.h"
 
 #include <stddef.h>
+#include <stdio.h>
 
-typedef struct spk_token_s spk_token_t;
-typedef darray_t *spk_token_list_t;
+typedef struct spk_token_list_s {
+    spk_token_vec_t tokens;
+    const char *source; // Token offsets are relative to this
+    size_t     source_len;
 
-spk_token_list_t spk_tokenize_source (const char *src, size_t len);
+    spk_symbol_table_t *symbols; // Not owned, identifiers are interned here
+} spk_token_list_t;
 
+// The source has to outlive the returned token list. Identifiers are
+// interned into symbols, which the caller keeps alive for as long as
+// anything refers to a symbol (tokens, the AST, compiled programs).
+// Returns nullptr once the lexer errors are printed.
+spk_token_list_t *spk_tokenize_source (const char *src, size_t len,
+                                       spk_symbol_table_t *symbols);
+
+// Sources of at least two SPK_LEXER_MIN_CHUNK bytes are split into chunks
+// and lexed on up to threads threads. The tokens and symbols are the same
+// as when lexing on a single thread. spk_tokenize_source uses one thread
+// per online CPU.
+#define SPK_LEXER_MIN_CHUNK (4 * 1024 * 1024)
+
+spk_token_list_t *spk_tokenize_source_parallel (const char *src, size_t len,
+                                                spk_symbol_table_t *symbols,
+                                                uint32_t threads);
+void              spk_token_list_free (spk_token_list_t *list);
+
+/*
+ Streaming lexer for sources too large to hold in memory with all of their
+ tokens. The file is read through a window that slides forward as tokens
+ are asked for, only the last SPK_TOKEN_STREAM_RING tokens are kept.
+*/
+
+#define SPK_TOKEN_STREAM_RING   64
+#define SPK_TOKEN_STREAM_WINDOW (64 * 1024)
+
+typedef struct spk_token_stream_s spk_token_stream_t;
+
+// The file has to stay open for as long as the stream is used
+spk_token_stream_t *spk_token_stream_open (FILE *file, spk_symbol_table_t *symbols);
+void                spk_token_stream_free (spk_token_stream_t *stream);
+
+// Returns token number index, lexing as much of the file as that takes.
+// Returns nullptr past the EOF token and for tokens that already left the ring.
+const spk_token_t      *spk_token_stream_peek (spk_token_stream_t *stream, size_t index);
+// Token text of the tokens in the ring, the window moves on the next peek
+const spk_token_list_t *spk_token_stream_list (const spk_token_stream_t *stream);
@@ -0,0 +1,225 @@
+#include "object.h"
+#include "../utils/arena.h"
+#include "../utils/stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+static void
+spk_string_init (spk_string_t *string, SPK_string_kind kind, uint32_t refcount, size_t length)
+{
+    assert (length < UINT32_MAX);
+
+    string->refcount = refcount;
+    string->length = (uint32_t)length;
+    string->hash = 0;
+    string->kind = kind;
+}
+
+static spk_string_t *
+spk_string_alloc_inline (size_t length)
+{
+    spk_string_t *string = malloc (sizeof (spk_string_t) + length + 1);
+    SPK_STATS_ADD (bytes_allocated, sizeof (spk_string_t) + length + 1);
+    spk_string_init (string, SPK_STRING_KIND_INLINE, 1, length);
+    string->inline_chars[length] = '\0';
+    return string;
+}
+
+spk_string_t *
+spk_string_new (const char *chars, size_t length)
+{
+    auto string = spk_string_alloc_inline (length);
+    memcpy (string->inline_chars, chars, length);
+    return string;
+}
+
+spk_string_t *
+spk_string_new_literal (spk_arena_t *arena, const char *chars, size_t length)
+{
+    spk_string_t *string = spk_arena_alloc (arena, sizeof (spk_string_t) + length + 1);
+    spk_string_init (string, SPK_STRING_KIND_INLINE, SPK_STRING_IMMORTAL, length);
+    memcpy (string->inline_chars, chars, length);
+    string->inline_chars[length] = '\0';
+    return string;
+}
+
+spk_string_t *
+spk_string_concat (spk_string_t *a, spk_string_t *b)
+{
+    if (a->length == 0) {
+        return spk_string_retain (b);
+    }
+
+    if (b->length == 0) {
+        return spk_string_retain (a);
+    }
+
+    size_t length = (size_t)a->length + b->length;
+
+    // Short results are cheaper to copy than to keep as a rope,
+    // which also means both halves are never ropes themselves
+    if (length <= SPK_STRING_INLINE_MAX) {
+        auto string = spk_string_alloc_inline (length);
+        memcpy (string->inline_chars, spk_string_chars (a), a->length);
+        memcpy (string->inline_chars + a->length, spk_string_chars (b), b->length);
+        return string;
+    }
+
+    spk_string_t *string = malloc (sizeof (spk_string_t));
+    SPK_STATS_ADD (bytes_allocated, sizeof (spk_string_t));
+    spk_string_init (string, SPK_STRING_KIND_ROPE, 1, length);
+    string->rope.left = spk_string_retain (a);
+    string->rope.right = spk_string_retain (b);
+    return string;
+}
+
+typedef struct spk_string_stack_s {
+    spk_string_t **items;
+    size_t       count;
+    size_t       capacity;
+} spk_string_stack_t;
+
+static void
+spk_string_stack_push (spk_string_stack_t *stack, spk_string_t *string)
+{
+    if (stack->count == stack->capacity) {
+        stack->capacity = stack->capacity ? stack->capacity * 2 : 16;
+        stack->items = reallocarray (stack->items, stack->capacity, sizeof (spk_string_t *));
+    }
+
+    stack->items[stack->count++] = string;
+}
+
+// Ropes built by appending are as deep as the number of appends,
+// they are walked with an explicit stack rather than recursion
+static void
+spk_string_flatten (spk_string_t *string)
+{
+    assert (string->kind == SPK_STRING_KIND_ROPE);
+
+    char *chars = malloc (string->length + 1);
+    SPK_STATS_ADD (bytes_allocated, string->length + 1);
+    char *out = chars;
+
+    spk_string_stack_t stack = {};
+    spk_string_stack_push (&stack, string->rope.right);
+    spk_string_stack_push (&stack, string->rope.left);
+
+    while (stack.count > 0) {
+        auto node = stack.items[--stack.count];
+        switch (node->kind) {
+            case SPK_STRING_KIND_ROPE:
+                spk_string_stack_push (&stack, node->rope.right);
+                spk_string_stack_push (&stack, node->rope.left);
+                break;
+            case SPK_STRING_KIND_FLAT:
+                memcpy (out, node->chars, node->length);
+                out += node->length;
+                break;
+            case SPK_STRING_KIND_INLINE:
+                memcpy (out, node->inline_chars, node->length);
+                out += node->length;
+                break;
+        }
+    }
+
+    free (stack.items);
+    *out = '\0';
+
+    auto left = string->rope.left;
+    auto right = string->rope.right;
+    string->kind = SPK_STRING_KIND_FLAT;
+    string->chars = chars;
+
+    spk_string_release (left);
+    spk_string_release (right);
+}
+
+const char *
+spk_string_chars (spk_string_t *string)
+{
+    switch (string->kind) {
+        case SPK_STRING_KIND_INLINE:
+            return string->inline_chars;
+        case SPK_STRING_KIND_ROPE:
+            spk_string_flatten (string);
+            return string->chars;
+        case SPK_STRING_KIND_FLAT:
+        default:
+            return string->chars;
+    }
+}
+
+uint32_t
+spk_string_hash (spk_string_t *string)
+{
+    if (string->hash != 0) {
+        return string->hash;
+    }
+
+    // FNV-1a, 0 is kept free to mark hashes that weren't computed yet
+    const char *chars = spk_string_chars (string);
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < string->length; ++i) {
+        hash = (hash ^ (uint8_t)chars[i]) * 16777619u;
+    }
+
+    string->hash = hash ? hash : 1;
+    return string->hash;
+}
+
+bool
+spk_string_equal (spk_string_t *a, spk_string_t *b)
+{
+    if (a == b) {
+        return true;
+    }
+
+    if (a->length != b->length || spk_string_hash (a) != spk_string_hash (b)) {
+        return false;
+    }
+
+    return memcmp (spk_string_chars (a), spk_string_chars (b), a->length) == 0;
+}
+
+// Children that die along with a rope are queued
+// instead of being freed recursively
+static void
+spk_string_release_into (spk_string_stack_t *pending, spk_string_t *string)
+{
+    if (string->refcount != SPK_STRING_IMMORTAL && --string->refcount == 0) {
+        spk_string_stack_push (pending, string);
+    }
+}
+
+void
+spk_string_free (spk_string_t *string)
+{
+    assert (string->refcount == 0);
+
+    spk_string_stack_t pending = {};
+    for (;;) {
+        switch (string->kind) {
+            case SPK_STRING_KIND_ROPE:
+                spk_string_release_into (&pending, string->rope.left);
+                spk_string_release_into (&pending, string->rope.right);
+                break;
+            case SPK_STRING_KIND_FLAT:
+                free (string->chars);
+                break;
+            case SPK_STRING_KIND_INLINE:
+                break;
+        }
+
+        free (string);
+
+        if (pending.count == 0) {
+            break;
+        }
+        string = pending.items[--pending.count];
+    }
+
+    free (pending.items);
+}
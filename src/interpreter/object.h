@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ Heap objects referenced from spk_value_t. Strings are the only kind of
+ object so far.
+
+ Strings are immutable and reference counted. Short strings keep their
+ bytes inline, right after the header, so they take a single allocation.
+ Concatenations past SPK_STRING_INLINE_MAX bytes build a rope node that
+ only refers to both halves; the bytes are copied once, the first time
+ someone asks for them. Appending to a string n times is O(n) overall.
+
+ Literal strings are allocated in the parser's arena and are immortal,
+ retaining or releasing them does nothing, so the engines can share them
+ straight from their constant pools.
+*/
+
+typedef struct spk_arena_s spk_arena_t;
+
+#define SPK_STRING_INLINE_MAX 32
+#define SPK_STRING_IMMORTAL   UINT32_MAX
+
+typedef enum {
+    SPK_STRING_KIND_INLINE, // Bytes follow the header
+    SPK_STRING_KIND_FLAT,   // Flattened rope, bytes in their own buffer
+    SPK_STRING_KIND_ROPE,   // left + right, not flattened yet
+} SPK_string_kind;
+
+typedef struct spk_string_s spk_string_t;
+
+struct spk_string_s {
+    uint32_t refcount; // SPK_STRING_IMMORTAL for literals
+    uint32_t length;
+    uint32_t hash;     // 0 until spk_string_hash computes it
+    uint8_t  kind;     // SPK_string_kind
+
+    union {
+        struct {
+            spk_string_t *left;
+            spk_string_t *right;
+        } rope;
+        char *chars;
+    };
+
+    char inline_chars[];
+};
+
+// Returns a string with a reference count of one
+spk_string_t *spk_string_new (const char *chars, size_t length);
+// Immortal string owned by the arena
+spk_string_t *spk_string_new_literal (spk_arena_t *arena, const char *chars, size_t length);
+
+// Returns a new reference, a and b keep theirs
+spk_string_t *spk_string_concat (spk_string_t *a, spk_string_t *b);
+
+// Null-terminated, flattens ropes the first time it's called on them
+const char *spk_string_chars (spk_string_t *string);
+uint32_t    spk_string_hash (spk_string_t *string);
+bool        spk_string_equal (spk_string_t *a, spk_string_t *b);
+
+void spk_string_free (spk_string_t *string);
+
+static inline spk_string_t *
+spk_string_retain (spk_string_t *string)
+{
+    if (string->refcount != SPK_STRING_IMMORTAL) {
+        ++string->refcount;
+    }
+
+    return string;
+}
+
+static inline void
+spk_string_release (spk_string_t *string)
+{
+    if (string->refcount != SPK_STRING_IMMORTAL && --string->refcount == 0) {
+        spk_string_free (string);
+    }
+}
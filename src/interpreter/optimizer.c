@@ -0,0 +1,176 @@
+#include "optimizer.h"
+#include "expressions.h"
+#include "statements.h"
+#include "value.h"
+
+#include <assert.h>
+
+static bool
+spk_is_int_literal (const spk_expr_t *expr)
+{
+    return expr->type == SPK_EXPR_TYPE_LITERAL &&
+           expr->literal.value.type == SPK_TOKEN_LITERAL_INTEGER;
+}
+
+// Turns the node into an integer literal, its children stay in the arena
+static void
+spk_fold_into (spk_expr_t *expr, int32_t value)
+{
+    expr->type = SPK_EXPR_TYPE_LITERAL;
+    expr->literal = (spk_literal_expr_t) {
+        .value = {
+            .type = SPK_TOKEN_LITERAL_INTEGER,
+            .integer = { value }
+        }
+    };
+}
+
+static void
+spk_fold_unary (spk_expr_t *expr)
+{
+    if (!spk_is_int_literal (expr->unary.right)) {
+        return;
+    }
+
+    int32_t right = expr->unary.right->literal.value.integer.value;
+    switch (expr->unary.operator) {
+        case SPK_TOKEN_TYPE_MINUS:
+            // Folded with the helpers the engines run, -O0 and -O1 agree on overflow
+            spk_fold_into (expr, spk_int_neg (right));
+            break;
+        case SPK_TOKEN_TYPE_NOT:
+            spk_fold_into (expr, !right);
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+spk_fold_binary (spk_expr_t *expr)
+{
+    if (!spk_is_int_literal (expr->binary.left) ||
+        !spk_is_int_literal (expr->binary.right)) {
+        return;
+    }
+
+    int32_t left = expr->binary.left->literal.value.integer.value;
+    int32_t right = expr->binary.right->literal.value.integer.value;
+
+    switch (expr->binary.operator) {
+        case SPK_TOKEN_TYPE_PLUS:
+            spk_fold_into (expr, spk_int_add (left, right));
+            break;
+        case SPK_TOKEN_TYPE_MINUS:
+            spk_fold_into (expr, spk_int_sub (left, right));
+            break;
+        case SPK_TOKEN_TYPE_MULTIPLY:
+            spk_fold_into (expr, spk_int_mul (left, right));
+            break;
+        case SPK_TOKEN_TYPE_DIVIDE:
+            // Kept, so the engine reports the division by zero when the statement runs
+            if (right == 0) {
+                return;
+            }
+            spk_fold_into (expr, spk_int_div (left, right));
+            break;
+        case SPK_TOKEN_TYPE_GREATER:       spk_fold_into (expr, left > right); break;
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: spk_fold_into (expr, left >= right); break;
+        case SPK_TOKEN_TYPE_LESS:          spk_fold_into (expr, left < right); break;
+        case SPK_TOKEN_TYPE_LESS_EQUAL:    spk_fold_into (expr, left <= right); break;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:   spk_fold_into (expr, left == right); break;
+        case SPK_TOKEN_TYPE_NOT_EQUAL:     spk_fold_into (expr, left != right); break;
+        default:
+            break;
+    }
+}
+
+// Returns the node that replaces expr, which may be expr itself
+static spk_expr_t *
+spk_optimize_expression (spk_expr_t *expr)
+{
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+        case SPK_EXPR_TYPE_VAR:
+            return expr;
+        case SPK_EXPR_TYPE_GROUPING:
+            return spk_optimize_expression (expr->grouping.expr);
+        case SPK_EXPR_TYPE_UNARY:
+            expr->unary.right = spk_optimize_expression (expr->unary.right);
+            spk_fold_unary (expr);
+            return expr;
+        case SPK_EXPR_TYPE_BINARY:
+            expr->binary.left = spk_optimize_expression (expr->binary.left);
+            expr->binary.right = spk_optimize_expression (expr->binary.right);
+            spk_fold_binary (expr);
+            return expr;
+        default:
+            assert (false);
+            return expr;
+    }
+}
+
+// Type errors can't happen past the type checker, division by zero is
+// the only way an operator tree can still fail at runtime
+static bool
+spk_is_pure (const spk_expr_t *expr)
+{
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+        case SPK_EXPR_TYPE_VAR:
+            return true;
+        case SPK_EXPR_TYPE_UNARY:
+            return spk_is_pure (expr->unary.right);
+        case SPK_EXPR_TYPE_BINARY:
+            return expr->binary.operator != SPK_TOKEN_TYPE_DIVIDE &&
+                   spk_is_pure (expr->binary.left) &&
+                   spk_is_pure (expr->binary.right);
+        default:
+            return false;
+    }
+}
+
+bool
+spk_optimize_statement (spk_statement_t *stmt, uint32_t level)
+{
+    // Refused by the resolver and the type checker already, never run one
+    if ((stmt->type == SPK_STATEMENT_TYPE_PRINT && !stmt->print.expr) ||
+        (stmt->type == SPK_STATEMENT_TYPE_EXPR && !stmt->expr.expr)) {
+        return false;
+    }
+
+    if (level == 0) {
+        return true;
+    }
+
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            stmt->print.expr = spk_optimize_expression (stmt->print.expr);
+            return true;
+        case SPK_STATEMENT_TYPE_EXPR:
+            stmt->expr.expr = spk_optimize_expression (stmt->expr.expr);
+            return !spk_is_pure (stmt->expr.expr);
+        case SPK_STATEMENT_TYPE_VAR:
+            if (stmt->var.initializer) {
+                stmt->var.initializer = spk_optimize_expression (stmt->var.initializer);
+            }
+            return true;
+        default:
+            assert (false);
+            return true;
+    }
+}
+
+void
+spk_optimize_statements (darray_t *statements, uint32_t level)
+{
+    spk_statement_t *stmts = statements->data;
+    size_t kept = 0;
+    for (size_t i = 0; i < statements->count; ++i) {
+        if (spk_optimize_statement (&stmts[i], level)) {
+            stmts[kept++] = stmts[i];
+        }
+    }
+
+    statements->count = kept;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "../utils/darray.h"
+
+#include <stdint.h>
+
+/*
+ AST optimizer, run on resolved statements before they reach an engine.
+
+ -O0  no changes
+ -O1  folds constant integer subtrees into literals, strips grouping
+      nodes and drops expression statements that can neither fail nor
+      have an effect
+*/
+
+#define SPK_OPT_LEVEL_MAX 1
+
+// Rewrites the AST in place and removes dropped statements from statements
+void spk_optimize_statements (darray_t *statements, uint32_t level);
+
+typedef struct spk_statement_s spk_statement_t;
+// Rewrites a single statement, returns false if it can be dropped
+bool spk_optimize_statement (spk_statement_t *stmt, uint32_t level);
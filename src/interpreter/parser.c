@@ -1,89 +1,131 @@
 #include "parser.h"
 #include "expressions.h"
 #include "statements.h"
-#include "printer.h"
 #include "lexer.h"
-#include "ast_interpreter.h"
+#include "object.h"
+#include "../utils/stats.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 
+// A statement rarely holds more string literals than fit inline
+SPK_VEC_DECLARE_SMALL (spk_literal_vec, spk_string_t *, 8)
+
 typedef struct spk_parser_ctx_s {
-    darray_t               *statements;
-    const spk_token_list_t tokens;
+    const spk_token_list_t *list;
+    const spk_token_vec_t  *tokens; // &list->tokens, nullptr when streaming
+    spk_token_stream_t     *stream;
     size_t current;
+
+    spk_arena_t            *arena;
+    // Streaming only, string literals owned by the last statement
+    spk_literal_vec_t      literals;
+
+    bool had_error; // In any statement so far
+    bool panic;     // In the current statement, until it is synchronized
 } spk_parser_ctx_t;
 
+struct spk_parser_s {
+    spk_parser_ctx_t ctx;
+};
+
+static const spk_token_t *
+spk_parser_token (spk_parser_ctx_t *ctx, size_t index)
+{
+    if (ctx->stream) {
+        return spk_token_stream_peek (ctx->stream, index);
+    }
+
+    return index < ctx->tokens->count ? &ctx->tokens->data[index] : nullptr;
+}
+
 static bool
 spk_parser_at_end (spk_parser_ctx_t *ctx)
 {
-    return ctx->current >= ctx->tokens->count;
+    return !spk_parser_token (ctx, ctx->current);
 }
 
-static spk_token_t *
-spk_consume (spk_parser_ctx_t *ctx, SPK_token_type type, const char *err)
+// Only the first error of a statement is printed, the rest of it is
+// skipped by spk_synchronize. Returns whether the error was printed.
+static bool
+spk_parser_error (spk_parser_ctx_t *ctx, const spk_token_t *token, const char *msg)
 {
-    if (spk_parser_at_end (ctx)) {
-        printf ("Reached end of file...\n");
-        return nullptr;
+    if (ctx->panic) {
+        return false;
     }
 
-    spk_token_t *token = darray_elem(ctx->tokens, ctx->current++);
-    if (!token || token->type != type) {
-        printf ("Parser error: %s\n", err);
-        printf ("\tExpected token type %s, was %s\n",
-                spk_token_type_str (type), spk_token_type_str (token->type));
-
-        if (ctx->current > 0) {
-            spk_token_t *prev = darray_elem(ctx->tokens, ctx->current - 2);
-            printf ("\tPrevious: %s\n", spk_token_type_str (prev->type));
-        }
+    ctx->had_error = true;
+    ctx->panic = true;
+    printf ("Parser error, line %u: %s\n", token ? token->line : 0, msg);
+    return true;
+}
 
-        if (ctx->current < ctx->tokens->count - 1) {
-            spk_token_t *next = darray_elem(ctx->tokens, ctx->current - 2);
-            printf ("\tNext: %s\n", spk_token_type_str (next->type));
+// Returns nullptr and leaves the token in place if it doesn't match
+static const spk_token_t *
+spk_consume (spk_parser_ctx_t *ctx, SPK_token_type type, const char *err)
+{
+    const spk_token_t *token = spk_parser_token (ctx, ctx->current);
+    if (!token || token->type != type) {
+        if (spk_parser_error (ctx, token, err)) {
+            printf ("\tExpected token type %s, was %s\n", spk_token_type_str (type),
+                    token ? spk_token_type_str (token->type) : "nothing");
         }
+        return nullptr;
     }
+
+    ctx->current++;
     return token;
 }
 
 static bool
 spk_match_any (spk_parser_ctx_t *ctx, ...)
 {
-    if (spk_parser_at_end (ctx)) {
+    const spk_token_t *token = spk_parser_token (ctx, ctx->current);
+    if (!token) {
         return false;
     }
 
     va_list types;
     va_start (types);
     size_t count = va_arg (types, size_t);
-    for (size_t i = 0; i < count; ++i) {
-        auto type = va_arg (types, SPK_token_type);
-        spk_token_t *token = darray_elem (ctx->tokens, ctx->current);
-        if (token->type == type) {
-            ctx->current++;
-            return true;
-        }
+    bool match = false;
+    for (size_t i = 0; i < count && !match; ++i) {
+        match = token->type == va_arg (types, SPK_token_type);
     }
+    va_end (types);
 
-    return false;
+    ctx->current += match;
+    return match;
 }
 
-static spk_token_t *
+static const spk_token_t *
 spk_prev (spk_parser_ctx_t *ctx)
 {
-    return darray_elem (ctx->tokens, ctx->current - 1);
+    return spk_parser_token (ctx, ctx->current - 1);
 }
 
 static spk_expr_t *
-spk_alloc_expr (SPK_expr_type type)
+spk_alloc_expr (spk_parser_ctx_t *ctx, SPK_expr_type type)
 {
-    spk_expr_t *expr = calloc (1, sizeof (spk_expr_t));
+    spk_expr_t *expr = spk_arena_new (ctx->arena, spk_expr_t);
     expr->type = type;
+    SPK_STATS_ADD (expr_nodes, 1);
     return expr;
 }
 
+// The lexer interns every identifier, a token of any other type only shows
+// up here after a parse error and gets interned so the AST stays well-formed
+static spk_symbol_t
+spk_token_symbol (spk_parser_ctx_t *ctx, const spk_token_t *token)
+{
+    if (token->symbol != SPK_SYMBOL_NONE) {
+        return token->symbol;
+    }
+
+    return spk_symbol_intern (ctx->list->symbols, spk_token_text (ctx->list, token), token->length);
+}
+
 static spk_expr_t *
 spk_expression (spk_parser_ctx_t *ctx);
 
@@ -92,34 +134,42 @@ spk_primary (spk_parser_ctx_t *ctx)
 {
     if (spk_match_any (ctx, 2, SPK_TOKEN_TYPE_INTEGER, SPK_TOKEN_TYPE_STRING)) {
         auto value = spk_prev (ctx);
-        auto expr = spk_alloc_expr (SPK_EXPR_TYPE_LITERAL);
+        auto expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_LITERAL);
         expr->literal = (spk_literal_expr_t) {
-            .value = value->literal
+            .value = spk_token_decode_literal (ctx->list, value,
+                                               ctx->stream ? nullptr : ctx->arena)
         };
+
+        if (ctx->stream && expr->literal.value.type == SPK_TOKEN_LITERAL_STRING) {
+            spk_literal_vec_push (&ctx->literals, expr->literal.value.string.value);
+        }
         return expr;
     }
  
     if (spk_match_any(ctx, 1, SPK_TOKEN_TYPE_LEFT_PAREN)) {
         auto expr = spk_expression (ctx);
-
-        if (!spk_match_any(ctx, 1, SPK_TOKEN_TYPE_RIGHT_PAREN)) {
-            printf ("Expected ')' after expression\n");
+        if (!expr || !spk_consume (ctx, SPK_TOKEN_TYPE_RIGHT_PAREN,
+                                   "Expected ')' after expression")) {
+            return nullptr;
         }
-     
-        auto grouping = spk_alloc_expr (SPK_EXPR_TYPE_GROUPING);
+
+        auto grouping = spk_alloc_expr (ctx, SPK_EXPR_TYPE_GROUPING);
         grouping->grouping = (spk_grouping_expr_t) { expr };
         return grouping;
     }
 
     if (spk_match_any (ctx, 1, SPK_TOKEN_TYPE_IDENTIFIER)) {
-        auto name = spk_prev (ctx);
-        auto expr = spk_alloc_expr (SPK_EXPR_TYPE_VAR);
+        auto symbol = spk_token_symbol (ctx, spk_prev (ctx));
+        auto expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_VAR);
         expr->var = (spk_var_expr_t) {
-            .name = *name
+            .symbol = symbol,
+            .name = spk_symbol_name (ctx->list->symbols, symbol),
+            .slot = SPK_SLOT_UNRESOLVED
         };
         return expr;
     }
 
+    spk_parser_error (ctx, spk_parser_token (ctx, ctx->current), "Expected expression");
     return nullptr;
 }
 
@@ -129,11 +179,16 @@ spk_unary (spk_parser_ctx_t *ctx)
     if (spk_match_any (ctx, 2, SPK_TOKEN_TYPE_NOT, SPK_TOKEN_TYPE_MINUS)) {
         auto operator = spk_prev (ctx);
         auto right = spk_unary (ctx);
-        auto expr = spk_alloc_expr (SPK_EXPR_TYPE_UNARY);
+        if (!right) {
+            return nullptr;
+        }
+
+        auto expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_UNARY);
         expr->unary = (spk_unary_expr_t) {
-            .operator = *operator,
+            .operator = operator->type,
             .right = right
         };
+        return expr;
     }
 
     return spk_primary (ctx);
@@ -144,15 +199,19 @@ spk_factor (spk_parser_ctx_t *ctx)
 {
     auto expr = spk_unary (ctx);
 
-    while (spk_match_any (ctx, 2, SPK_TOKEN_TYPE_DIVIDE,
-                                  SPK_TOKEN_TYPE_MULTIPLY)) {
+    while (expr && spk_match_any (ctx, 2, SPK_TOKEN_TYPE_DIVIDE,
+                                          SPK_TOKEN_TYPE_MULTIPLY)) {
         auto operator = spk_prev (ctx);
         auto left = expr;
         auto right = spk_unary (ctx);
-        expr = spk_alloc_expr (SPK_EXPR_TYPE_BINARY);
+        if (!right) {
+            return nullptr;
+        }
+
+        expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_BINARY);
         expr->binary = (spk_binary_expr_t) {
             .left = left,
-            .operator = *operator,
+            .operator = operator->type,
             .right = right
         };
     }
@@ -165,15 +224,19 @@ spk_term (spk_parser_ctx_t *ctx)
 {
     auto expr = spk_factor (ctx);
 
-    while (spk_match_any (ctx, 2, SPK_TOKEN_TYPE_MINUS,
-                                  SPK_TOKEN_TYPE_PLUS)) {
+    while (expr && spk_match_any (ctx, 2, SPK_TOKEN_TYPE_MINUS,
+                                          SPK_TOKEN_TYPE_PLUS)) {
         auto operator = spk_prev (ctx);
         auto left = expr;
         auto right = spk_factor (ctx);
-        expr = spk_alloc_expr (SPK_EXPR_TYPE_BINARY);
+        if (!right) {
+            return nullptr;
+        }
+
+        expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_BINARY);
         expr->binary = (spk_binary_expr_t) {
             .left = left,
-            .operator = *operator,
+            .operator = operator->type,
             .right = right
         };
     }
@@ -186,17 +249,21 @@ spk_comparison (spk_parser_ctx_t *ctx)
 {
     auto expr = spk_term (ctx);
 
-    while (spk_match_any (ctx, 4, SPK_TOKEN_TYPE_GREATER,
-                                  SPK_TOKEN_TYPE_GREATER_EQUAL,
-                                  SPK_TOKEN_TYPE_LESS,
-                                  SPK_TOKEN_TYPE_LESS_EQUAL)) {
+    while (expr && spk_match_any (ctx, 4, SPK_TOKEN_TYPE_GREATER,
+                                          SPK_TOKEN_TYPE_GREATER_EQUAL,
+                                          SPK_TOKEN_TYPE_LESS,
+                                          SPK_TOKEN_TYPE_LESS_EQUAL)) {
         auto operator = spk_prev (ctx);
         auto left = expr;
         auto right = spk_term (ctx);
-        expr = spk_alloc_expr (SPK_EXPR_TYPE_BINARY);
+        if (!right) {
+            return nullptr;
+        }
+
+        expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_BINARY);
         expr->binary = (spk_binary_expr_t) {
             .left = left,
-            .operator = *operator,
+            .operator = operator->type,
             .right = right
         };
     }
@@ -209,15 +276,19 @@ spk_equality (spk_parser_ctx_t *ctx)
 {
     auto expr = spk_comparison (ctx);
 
-    while (spk_match_any (ctx, 2, SPK_TOKEN_TYPE_NOT_EQUAL,
-                                  SPK_TOKEN_TYPE_EQUAL_EQUAL)) {
+    while (expr && spk_match_any (ctx, 2, SPK_TOKEN_TYPE_NOT_EQUAL,
+                                          SPK_TOKEN_TYPE_EQUAL_EQUAL)) {
         auto operator = spk_prev (ctx);
         auto left = expr;
         auto right = spk_comparison (ctx);
-        expr = spk_alloc_expr (SPK_EXPR_TYPE_BINARY);
+        if (!right) {
+            return nullptr;
+        }
+
+        expr = spk_alloc_expr (ctx, SPK_EXPR_TYPE_BINARY);
         expr->binary = (spk_binary_expr_t) {
             .left = left,
-            .operator = *operator,
+            .operator = operator->type,
             .right = right
         };
     }
@@ -235,12 +306,6 @@ static spk_statement_t
 spk_expression_statement (spk_parser_ctx_t *ctx)
 {
     auto expr = spk_expression (ctx);
-
-    if (!expr) {
-        ctx->current++;
-        return (spk_statement_t) { SPK_STATEMENT_TYPE_EMPTY };
-    }
-
     spk_consume(ctx, SPK_TOKEN_TYPE_SEMICOLON, "Expected ; after expression.");
     return (spk_statement_t) {
         .type = SPK_STATEMENT_TYPE_EXPR,
@@ -267,6 +332,11 @@ static spk_statement_t
 spk_variable_statement (spk_parser_ctx_t *ctx)
 {
     auto ident = spk_consume (ctx, SPK_TOKEN_TYPE_IDENTIFIER, "Expected identifier name after 'var'");
+    if (!ident) {
+        return (spk_statement_t) { SPK_STATEMENT_TYPE_EMPTY };
+    }
+
+    auto symbol = spk_token_symbol (ctx, ident);
 
     spk_expr_t *expr = nullptr;
     if (spk_match_any (ctx, 1, SPK_TOKEN_TYPE_EQUAL)) {
@@ -278,7 +348,9 @@ spk_variable_statement (spk_parser_ctx_t *ctx)
     return (spk_statement_t) {
         .type = SPK_STATEMENT_TYPE_VAR,
         .var = {
-            .name = *ident,
+            .symbol = symbol,
+            .name = spk_symbol_name (ctx->list->symbols, symbol),
+            .slot = SPK_SLOT_UNRESOLVED,
             .initializer = expr,
             .mutable = true
         }
@@ -292,98 +364,137 @@ spk_statement (spk_parser_ctx_t *ctx)
         return spk_print_statement (ctx);
     }
 
+    // A lone ';' is an empty statement
+    if (spk_match_any (ctx, 1, SPK_TOKEN_TYPE_SEMICOLON)) {
+        return (spk_statement_t) { SPK_STATEMENT_TYPE_EMPTY };
+    }
+
     return spk_expression_statement (ctx);
 }
 
+// Skips the rest of a broken statement, up to and including its ';' or
+// up to the start of the next statement
+static void
+spk_synchronize (spk_parser_ctx_t *ctx)
+{
+    ctx->panic = false;
+
+    const spk_token_t *token;
+    while ((token = spk_parser_token (ctx, ctx->current))) {
+        switch (token->type) {
+            case SPK_TOKEN_TYPE_SEMICOLON:
+                ctx->current++;
+                return;
+            case SPK_TOKEN_TYPE_VAR:
+            case SPK_TOKEN_TYPE_PRINT:
+            case SPK_TOKEN_TYPE_EOF:
+                return;
+            default:
+                ctx->current++;
+        }
+    }
+}
+
+// Only called before the end of the tokens
 static spk_statement_t
 spk_declaration (spk_parser_ctx_t *ctx)
 {
+    auto line = spk_parser_token (ctx, ctx->current)->line;
+    if (spk_match_any (ctx, 1, SPK_TOKEN_TYPE_EOF)) {
+        return (spk_statement_t) { SPK_STATEMENT_TYPE_EMPTY };
+    }
+
+    spk_statement_t statement;
     if (spk_match_any(ctx, 1, SPK_TOKEN_TYPE_VAR)) {
-        return spk_variable_statement (ctx);
+        statement = spk_variable_statement (ctx);
+    } else {
+        statement = spk_statement (ctx);
+    }
+
+    if (ctx->panic) {
+        spk_synchronize (ctx);
+        return (spk_statement_t) { SPK_STATEMENT_TYPE_EMPTY };
     }
 
-    return spk_statement (ctx);
+    statement.line = line;
+    return statement;
 }
 
-void
-spk_parser_recursive_descent (const spk_token_list_t tokens)
+darray_t *
+spk_parser_recursive_descent (const spk_token_list_t *tokens, spk_arena_t *ast_arena)
 {
     spk_parser_ctx_t ctx = {
-        .statements = darray_empty (sizeof (spk_statement_t)),
-        .tokens = tokens
+        .list = tokens,
+        .tokens = &tokens->tokens,
+        .arena = ast_arena
     };
 
+    auto statements = darray_empty (sizeof (spk_statement_t));
     while (!spk_parser_at_end (&ctx)) {
         auto statement = spk_declaration (&ctx);
         if (statement.type != SPK_STATEMENT_TYPE_EMPTY) {
-            darray_append (ctx.statements, &statement);
+            darray_append (statements, &statement);
         }
     }
 
-    for (size_t i = 0; i < ctx.statements->count; ++i) {
-        spk_statement_t *stmt = darray_elem (ctx.statements, i);
-        spk_interpret_statement (stmt);
-
-#if 0
-        spk_expr_t *expr = nullptr;
-
-        switch (stmt->type) {
-            case SPK_STATEMENT_TYPE_PRINT:
-                printf ("PrintStatement:\n");
-                expr = stmt->print.expr;
-                break;
-            case SPK_STATEMENT_TYPE_EXPR:
-                printf ("ExpressionStatement:\n");
-                expr = stmt->expr.expr;
-                break;
-            default:
-                printf ("Unknown statement:\n");
-                break;
-        }
+    if (ctx.had_error) {
+        darray_free (statements);
+        return nullptr;
+    }
 
-        if (expr) {
-            spk_print_expression (expr);
-
-            auto result = spk_evaluate_expression (expr);
-
-            switch (result.type) {
-                case SPK_TOKEN_LITERAL_INTEGER:
-                    printf ("Evaluated to %d\n", result.integer.value);
-                    break;
-                case SPK_TOKEN_LITERAL_STRING:
-                    printf ("Evaluated to %s\n", result.string.value);
-                    break;
-                default:
-                    printf ("Couldn't evaluate. Invalid expression?\n");
-                    break;
-            }
-        }
-#endif
+    return statements;
+}
+
+spk_parser_t *
+spk_parser_create (spk_token_stream_t *stream, spk_arena_t *ast_arena)
+{
+    spk_parser_t *parser = calloc (1, sizeof (spk_parser_t));
+    parser->ctx = (spk_parser_ctx_t) {
+        .list = spk_token_stream_list (stream),
+        .stream = stream,
+        .arena = ast_arena
+    };
+    spk_literal_vec_init (&parser->ctx.literals);
+
+    return parser;
+}
+
+static void
+spk_parser_release_literals (spk_parser_t *parser)
+{
+    auto literals = &parser->ctx.literals;
+    for (size_t i = 0; i < literals->count; ++i) {
+        spk_string_release (literals->data[i]);
     }
 
-    /*spk_expr_t *expr = nullptr;
-    do {
-        expr = spk_expression (&ctx);
-
-        if (expr) {
-            spk_print_expression (expr);
-
-            auto result = spk_evaluate_expression (expr);
-
-            switch (result.type) {
-                case SPK_TOKEN_LITERAL_INTEGER:
-                    printf ("Evaluated to %d\n", result.integer.value);
-                    break;
-                case SPK_TOKEN_LITERAL_STRING:
-                    printf ("Evaluated to %s\n", result.string.value);
-                    break;
-                default:
-                    printf ("Couldn't evaluate. Invalid expression?\n");
-                    break;
-            }
+    spk_literal_vec_clear (literals);
+}
+
+void
+spk_parser_free (spk_parser_t *parser)
+{
+    spk_parser_release_literals (parser);
+    spk_literal_vec_free (&parser->ctx.literals);
+    free (parser);
+}
+
+bool
+spk_parser_next_statement (spk_parser_t *parser, spk_statement_t *statement)
+{
+    spk_parser_release_literals (parser);
+
+    while (!spk_parser_at_end (&parser->ctx) && !parser->ctx.had_error) {
+        *statement = spk_declaration (&parser->ctx);
+        if (statement->type != SPK_STATEMENT_TYPE_EMPTY) {
+            return true;
         }
+    }
 
-        ctx.current++;
-    } while (ctx.current < ctx.tokens->count);*/
+    return false;
 }
 
+bool
+spk_parser_had_error (const spk_parser_t *parser)
+{
+    return parser->ctx.had_error;
+}
@@ -1,7 +1,29 @@
 #pragma once
 
 #include "../utils/darray.h"
+#include "../utils/arena.h"
 
-typedef darray_t *spk_token_list_t;
-void spk_parser_recursive_descent (const spk_token_list_t tokens);
+typedef struct spk_token_list_s spk_token_list_t;
+typedef struct spk_token_stream_s spk_token_stream_t;
+typedef struct spk_statement_s spk_statement_t;
 
+// Returns the parsed program as a list of statements ([spk_statement_t, ...])
+// AST nodes and literal values are allocated from ast_arena, names refer to
+// the token list's symbol table. The token list and source can be freed
+// once parsing is done. Variables still have to be bound by the resolver.
+// Returns nullptr once the parser errors are printed.
+darray_t *spk_parser_recursive_descent (const spk_token_list_t *tokens, spk_arena_t *ast_arena);
+
+
+// Parses one top-level statement at a time out of a token stream
+typedef struct spk_parser_s spk_parser_t;
+
+spk_parser_t *spk_parser_create (spk_token_stream_t *stream, spk_arena_t *ast_arena);
+void          spk_parser_free (spk_parser_t *parser);
+
+// Returns false once the stream is exhausted. String literals aren't
+// allocated in ast_arena but owned by the statement, they are released
+// by the next call, the caller resets ast_arena between statements.
+// Also returns false on the first statement that fails to parse.
+bool spk_parser_next_statement (spk_parser_t *parser, spk_statement_t *statement);
+bool spk_parser_had_error (const spk_parser_t *parser);
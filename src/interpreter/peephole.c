@@ -0,0 +1,95 @@
+#include "peephole.h"
+#include "bytecode.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+static_assert (SPK_OP_NOT_EQUAL_CONSTANT - SPK_OP_ADD_CONSTANT == SPK_OP_NOT_EQUAL - SPK_OP_ADD);
+static_assert (SPK_OP_NOT_EQUAL_GLOBAL - SPK_OP_ADD_GLOBAL == SPK_OP_NOT_EQUAL - SPK_OP_ADD);
+
+static SPK_opcode
+spk_fused_binary_op (SPK_opcode op, SPK_opcode operand_op)
+{
+    // Relies on the *_CONSTANT and *_GLOBAL superinstructions being
+    // declared in the same order as the binary opcodes they fuse
+    SPK_opcode base = operand_op == SPK_OP_GET_GLOBAL ?
+                        SPK_OP_ADD_GLOBAL :
+                        SPK_OP_ADD_CONSTANT;
+
+    switch (op) {
+        case SPK_OP_ADD:
+        case SPK_OP_SUBTRACT:
+        case SPK_OP_MULTIPLY:
+        case SPK_OP_DIVIDE:
+        case SPK_OP_GREATER:
+        case SPK_OP_GREATER_EQUAL:
+        case SPK_OP_LESS:
+        case SPK_OP_LESS_EQUAL:
+        case SPK_OP_EQUAL:
+        case SPK_OP_NOT_EQUAL:
+            return base + (op - SPK_OP_ADD);
+        default:
+            return SPK_OP_COUNT;
+    }
+}
+
+static bool
+spk_can_fuse_constant (const spk_chunk_t *chunk, uint16_t idx, SPK_opcode op)
+{
+    const spk_value_t *constant = darray_elem (chunk->constants, idx);
+    if (!spk_value_is_int (*constant)) {
+        return false;
+    }
+
+    // Keep the runtime division by zero check on the unfused path
+    return op != SPK_OP_DIVIDE || spk_value_as_int (*constant) != 0;
+}
+
+void
+spk_peephole_optimize (spk_chunk_t *chunk)
+{
+    const uint8_t *code = chunk->code->data;
+    size_t count = chunk->code->count;
+
+    // Chunks are straight-line code, so there are no jump targets to patch
+    darray_t *out = darray_empty (sizeof (uint8_t));
+
+    size_t offset = 0;
+    while (offset < count) {
+        SPK_opcode op = code[offset];
+        size_t len = 1 + spk_opcode_operand_bytes (op);
+        size_t next = offset + len;
+        SPK_opcode next_op = next < count ? code[next] : SPK_OP_COUNT;
+
+        // Pushing a value only to pop it again has no effect
+        if ((op == SPK_OP_CONSTANT || op == SPK_OP_GET_GLOBAL) &&
+             next_op == SPK_OP_POP) {
+            offset = next + 1;
+            continue;
+        }
+
+        // CONSTANT/GET_GLOBAL followed by a binary op
+        if (op == SPK_OP_CONSTANT || op == SPK_OP_GET_GLOBAL) {
+            auto operand = spk_read_u16 (code + offset + 1);
+            auto fused = spk_fused_binary_op (next_op, op);
+
+            if (fused != SPK_OP_COUNT &&
+                (op == SPK_OP_GET_GLOBAL ||
+                 spk_can_fuse_constant (chunk, operand, next_op))) {
+                darray_append_v (out, (uint8_t)fused);
+                darray_append_v (out, (uint8_t)(operand & 0xff));
+                darray_append_v (out, (uint8_t)(operand >> 8));
+                offset = next + 1;
+                continue;
+            }
+        }
+
+        for (size_t i = 0; i < len; ++i) {
+            darray_append (out, &code[offset + i]);
+        }
+        offset = next;
+    }
+
+    darray_free (chunk->code);
+    chunk->code = out;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+typedef struct spk_chunk_s spk_chunk_t;
+
+// Rewrites common instruction sequences in the chunk
+// into superinstructions (see bytecode.h)
+void spk_peephole_optimize (spk_chunk_t *chunk);
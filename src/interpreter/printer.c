@@ -1,109 +1,90 @@
 #include "printer.h"
 #include "expressions.h"
+#include "statements.h"
+#include "../utils/strbuf.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
-#include <string.h>
 #include <assert.h>
 
-static char *
-spk_process_expression (const spk_expr_t *expr);
+static void
+spk_write_expression (spk_strbuf_t *out, const spk_expr_t *expr);
 
-static char *
-spk_parenthesize_value (const char *name, ...)
+// Expressions go in order, after a space each
+static void
+spk_write_parenthesized (spk_strbuf_t *out, const char *name, int32_t num_exprs, ...)
 {
-    size_t name_len = strlen (name);
-    size_t off = 0;
-    size_t len = name_len + 2;
-
-    // TODO: Dynamic strings + better allocation strategy
-    char *buf = calloc (len, sizeof (char));
-
-    buf[off++] = '(';
-    memcpy (buf + off, name, name_len);
-    off += name_len;
+    spk_strbuf_append (out, "(");
+    spk_strbuf_append (out, name);
 
     va_list exprs;
     va_start (exprs);
-    int32_t num_exprs = va_arg (exprs, int32_t);
     for (int32_t i = 0; i < num_exprs; ++i) {
-        auto expr = va_arg (exprs, spk_expr_t*);
-        auto str = spk_process_expression (expr);
-        size_t str_len = strlen (str);
-
-        // Ensure buf is large enough to hold str + space
-        if (off + str_len >= len) {
-            auto min_len = len + str_len + 1;
-            // Grow more than needed to reduce number of allocations
-            char *tmp = calloc (min_len * 2, sizeof (char));
-            memcpy (tmp, buf, len * sizeof (char));
-            free (buf);
-            buf = tmp;
-            len = min_len * 2;
-        }
-
-        buf[off++] = ' ';
-        memcpy (buf + off, str, str_len * sizeof (char));
-        off += str_len;
+        spk_strbuf_append (out, " ");
+        spk_write_expression (out, va_arg (exprs, spk_expr_t *));
     }
     va_end (exprs);
 
-    size_t actual_len = strlen (buf);
-    // +2 to make sure we can fit ')' and null-terminator
-    char *res = calloc (actual_len + 2, sizeof (char));
-    memcpy (res, buf, actual_len * sizeof (char));
-    free (buf);
-    res[actual_len] = ')';
-    return res;
-}
-
-static char *
-spk_process_literal (const spk_literal_expr_t *expr)
-{
-    return spk_token_literal_to_string(&expr->value);
+    spk_strbuf_append (out, ")");
 }
 
-static char *
-spk_process_grouping (const spk_grouping_expr_t *expr)
+static void
+spk_write_literal (spk_strbuf_t *out, const spk_literal_expr_t *expr)
 {
-    return spk_parenthesize_value ("group", 1, expr->expr);
-}
+    if (expr->value.type == SPK_TOKEN_LITERAL_EMPTY) {
+        spk_strbuf_append (out, "nil");
+        return;
+    }
 
-static char *
-spk_process_unary (const spk_unary_expr_t *expr)
-{
-    return spk_parenthesize_value(expr->operator.value, 1, expr->right);
+    char *str = spk_token_literal_to_string (&expr->value);
+    spk_strbuf_append (out, str);
+    free (str);
 }
 
-static char *
-spk_process_binary (const spk_binary_expr_t *expr)
+static const char *
+spk_operator_str (SPK_token_type type)
 {
-    return spk_parenthesize_value(expr->operator.value, 2, expr->left, expr->right);
+    switch (type) {
+        case SPK_TOKEN_TYPE_PLUS: return "+";
+        case SPK_TOKEN_TYPE_MINUS: return "-";
+        case SPK_TOKEN_TYPE_MULTIPLY: return "*";
+        case SPK_TOKEN_TYPE_DIVIDE: return "/";
+        case SPK_TOKEN_TYPE_NOT: return "!";
+        case SPK_TOKEN_TYPE_GREATER: return ">";
+        case SPK_TOKEN_TYPE_GREATER_EQUAL: return ">=";
+        case SPK_TOKEN_TYPE_LESS: return "<";
+        case SPK_TOKEN_TYPE_LESS_EQUAL: return "<=";
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL: return "==";
+        case SPK_TOKEN_TYPE_NOT_EQUAL: return "!=";
+        default: return spk_token_type_str (type);
+    }
 }
 
-static char *
-spk_process_expression (const spk_expr_t *expr)
+static void
+spk_write_expression (spk_strbuf_t *out, const spk_expr_t *expr)
 {
-    char *res = nullptr;
     switch (expr->type) {
         case SPK_EXPR_TYPE_LITERAL:
-            res = spk_process_literal (&expr->literal);
+            spk_write_literal (out, &expr->literal);
             break;
         case SPK_EXPR_TYPE_GROUPING:
-            res = spk_process_grouping (&expr->grouping);
+            spk_write_parenthesized (out, "group", 1, expr->grouping.expr);
             break;
         case SPK_EXPR_TYPE_UNARY:
-            res = spk_process_unary (&expr->unary);
+            spk_write_parenthesized (out, spk_operator_str (expr->unary.operator), 1,
+                                     expr->unary.right);
             break;
         case SPK_EXPR_TYPE_BINARY:
-            res = spk_process_binary (&expr->binary);
+            spk_write_parenthesized (out, spk_operator_str (expr->binary.operator), 2,
+                                     expr->binary.left, expr->binary.right);
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            spk_strbuf_append (out, expr->var.name);
             break;
         default:
             assert (false);
     }
-
-    return res;
 }
 
 static const char *
@@ -114,16 +95,67 @@ spk_expression_type_str (SPK_expr_type type)
         case SPK_EXPR_TYPE_UNARY: return "SPK_EXPR_TYPE_UNARY";
         case SPK_EXPR_TYPE_GROUPING: return "SPK_EXPR_TYPE_GROUPING";
         case SPK_EXPR_TYPE_BINARY: return "SPK_EXPR_TYPE_BINARY";
+        case SPK_EXPR_TYPE_VAR: return "SPK_EXPR_TYPE_VAR";
         default: return "Unknown";
     }
 }
 
+char *
+spk_expression_to_string (const spk_expr_t *expr)
+{
+    spk_strbuf_t out;
+    spk_strbuf_init (&out);
+    spk_write_expression (&out, expr);
+    return spk_strbuf_take (&out);
+}
+
 void spk_print_expression (const spk_expr_t *expr)
 {
-    char *expr_str = spk_process_expression (expr);
+    char *expr_str = spk_expression_to_string (expr);
     printf ("Expression:\n");
     printf ("\tType: %s\n", spk_expression_type_str (expr->type));
     printf ("\t%s\n", expr_str);
     free (expr_str);
 }
 
+
+static void
+spk_write_statement (spk_strbuf_t *out, const spk_statement_t *stmt)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            spk_write_parenthesized (out, "print", 1, stmt->print.expr);
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            spk_write_parenthesized (out, "expr", 1, stmt->expr.expr);
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            spk_strbuf_appendf (out, "(var %s", stmt->var.name);
+            if (stmt->var.initializer) {
+                spk_strbuf_append (out, " ");
+                spk_write_expression (out, stmt->var.initializer);
+            }
+            spk_strbuf_append (out, ")");
+            break;
+        default:
+            assert (false);
+    }
+}
+
+void
+spk_print_statement (const spk_statement_t *stmt)
+{
+    spk_strbuf_t out;
+    spk_strbuf_init (&out);
+    spk_write_statement (&out, stmt);
+    printf ("%s\n", out.data);
+    spk_strbuf_free (&out);
+}
+
+void
+spk_print_statements (darray_t *statements)
+{
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_print_statement (darray_elem (statements, i));
+    }
+}
@@ -1,5 +1,13 @@
 #pragma once
 
+#include "../utils/darray.h"
+
 typedef struct spk_expr_s spk_expr_t;
 void spk_print_expression (const spk_expr_t *expr);
+// S-expression of the tree, the caller frees the string
+char *spk_expression_to_string (const spk_expr_t *expr);
+typedef struct spk_statement_s spk_statement_t;
+void spk_print_statement (const spk_statement_t *stmt);
+// One s-expression per statement ([spk_statement_t, ...])
+void spk_print_statements (darray_t *statements);
 
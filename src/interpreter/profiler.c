@@ -0,0 +1,239 @@
+#include "profiler.h"
+#include "statements.h"
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#define SPK_PROFILER_SOURCE_WIDTH 60
+
+struct spk_profiler_s {
+    darray_t *statements;
+    size_t   statement_count;
+    uint64_t *samples; // Per statement
+
+    // Written by the engine, read by the signal handler
+    volatile size_t current;
+
+    char     *source;
+    uint32_t *line_offsets; // Index = line - 1
+    uint32_t line_count;
+
+    struct sigaction old_action;
+    struct itimerval old_timer;
+};
+
+typedef struct spk_profiler_line_s {
+    uint32_t line;
+    uint64_t samples;
+} spk_profiler_line_t;
+
+static spk_profiler_t *volatile spk_profiler_running;
+
+static void
+spk_profiler_tick (int signal)
+{
+    auto profiler = spk_profiler_running;
+    if (profiler && profiler->current < profiler->statement_count) {
+        ++profiler->samples[profiler->current];
+    }
+}
+
+spk_profiler_t *
+spk_profiler_create (darray_t *statements, const char *source, size_t length)
+{
+    spk_profiler_t *profiler = calloc (1, sizeof (spk_profiler_t));
+    profiler->statements = statements;
+    profiler->statement_count = statements->count;
+    profiler->samples = calloc (statements->count + 1, sizeof (uint64_t));
+    profiler->current = SIZE_MAX;
+
+    profiler->source = malloc (length + 1);
+    memcpy (profiler->source, source, length);
+    profiler->source[length] = '\0';
+
+    uint32_t lines = 1;
+    for (size_t i = 0; i < length; ++i) {
+        lines += source[i] == '\n';
+    }
+
+    profiler->line_offsets = calloc (lines, sizeof (uint32_t));
+    profiler->line_count = lines;
+
+    uint32_t line = 0;
+    for (size_t i = 0; i < length; ++i) {
+        if (source[i] == '\n') {
+            profiler->line_offsets[++line] = (uint32_t)(i + 1);
+        }
+    }
+
+    return profiler;
+}
+
+void
+spk_profiler_free (spk_profiler_t *profiler)
+{
+    if (spk_profiler_running == profiler) {
+        spk_profiler_stop (profiler);
+    }
+
+    free (profiler->samples);
+    free (profiler->line_offsets);
+    free (profiler->source);
+    free (profiler);
+}
+
+bool
+spk_profiler_start (spk_profiler_t *profiler)
+{
+    if (spk_profiler_running) {
+        return false;
+    }
+
+    struct sigaction action = {
+        .sa_handler = spk_profiler_tick,
+        .sa_flags = SA_RESTART
+    };
+    sigemptyset (&action.sa_mask);
+
+    if (sigaction (SIGPROF, &action, &profiler->old_action) != 0) {
+        return false;
+    }
+
+    spk_profiler_running = profiler;
+
+    struct itimerval timer = {
+        .it_interval = { .tv_sec = 0, .tv_usec = SPK_PROFILER_INTERVAL_US },
+        .it_value = { .tv_sec = 0, .tv_usec = SPK_PROFILER_INTERVAL_US }
+    };
+
+    if (setitimer (ITIMER_PROF, &timer, &profiler->old_timer) != 0) {
+        sigaction (SIGPROF, &profiler->old_action, nullptr);
+        spk_profiler_running = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+void
+spk_profiler_stop (spk_profiler_t *profiler)
+{
+    if (spk_profiler_running != profiler) {
+        return;
+    }
+
+    // The timer goes first, no tick can come in once the handler is gone
+    setitimer (ITIMER_PROF, &profiler->old_timer, nullptr);
+    sigaction (SIGPROF, &profiler->old_action, nullptr);
+
+    spk_profiler_running = nullptr;
+    profiler->current = SIZE_MAX;
+}
+
+void
+spk_profiler_enter (spk_profiler_t *profiler, size_t index)
+{
+    profiler->current = index;
+}
+
+static void
+spk_profiler_write_statement (const spk_statement_t *stmt, FILE *out)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_VAR:
+            fprintf (out, "var %s", stmt->var.name);
+            break;
+        case SPK_STATEMENT_TYPE_PRINT:
+            fprintf (out, "print");
+            break;
+        default:
+            fprintf (out, "expression");
+            break;
+    }
+}
+
+void
+spk_profiler_write_folded (const spk_profiler_t *profiler, const char *script, FILE *out)
+{
+    for (size_t i = 0; i < profiler->statement_count; ++i) {
+        if (profiler->samples[i] == 0) {
+            continue;
+        }
+
+        spk_statement_t *stmt = darray_elem (profiler->statements, i);
+        fprintf (out, "%s;line %u;", script, stmt->line);
+        spk_profiler_write_statement (stmt, out);
+        fprintf (out, " %" PRIu64 "\n", profiler->samples[i]);
+    }
+}
+
+static int
+spk_profiler_compare_lines (const void *a, const void *b)
+{
+    const spk_profiler_line_t *x = a;
+    const spk_profiler_line_t *y = b;
+
+    if (x->samples != y->samples) {
+        return x->samples < y->samples ? 1 : -1;
+    }
+
+    return (x->line > y->line) - (x->line < y->line);
+}
+
+// Leading whitespace and the line break are left out
+static const char *
+spk_profiler_line_text (const spk_profiler_t *profiler, uint32_t line, int *length)
+{
+    if (line == 0 || line > profiler->line_count) {
+        *length = 0;
+        return "";
+    }
+
+    const char *text = profiler->source + profiler->line_offsets[line - 1];
+    while (*text == ' ' || *text == '\t') {
+        ++text;
+    }
+
+    size_t end = strcspn (text, "\r\n");
+    *length = end > SPK_PROFILER_SOURCE_WIDTH ? SPK_PROFILER_SOURCE_WIDTH : (int)end;
+    return text;
+}
+
+void
+spk_profiler_print_hotspots (const spk_profiler_t *profiler, uint32_t max_lines)
+{
+    // Statements come in source order, those sharing a line are next to each other
+    spk_profiler_line_t *lines = calloc (profiler->statement_count + 1, sizeof (spk_profiler_line_t));
+    size_t line_count = 0;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < profiler->statement_count; ++i) {
+        spk_statement_t *stmt = darray_elem (profiler->statements, i);
+        auto samples = profiler->samples[i];
+        total += samples;
+
+        if (line_count > 0 && lines[line_count - 1].line == stmt->line) {
+            lines[line_count - 1].samples += samples;
+        } else if (samples > 0) {
+            lines[line_count++] = (spk_profiler_line_t) { stmt->line, samples };
+        }
+    }
+
+    qsort (lines, line_count, sizeof (spk_profiler_line_t), spk_profiler_compare_lines);
+
+    printf ("Profile: %" PRIu64 " samples, %u us of CPU time apart\n", total,
+            SPK_PROFILER_INTERVAL_US);
+    printf ("  %10s %7s %7s  %s\n", "samples", "%", "line", "source");
+
+    for (size_t i = 0; i < line_count && i < max_lines; ++i) {
+        int length;
+        auto text = spk_profiler_line_text (profiler, lines[i].line, &length);
+        printf ("  %10" PRIu64 " %6.1f%% %7u  %.*s\n", lines[i].samples,
+                100.0 * (double)lines[i].samples / (double)total, lines[i].line, length, text);
+    }
+
+    free (lines);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../utils/darray.h"
+
+/*
+ Sampling profiler for the ast engine. While it runs, a SIGPROF timer
+ ticks every SPK_PROFILER_INTERVAL_US of CPU time the process uses and
+ each tick is charged to the statement the engine marked as current.
+ Marking a statement is a call and a store, the engine runs at full
+ speed in between. The kernel's CPU clock granularity means scripts
+ running for less than a few milliseconds get few or no samples.
+
+ Results come out per statement, as folded stacks (script;line;statement
+ count, the input of flamegraph.pl and speedscope), and per source line
+ as a table of the hottest ones.
+
+ The timer and its signal are process-wide, only one profiler can run
+ at a time.
+*/
+
+#define SPK_PROFILER_INTERVAL_US 1000
+
+typedef struct spk_profiler_s spk_profiler_t;
+
+// Statements are numbered by their index in statements, which have to
+// outlive the profiler. The source is copied for the line texts.
+spk_profiler_t *spk_profiler_create (darray_t *statements, const char *source, size_t length);
+void            spk_profiler_free (spk_profiler_t *profiler);
+
+// Returns false if the timer couldn't be set up or another profiler is running
+bool spk_profiler_start (spk_profiler_t *profiler);
+void spk_profiler_stop (spk_profiler_t *profiler);
+
+// Ticks go to statement index from now on
+void spk_profiler_enter (spk_profiler_t *profiler, size_t index);
+
+void spk_profiler_write_folded (const spk_profiler_t *profiler, const char *script, FILE *out);
+// Prints at most max_lines lines, hottest first
+void spk_profiler_print_hotspots (const spk_profiler_t *profiler, uint32_t max_lines);
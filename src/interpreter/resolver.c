@@ -0,0 +1,149 @@
+#include "resolver.h"
+#include "expressions.h"
+#include "statements.h"
+#include "symbols.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+typedef struct spk_resolver_ctx_s {
+    spk_symbol_map_t globals; // symbol -> global slot
+    bool             had_error;
+} spk_resolver_ctx_t;
+
+struct spk_resolver_s {
+    spk_resolver_ctx_t ctx;
+};
+
+static void
+spk_resolver_report_err (spk_resolver_ctx_t *ctx, const char *msg, const char *name)
+{
+    printf ("Resolver error: %s '%s'\n", msg, name);
+    ctx->had_error = true;
+}
+
+static void
+spk_resolve_expression (spk_resolver_ctx_t *ctx, spk_expr_t *expr)
+{
+    // Left behind by a parse error, nothing past the resolver expects one
+    if (!expr) {
+        printf ("Resolver error: Missing expression\n");
+        ctx->had_error = true;
+        return;
+    }
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            break;
+        case SPK_EXPR_TYPE_GROUPING:
+            spk_resolve_expression (ctx, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            spk_resolve_expression (ctx, expr->unary.right);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            spk_resolve_expression (ctx, expr->binary.left);
+            spk_resolve_expression (ctx, expr->binary.right);
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            auto slot = spk_symbol_map_find (&ctx->globals, expr->var.symbol);
+            if (!slot) {
+                spk_resolver_report_err (ctx, "Use of undeclared variable", expr->var.name);
+                break;
+            }
+
+            expr->var.slot = *slot;
+            break;
+        default:
+            assert (false);
+    }
+}
+
+static uint32_t
+spk_resolver_declare_global (spk_resolver_ctx_t *ctx, spk_symbol_t symbol, const char *name)
+{
+    auto slot = ctx->globals.count;
+    if (!spk_symbol_map_insert (&ctx->globals, symbol, slot)) {
+        spk_resolver_report_err (ctx, "Redeclaration of variable", name);
+        return SPK_SLOT_UNRESOLVED;
+    }
+
+    return slot;
+}
+
+static void
+spk_resolve_var (spk_resolver_ctx_t *ctx, spk_var_statement_t *var)
+{
+    // The initializer is resolved first, a variable can't refer to itself
+    if (var->initializer) {
+        spk_resolve_expression (ctx, var->initializer);
+    }
+
+    auto slot = spk_resolver_declare_global (ctx, var->symbol, var->name);
+    if (slot != SPK_SLOT_UNRESOLVED) {
+        var->slot = slot;
+    }
+}
+
+static void
+spk_resolve_statement (spk_resolver_ctx_t *ctx, spk_statement_t *stmt)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            spk_resolve_expression (ctx, stmt->print.expr);
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            spk_resolve_expression (ctx, stmt->expr.expr);
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            spk_resolve_var (ctx, &stmt->var);
+            break;
+        default:
+            assert (false);
+    }
+}
+
+spk_resolver_t *
+spk_resolver_create ()
+{
+    spk_resolver_t *resolver = calloc (1, sizeof (spk_resolver_t));
+    spk_symbol_map_init (&resolver->ctx.globals);
+    return resolver;
+}
+
+void
+spk_resolver_free (spk_resolver_t *resolver)
+{
+    spk_symbol_map_free (&resolver->ctx.globals);
+    free (resolver);
+}
+
+bool
+spk_resolver_resolve (spk_resolver_t *resolver, spk_statement_t *stmt)
+{
+    spk_resolve_statement (&resolver->ctx, stmt);
+    return !resolver->ctx.had_error;
+}
+
+bool
+spk_resolver_declare (spk_resolver_t *resolver, spk_symbol_t symbol, const char *name)
+{
+    return spk_resolver_declare_global (&resolver->ctx, symbol, name) != SPK_SLOT_UNRESOLVED;
+}
+
+bool
+spk_resolve_statements (darray_t *statements)
+{
+    spk_resolver_ctx_t ctx = {
+        .had_error = false
+    };
+    spk_symbol_map_init (&ctx.globals);
+
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_resolve_statement (&ctx, darray_elem (statements, i));
+    }
+
+    spk_symbol_map_free (&ctx.globals);
+    return !ctx.had_error;
+}
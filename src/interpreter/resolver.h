@@ -0,0 +1,31 @@
+#pragma once
+
+#include "symbols.h"
+
+#include "../utils/darray.h"
+
+/*
+ Static resolution, run between parsing and execution. Every variable
+ declaration gets a global slot and every variable use is bound to the
+ slot of its declaration, so the engines index arrays instead of looking
+ names up.
+*/
+
+// Fills in the slot of every spk_var_statement_t and spk_var_expr_t in
+// statements ([spk_statement_t, ...]). Undeclared and redeclared variables
+// are reported, and false returned, before anything runs.
+bool spk_resolve_statements (darray_t *statements);
+
+// Resolves a program one statement at a time, declarations stay
+// visible to every later statement
+typedef struct spk_resolver_s spk_resolver_t;
+typedef struct spk_statement_s spk_statement_t;
+
+spk_resolver_t *spk_resolver_create ();
+void            spk_resolver_free (spk_resolver_t *resolver);
+// Returns false once any statement failed to resolve
+bool            spk_resolver_resolve (spk_resolver_t *resolver, spk_statement_t *stmt);
+// Declares a global ahead of the statements, it gets the next slot as
+// a var statement would. Returns false if name is already declared.
+bool            spk_resolver_declare (spk_resolver_t *resolver, spk_symbol_t symbol,
+                                      const char *name);
@@ -0,0 +1,237 @@
+#include "scan.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#   include <immintrin.h>
+#   define SPK_SCAN_X86 1
+#else
+#   define SPK_SCAN_X86 0
+#endif
+
+static inline bool
+spk_scan_is_whitespace (char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool
+spk_scan_is_ident_char (char c)
+{
+    return (c >= 'a' && c <= 'z') ||
+           (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') ||
+            c == '_';
+}
+
+static const char *
+spk_scan_whitespace_scalar (const char *p, const char *end, uint32_t *lines)
+{
+    for (; p < end && spk_scan_is_whitespace (*p); ++p) {
+        *lines += *p == '\n';
+    }
+
+    return p;
+}
+
+static const char *
+spk_scan_until_scalar (const char *p, const char *end, char c, uint32_t *lines)
+{
+    for (; p < end && *p != c; ++p) {
+        if (lines) {
+            *lines += *p == '\n';
+        }
+    }
+
+    return p;
+}
+
+static const char *
+spk_scan_identifier_scalar (const char *p, const char *end)
+{
+    while (p < end && spk_scan_is_ident_char (*p)) {
+        ++p;
+    }
+
+    return p;
+}
+
+#if SPK_SCAN_X86
+
+/*
+ The SSE2 and AVX2 versions are the same algorithm at two widths: build a
+ bitmask with one bit per byte for "keeps the scan going" and one for
+ '\n', stop at the first zero bit of the former and popcount the latter
+ up to there. Whatever doesn't fill a whole vector goes to the scalar
+ version.
+
+ SSE2 only has signed byte compares, which is fine as every byte we look
+ for is ASCII and the rest (>= 0x80) compares as negative.
+*/
+
+#define SPK_SCAN_DEFINE(suffix, isa, vec, width, load, set1, cmpeq, cmpgt, vor, vand, movemask) \
+    __attribute__((target (isa))) static inline uint32_t \
+    spk_scan_ident_mask_##suffix (vec v) \
+    { \
+        /* OR-ing in 0x20 folds 'A'-'Z' onto 'a'-'z' without creating new letters */ \
+        vec lower = vor (v, set1 (0x20)); \
+        vec alpha = vand (cmpgt (lower, set1 ('a' - 1)), cmpgt (set1 ('z' + 1), lower)); \
+        vec digit = vand (cmpgt (v, set1 ('0' - 1)), cmpgt (set1 ('9' + 1), v)); \
+        return (uint32_t)movemask (vor (vor (alpha, digit), cmpeq (v, set1 ('_')))); \
+    } \
+    \
+    __attribute__((target (isa))) static const char * \
+    spk_scan_whitespace_##suffix (const char *p, const char *end, uint32_t *lines) \
+    { \
+        const uint32_t full = (uint32_t)((1ull << width) - 1); \
+        \
+        for (; end - p >= width; p += width) { \
+            vec v = load ((const vec *)p); \
+            vec nl = cmpeq (v, set1 ('\n')); \
+            uint32_t ws = (uint32_t)movemask (vor (vor (cmpeq (v, set1 (' ')), cmpeq (v, set1 ('\t'))), \
+                                                  vor (cmpeq (v, set1 ('\r')), nl))); \
+            uint32_t newlines = (uint32_t)movemask (nl); \
+            \
+            if (ws != full) { \
+                uint32_t stop = (uint32_t)__builtin_ctz (~ws); \
+                *lines += (uint32_t)__builtin_popcount (newlines & ((1u << stop) - 1)); \
+                return p + stop; \
+            } \
+            \
+            *lines += (uint32_t)__builtin_popcount (newlines); \
+        } \
+        \
+        return spk_scan_whitespace_scalar (p, end, lines); \
+    } \
+    \
+    __attribute__((target (isa))) static const char * \
+    spk_scan_until_##suffix (const char *p, const char *end, char c, uint32_t *lines) \
+    { \
+        vec needle = set1 (c); \
+        \
+        for (; end - p >= width; p += width) { \
+            vec v = load ((const vec *)p); \
+            uint32_t found = (uint32_t)movemask (cmpeq (v, needle)); \
+            uint32_t newlines = lines ? (uint32_t)movemask (cmpeq (v, set1 ('\n'))) : 0; \
+            \
+            if (found) { \
+                uint32_t stop = (uint32_t)__builtin_ctz (found); \
+                if (lines) { \
+                    *lines += (uint32_t)__builtin_popcount (newlines & ((1u << stop) - 1)); \
+                } \
+                return p + stop; \
+            } \
+            \
+            if (lines) { \
+                *lines += (uint32_t)__builtin_popcount (newlines); \
+            } \
+        } \
+        \
+        return spk_scan_until_scalar (p, end, c, lines); \
+    } \
+    \
+    __attribute__((target (isa))) static const char * \
+    spk_scan_identifier_##suffix (const char *p, const char *end) \
+    { \
+        const uint32_t full = (uint32_t)((1ull << width) - 1); \
+        \
+        for (; end - p >= width; p += width) { \
+            uint32_t ident = spk_scan_ident_mask_##suffix (load ((const vec *)p)); \
+            if (ident != full) { \
+                return p + __builtin_ctz (~ident); \
+            } \
+        } \
+        \
+        return spk_scan_identifier_scalar (p, end); \
+    }
+
+SPK_SCAN_DEFINE (sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_set1_epi8,
+                 _mm_cmpeq_epi8, _mm_cmpgt_epi8, _mm_or_si128, _mm_and_si128,
+                 _mm_movemask_epi8)
+SPK_SCAN_DEFINE (avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_set1_epi8,
+                 _mm256_cmpeq_epi8, _mm256_cmpgt_epi8, _mm256_or_si256, _mm256_and_si256,
+                 _mm256_movemask_epi8)
+
+#undef SPK_SCAN_DEFINE
+
+#endif // SPK_SCAN_X86
+
+static const spk_scanner_t spk_scanners[SPK_SCAN_IMPL_COUNT] = {
+    [SPK_SCAN_IMPL_SCALAR] = {
+        spk_scan_whitespace_scalar, spk_scan_until_scalar, spk_scan_identifier_scalar
+    },
+#if SPK_SCAN_X86
+    [SPK_SCAN_IMPL_SSE2] = {
+        spk_scan_whitespace_sse2, spk_scan_until_sse2, spk_scan_identifier_sse2
+    },
+    [SPK_SCAN_IMPL_AVX2] = {
+        spk_scan_whitespace_avx2, spk_scan_until_avx2, spk_scan_identifier_avx2
+    },
+#endif
+};
+
+spk_scanner_t spk_scanner = {
+    spk_scan_whitespace_scalar, spk_scan_until_scalar, spk_scan_identifier_scalar
+};
+
+static SPK_scan_impl spk_scan_impl = SPK_SCAN_IMPL_SCALAR;
+
+const char *
+spk_scan_impl_str (SPK_scan_impl impl)
+{
+    switch (impl) {
+        case SPK_SCAN_IMPL_SCALAR: return "scalar";
+        case SPK_SCAN_IMPL_SSE2:   return "sse2";
+        case SPK_SCAN_IMPL_AVX2:   return "avx2";
+        default:
+            return "unknown";
+    }
+}
+
+bool
+spk_scan_impl_available (SPK_scan_impl impl)
+{
+    switch (impl) {
+        case SPK_SCAN_IMPL_SCALAR:
+            return true;
+#if SPK_SCAN_X86
+        case SPK_SCAN_IMPL_SSE2:
+            return __builtin_cpu_supports ("sse2");
+        case SPK_SCAN_IMPL_AVX2:
+            return __builtin_cpu_supports ("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+SPK_scan_impl
+spk_scan_impl_current ()
+{
+    return spk_scan_impl;
+}
+
+bool
+spk_scan_use (SPK_scan_impl impl)
+{
+    if (!spk_scan_impl_available (impl)) {
+        return false;
+    }
+
+    spk_scanner = spk_scanners[impl];
+    spk_scan_impl = impl;
+    return true;
+}
+
+// Picks the widest implementation the CPU supports before main
+__attribute__((constructor)) static void
+spk_scan_init ()
+{
+#if SPK_SCAN_X86
+    __builtin_cpu_init ();
+#endif
+
+    for (int impl = SPK_SCAN_IMPL_COUNT - 1; impl >= 0; --impl) {
+        if (spk_scan_use ((SPK_scan_impl)impl)) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ Bulk character scanning for the lexer. Each function returns a pointer to
+ the first byte in [p, end) that stops the scan, or end. Nothing is read
+ at or past end.
+
+ The implementation is picked once at startup from what the CPU supports,
+ spk_scan_use can override it (the benchmarks compare all of them).
+*/
+
+typedef enum {
+    SPK_SCAN_IMPL_SCALAR,
+    SPK_SCAN_IMPL_SSE2,
+    SPK_SCAN_IMPL_AVX2,
+
+    SPK_SCAN_IMPL_COUNT
+} SPK_scan_impl;
+
+const char   *spk_scan_impl_str (SPK_scan_impl impl);
+bool          spk_scan_impl_available (SPK_scan_impl impl);
+SPK_scan_impl spk_scan_impl_current ();
+// Returns false and keeps the current implementation if impl isn't available
+bool          spk_scan_use (SPK_scan_impl impl);
+
+typedef struct spk_scanner_s {
+    // Skips ' ', '\t', '\r' and '\n', adding the newlines skipped to *lines
+    const char *(*whitespace) (const char *p, const char *end, uint32_t *lines);
+    // Finds c, adding the newlines skipped to *lines when lines isn't nullptr
+    const char *(*until) (const char *p, const char *end, char c, uint32_t *lines);
+    // Skips [A-Za-z0-9_]
+    const char *(*identifier) (const char *p, const char *end);
+} spk_scanner_t;
+
+extern spk_scanner_t spk_scanner;
+
+static inline const char *
+spk_scan_whitespace (const char *p, const char *end, uint32_t *lines)
+{
+    return spk_scanner.whitespace (p, end, lines);
+}
+
+static inline const char *
+spk_scan_until (const char *p, const char *end, char c, uint32_t *lines)
+{
+    return spk_scanner.until (p, end, c, lines);
+}
+
+static inline const char *
+spk_scan_identifier (const char *p, const char *end)
+{
+    return spk_scanner.identifier (p, end);
+}
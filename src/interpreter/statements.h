@@ -11,8 +11,10 @@ typedef struct spk_print_statement_s {
 } spk_print_statement_t;
 
 typedef struct spk_var_statement_s {
-    spk_token_t name;
-    spk_expr_t *initializer;
+    spk_symbol_t symbol;
+    const char   *name; // Interned, only kept around for error messages
+    uint32_t     slot;  // Global slot, filled in by the resolver
+    spk_expr_t   *initializer;
     bool mutable;
 } spk_var_statement_t;
 
@@ -25,6 +27,7 @@ typedef enum {
 
 typedef struct spk_statement_s {
     SPK_statement_type type;
+    uint32_t           line; // Of its first token
     union {
         spk_expr_statement_t expr;
         spk_print_statement_t print;
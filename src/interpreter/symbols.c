@@ -0,0 +1,159 @@
+#include "symbols.h"
+#include "../utils/arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define SPK_SYMBOL_TABLE_INITIAL_CAPACITY 256
+
+typedef struct spk_symbol_entry_s {
+    const char *name;
+    uint32_t   len;
+    uint32_t   hash;
+} spk_symbol_entry_t;
+
+struct spk_symbol_table_s {
+    spk_arena_t        names;    // Interned spellings, null-terminated
+    spk_symbol_entry_t *symbols; // Index = symbol
+    uint32_t           count;
+    uint32_t           symbols_capacity;
+
+    spk_symbol_t *slots;         // Hash index into symbols
+    uint32_t     capacity;       // Power of two, kept at most half full
+};
+
+// Eight bytes at a time, identifiers in generated code get long
+static inline uint32_t
+spk_symbol_hash (const char *text, size_t len)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ len;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy (&word, text + i, sizeof (word));
+        hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+        hash ^= hash >> 32;
+    }
+
+    uint64_t tail = 0;
+    memcpy (&tail, text + i, len - i);
+    hash = (hash ^ tail) * 0xc4ceb9fe1a85ec53ull;
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void
+spk_symbol_table_alloc_slots (spk_symbol_table_t *table, uint32_t capacity)
+{
+    table->capacity = capacity;
+    table->slots = malloc (capacity * sizeof (spk_symbol_t));
+    memset (table->slots, 0xff, capacity * sizeof (spk_symbol_t));
+}
+
+spk_symbol_table_t *
+spk_symbol_table_create ()
+{
+    spk_symbol_table_t *table = calloc (1, sizeof (spk_symbol_table_t));
+    spk_arena_init (&table->names, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    spk_symbol_table_alloc_slots (table, SPK_SYMBOL_TABLE_INITIAL_CAPACITY);
+    return table;
+}
+
+void
+spk_symbol_table_free (spk_symbol_table_t *table)
+{
+    spk_arena_release (&table->names);
+    free (table->symbols);
+    free (table->slots);
+    free (table);
+}
+
+static void
+spk_symbol_table_grow (spk_symbol_table_t *table)
+{
+    free (table->slots);
+    spk_symbol_table_alloc_slots (table, table->capacity * 2);
+
+    uint32_t mask = table->capacity - 1;
+    for (spk_symbol_t symbol = 0; symbol < table->count; ++symbol) {
+        uint32_t idx = table->symbols[symbol].hash & mask;
+        while (table->slots[idx] != SPK_SYMBOL_NONE) {
+            idx = (idx + 1) & mask;
+        }
+
+        table->slots[idx] = symbol;
+    }
+}
+
+static spk_symbol_t
+spk_symbol_intern_hashed (spk_symbol_table_t *table, const char *text, size_t len, uint32_t hash)
+{
+    uint32_t mask = table->capacity - 1;
+    uint32_t idx = hash & mask;
+
+    for (;;) {
+        spk_symbol_t symbol = table->slots[idx];
+        if (symbol == SPK_SYMBOL_NONE) {
+            break;
+        }
+
+        auto entry = &table->symbols[symbol];
+        if (entry->hash == hash && entry->len == len &&
+            memcmp (entry->name, text, len) == 0) {
+            return symbol;
+        }
+
+        idx = (idx + 1) & mask;
+    }
+
+    if (table->count == table->symbols_capacity) {
+        table->symbols_capacity = table->symbols_capacity ? table->symbols_capacity * 2 : 64;
+        table->symbols = reallocarray (table->symbols, table->symbols_capacity,
+                                       sizeof (spk_symbol_entry_t));
+    }
+
+    spk_symbol_t symbol = table->count++;
+    table->symbols[symbol] = (spk_symbol_entry_t) {
+        .name = spk_arena_strndup (&table->names, text, len),
+        .len = (uint32_t)len,
+        .hash = hash
+    };
+    table->slots[idx] = symbol;
+
+    if (table->count * 2 > table->capacity) {
+        spk_symbol_table_grow (table);
+    }
+
+    return symbol;
+}
+
+spk_symbol_t
+spk_symbol_intern (spk_symbol_table_t *table, const char *text, size_t len)
+{
+    assert (len <= UINT32_MAX);
+    return spk_symbol_intern_hashed (table, text, len, spk_symbol_hash (text, len));
+}
+
+void
+spk_symbol_table_merge (spk_symbol_table_t *table, const spk_symbol_table_t *other,
+                        spk_symbol_t *remap)
+{
+    for (spk_symbol_t symbol = 0; symbol < other->count; ++symbol) {
+        auto entry = &other->symbols[symbol];
+        remap[symbol] = spk_symbol_intern_hashed (table, entry->name, entry->len, entry->hash);
+    }
+}
+
+const char *
+spk_symbol_name (const spk_symbol_table_t *table, spk_symbol_t symbol)
+{
+    assert (symbol < table->count);
+    return table->symbols[symbol].name;
+}
+
+uint32_t
+spk_symbol_count (const spk_symbol_table_t *table)
+{
+    return table->count;
+}
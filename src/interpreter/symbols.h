@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../utils/map.h"
+
+/*
+ Interned identifiers. Every distinct identifier spelling is stored once
+ and gets a dense id, so everything past the lexer compares and hashes
+ integers instead of strings.
+*/
+
+typedef uint32_t spk_symbol_t;
+
+#define SPK_SYMBOL_NONE UINT32_MAX
+
+typedef struct spk_symbol_table_s spk_symbol_table_t;
+
+spk_symbol_table_t *spk_symbol_table_create ();
+void                spk_symbol_table_free (spk_symbol_table_t *table);
+
+spk_symbol_t spk_symbol_intern (spk_symbol_table_t *table, const char *text, size_t len);
+// Null-terminated, lives as long as the table
+const char  *spk_symbol_name (const spk_symbol_table_t *table, spk_symbol_t symbol);
+uint32_t     spk_symbol_count (const spk_symbol_table_t *table);
+
+// Interns every symbol of other into table in id order, remap[symbol of other]
+// receives the symbol in table. remap has room for spk_symbol_count (other).
+void spk_symbol_table_merge (spk_symbol_table_t *table, const spk_symbol_table_t *other,
+                             spk_symbol_t *remap);
+
+// Symbols are dense, Fibonacci hashing spreads consecutive ids apart
+static inline uint32_t
+spk_symbol_map_hash (spk_symbol_t symbol)
+{
+    return symbol * 2654435769u;
+}
+
+// Map from symbols to uint32_t values (global slots, storage indices)
+SPK_MAP_DECLARE (spk_symbol_map, spk_symbol_t, uint32_t, SPK_SYMBOL_NONE, spk_symbol_map_hash)
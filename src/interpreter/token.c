@@ -1,19 +1,24 @@
 #include "token.h"
+#include "lexer.h"
+#include "object.h"
+
+#include "../utils/arena.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 
 char *
 spk_token_literal_to_string (const spk_token_literal_t *literal)
 {
-    static char integer_buf[50] = { 0 };
-    char *str = nullptr;
+    char integer_buf[16];
+    const char *str = nullptr;
     switch (literal->type) {
         case SPK_TOKEN_LITERAL_EMPTY:
             break;
         case SPK_TOKEN_LITERAL_STRING:
-            str = literal->string.value;
+            str = spk_string_chars (literal->string.value);
             break;
         case SPK_TOKEN_LITERAL_INTEGER:
             snprintf (integer_buf, sizeof (integer_buf),
@@ -44,11 +49,52 @@ spk_token_type_str (const SPK_token_type type)
 }
 
 void
-spk_print_token (const spk_token_t *token) 
+spk_print_token (const spk_token_list_t *list, const spk_token_t *token)
 {
     auto type = spk_token_type_str (token->type);
-    char *literal = spk_token_literal_to_string (&token->literal);
-    printf ("Token(%s, %d, '%s', %s)\n", type, token->line, token->value, literal);
-    free (literal);
+    printf ("Token(%s, %d, '%.*s')\n", type, token->line,
+            (int)token->length, spk_token_text (list, token));
+}
+
+const char *
+spk_token_text (const spk_token_list_t *list, const spk_token_t *token)
+{
+    return list->source + token->offset;
+}
+
+spk_token_literal_t
+spk_token_decode_literal (const spk_token_list_t *list,
+                          const spk_token_t *token,
+                          spk_arena_t *arena)
+{
+    spk_token_literal_t literal = {
+        .type = SPK_TOKEN_LITERAL_EMPTY
+    };
+
+    auto text = spk_token_text (list, token);
+    switch (token->type) {
+        case SPK_TOKEN_TYPE_STRING:
+            literal.type = SPK_TOKEN_LITERAL_STRING;
+            literal.string.value = arena ?
+                                   spk_string_new_literal (arena, text, token->length) :
+                                   spk_string_new (text, token->length);
+            break;
+        case SPK_TOKEN_TYPE_INTEGER:
+            // The lexer has already verified that the token is a valid
+            // integer no larger than INT32_MAX
+            uint64_t value = 0;
+            for (uint32_t i = 0; i < token->length; ++i) {
+                value = value * 10 + (uint64_t)(text[i] - '0');
+            }
+
+            assert (value <= INT32_MAX);
+            literal.type = SPK_TOKEN_LITERAL_INTEGER;
+            literal.integer.value = (int32_t)value;
+            break;
+        default:
+            break;
+    }
+
+    return literal;
 }
 
@@ -3,6 +3,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "symbols.h"
+#include "../utils/vec.h"
+
 #define SPK_TOKEN_TYPE(...)
 #define SPK_TOKEN_ENUM_ITER() \
     SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_EQUAL, nullptr) \
@@ -32,6 +35,12 @@
     SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_VAR, "var") \
     SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_MUT, "mut") \
     SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_PRINT, "print") \
+    SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_FN, "fn") \
+    SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_IF, "if") \
+    SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_ELSE, "else") \
+    SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_FOR, "for") \
+    SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_WHILE, "while") \
+    SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_RETURN, "return") \
     \
     SPK_TOKEN_TYPE(SPK_TOKEN_TYPE_EOF, nullptr)
 #undef SPK_TOKEN_TYPE
@@ -48,8 +57,10 @@ typedef enum {
     SPK_TOKEN_LITERAL_INTEGER
 } SPK_token_literal_type;
 
+typedef struct spk_string_s spk_string_t;
+
 typedef struct spk_token_string_literal_s {
-    char *value;
+    spk_string_t *value; // Immortal when parsed into an arena, see object.h
 } spk_token_string_literal_t;
 
 typedef struct spk_token_integer_literal_s {
@@ -64,15 +75,30 @@ typedef struct spk_token_literal_s {
     };
 } spk_token_literal_t;
 
+// Tokens don't own any memory, they refer to their
+// text by offset into the source they were lexed from
 typedef struct spk_token_s {
-    SPK_token_type      type;
-    char                *value;
-    spk_token_literal_t literal;
-    uint32_t            line;
+    SPK_token_type type;
+    uint32_t       line;
+    uint32_t       offset;
+    uint32_t       length;
+    spk_symbol_t   symbol; // Identifiers only, SPK_SYMBOL_NONE otherwise
 } spk_token_t;
 
+SPK_VEC_DECLARE (spk_token_vec, spk_token_t)
+
+typedef struct spk_token_list_s spk_token_list_t;
+typedef struct spk_arena_s spk_arena_t;
 
 const char *spk_token_type_str (const SPK_token_type type);
 char *spk_token_literal_to_string (const spk_token_literal_t *literal);
-void spk_print_token (const spk_token_t *token);
+void spk_print_token (const spk_token_list_t *list, const spk_token_t *token);
+
+// Start of the token's text in the source, *not* null-terminated
+const char *spk_token_text (const spk_token_list_t *list, const spk_token_t *token);
+// Decodes the value of an integer or string token, string values are
+// immortal strings allocated in the arena, or new references without one
+spk_token_literal_t spk_token_decode_literal (const spk_token_list_t *list,
+                                              const spk_token_t *token,
+                                              spk_arena_t *arena);
 
@@ -0,0 +1,262 @@
+#include "typechecker.h"
+#include "statements.h"
+#include "printer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <assert.h>
+
+typedef struct spk_typechecker_ctx_s {
+    SPK_value_type *globals; // Indexed by global slot
+    uint32_t       global_capacity;
+    bool           had_error;
+} spk_typechecker_ctx_t;
+
+struct spk_typechecker_s {
+    spk_typechecker_ctx_t ctx;
+};
+
+const char *
+spk_value_type_str (SPK_value_type type)
+{
+    switch (type) {
+        case SPK_VALUE_TYPE_UNKNOWN: return "unknown";
+        case SPK_VALUE_TYPE_NIL:     return "nil";
+        case SPK_VALUE_TYPE_INTEGER: return "int";
+        case SPK_VALUE_TYPE_STRING:  return "string";
+        default:
+            return "invalid";
+    }
+}
+
+static SPK_value_type
+spk_literal_value_type (const spk_token_literal_t *literal)
+{
+    switch (literal->type) {
+        case SPK_TOKEN_LITERAL_EMPTY:   return SPK_VALUE_TYPE_NIL;
+        case SPK_TOKEN_LITERAL_INTEGER: return SPK_VALUE_TYPE_INTEGER;
+        case SPK_TOKEN_LITERAL_STRING:  return SPK_VALUE_TYPE_STRING;
+        default:
+            assert (false);
+            return SPK_VALUE_TYPE_UNKNOWN;
+    }
+}
+
+static void
+spk_typechecker_report_err (spk_typechecker_ctx_t *ctx, const spk_expr_t *expr,
+                            const char *fmt, ...)
+{
+    va_list args;
+    va_start (args);
+    printf ("Type error: ");
+    vprintf (fmt, args);
+    va_end (args);
+
+    char *expr_str = spk_expression_to_string (expr);
+    printf (" in %s\n", expr_str);
+    free (expr_str);
+
+    ctx->had_error = true;
+}
+
+static SPK_value_type
+spk_typecheck_expression (spk_typechecker_ctx_t *ctx, spk_expr_t *expr);
+
+static SPK_value_type
+spk_typecheck_unary (spk_typechecker_ctx_t *ctx, spk_expr_t *expr)
+{
+    auto right = spk_typecheck_expression (ctx, expr->unary.right);
+
+    switch (expr->unary.operator) {
+        case SPK_TOKEN_TYPE_MINUS:
+        case SPK_TOKEN_TYPE_NOT:
+            break;
+        default:
+            spk_typechecker_report_err (ctx, expr, "Unsupported unary operator %s",
+                                        spk_token_type_str (expr->unary.operator));
+            return SPK_VALUE_TYPE_UNKNOWN;
+    }
+
+    // Unknown operands have already been reported
+    if (right != SPK_VALUE_TYPE_INTEGER && right != SPK_VALUE_TYPE_UNKNOWN) {
+        spk_typechecker_report_err (ctx, expr, "Operand must be an int, got %s",
+                                    spk_value_type_str (right));
+    }
+
+    return SPK_VALUE_TYPE_INTEGER;
+}
+
+static SPK_value_type
+spk_typecheck_binary (spk_typechecker_ctx_t *ctx, spk_expr_t *expr)
+{
+    auto left = spk_typecheck_expression (ctx, expr->binary.left);
+    auto right = spk_typecheck_expression (ctx, expr->binary.right);
+
+    // Strings can be concatenated and compared, nothing else
+    bool strings = left == SPK_VALUE_TYPE_STRING && right == SPK_VALUE_TYPE_STRING;
+    bool takes_strings = false;
+
+    switch (expr->binary.operator) {
+        case SPK_TOKEN_TYPE_PLUS:
+            if (strings) {
+                return SPK_VALUE_TYPE_STRING;
+            }
+            takes_strings = true;
+            break;
+        case SPK_TOKEN_TYPE_EQUAL_EQUAL:
+        case SPK_TOKEN_TYPE_NOT_EQUAL:
+            if (strings) {
+                return SPK_VALUE_TYPE_INTEGER;
+            }
+            takes_strings = true;
+            break;
+        case SPK_TOKEN_TYPE_MINUS:
+        case SPK_TOKEN_TYPE_MULTIPLY:
+        case SPK_TOKEN_TYPE_DIVIDE:
+        case SPK_TOKEN_TYPE_GREATER:
+        case SPK_TOKEN_TYPE_GREATER_EQUAL:
+        case SPK_TOKEN_TYPE_LESS:
+        case SPK_TOKEN_TYPE_LESS_EQUAL:
+            break;
+        default:
+            spk_typechecker_report_err (ctx, expr, "Unsupported binary operator %s",
+                                        spk_token_type_str (expr->binary.operator));
+            return SPK_VALUE_TYPE_UNKNOWN;
+    }
+
+    if ((left != SPK_VALUE_TYPE_INTEGER && left != SPK_VALUE_TYPE_UNKNOWN) ||
+        (right != SPK_VALUE_TYPE_INTEGER && right != SPK_VALUE_TYPE_UNKNOWN)) {
+        spk_typechecker_report_err (ctx, expr, "Operands must be %s, got %s and %s",
+                                    takes_strings ? "two ints or two strings" : "ints",
+                                    spk_value_type_str (left),
+                                    spk_value_type_str (right));
+    }
+
+    return SPK_VALUE_TYPE_INTEGER;
+}
+
+static SPK_value_type
+spk_typecheck_expression (spk_typechecker_ctx_t *ctx, spk_expr_t *expr)
+{
+    SPK_value_type type = SPK_VALUE_TYPE_UNKNOWN;
+    if (!expr) {
+        printf ("Type error: Missing expression\n");
+        ctx->had_error = true;
+        return type;
+    }
+
+    switch (expr->type) {
+        case SPK_EXPR_TYPE_LITERAL:
+            type = spk_literal_value_type (&expr->literal.value);
+            break;
+        case SPK_EXPR_TYPE_GROUPING:
+            type = spk_typecheck_expression (ctx, expr->grouping.expr);
+            break;
+        case SPK_EXPR_TYPE_UNARY:
+            type = spk_typecheck_unary (ctx, expr);
+            break;
+        case SPK_EXPR_TYPE_BINARY:
+            type = spk_typecheck_binary (ctx, expr);
+            break;
+        case SPK_EXPR_TYPE_VAR:
+            assert (expr->var.slot < ctx->global_capacity);
+            type = ctx->globals[expr->var.slot];
+            break;
+        default:
+            assert (false);
+    }
+
+    expr->value_type = type;
+    return type;
+}
+
+static void
+spk_typechecker_set_global (spk_typechecker_ctx_t *ctx, uint32_t slot, SPK_value_type type)
+{
+    if (slot >= ctx->global_capacity) {
+        uint32_t capacity = ctx->global_capacity ? ctx->global_capacity : 16;
+        while (capacity <= slot) {
+            capacity *= 2;
+        }
+
+        ctx->globals = reallocarray (ctx->globals, capacity, sizeof (SPK_value_type));
+        for (uint32_t i = ctx->global_capacity; i < capacity; ++i) {
+            ctx->globals[i] = SPK_VALUE_TYPE_UNKNOWN;
+        }
+        ctx->global_capacity = capacity;
+    }
+
+    ctx->globals[slot] = type;
+}
+
+static void
+spk_typecheck_var (spk_typechecker_ctx_t *ctx, const spk_var_statement_t *var)
+{
+    assert (var->slot != SPK_SLOT_UNRESOLVED);
+
+    auto type = var->initializer ?
+                spk_typecheck_expression (ctx, var->initializer) :
+                SPK_VALUE_TYPE_NIL;
+
+    spk_typechecker_set_global (ctx, var->slot, type);
+}
+
+static void
+spk_typecheck_statement (spk_typechecker_ctx_t *ctx, spk_statement_t *stmt)
+{
+    switch (stmt->type) {
+        case SPK_STATEMENT_TYPE_PRINT:
+            spk_typecheck_expression (ctx, stmt->print.expr);
+            break;
+        case SPK_STATEMENT_TYPE_EXPR:
+            spk_typecheck_expression (ctx, stmt->expr.expr);
+            break;
+        case SPK_STATEMENT_TYPE_VAR:
+            spk_typecheck_var (ctx, &stmt->var);
+            break;
+        default:
+            assert (false);
+    }
+}
+
+bool
+spk_typecheck_statements (darray_t *statements)
+{
+    spk_typechecker_ctx_t ctx = {
+        .globals = nullptr
+    };
+
+    for (size_t i = 0; i < statements->count; ++i) {
+        spk_typecheck_statement (&ctx, darray_elem (statements, i));
+    }
+
+    free (ctx.globals);
+    return !ctx.had_error;
+}
+
+spk_typechecker_t *
+spk_typechecker_create ()
+{
+    return calloc (1, sizeof (spk_typechecker_t));
+}
+
+void
+spk_typechecker_free (spk_typechecker_t *checker)
+{
+    free (checker->ctx.globals);
+    free (checker);
+}
+
+void
+spk_typechecker_declare (spk_typechecker_t *checker, uint32_t slot, SPK_value_type type)
+{
+    spk_typechecker_set_global (&checker->ctx, slot, type);
+}
+
+bool
+spk_typechecker_check (spk_typechecker_t *checker, spk_statement_t *stmt)
+{
+    spk_typecheck_statement (&checker->ctx, stmt);
+    return !checker->ctx.had_error;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "expressions.h"
+
+#include "../utils/darray.h"
+
+/*
+ Static type checking, run on resolved statements. Every expression gets
+ its value_type and every variable takes the type of its initializer.
+ Operators accept integers, strings can only be concatenated with + and
+ compared with == and !=. Engines running checked programs pick int or
+ string code paths up front and never look at a value's tag to do so.
+*/
+
+const char *spk_value_type_str (SPK_value_type type);
+
+// Returns false after reporting every type error in statements ([spk_statement_t, ...])
+bool spk_typecheck_statements (darray_t *statements);
+
+// Checks a resolved program one statement at a time
+typedef struct spk_typechecker_s spk_typechecker_t;
+typedef struct spk_statement_s spk_statement_t;
+
+spk_typechecker_t *spk_typechecker_create ();
+void               spk_typechecker_free (spk_typechecker_t *checker);
+// Returns false once any statement had a type error
+bool               spk_typechecker_check (spk_typechecker_t *checker, spk_statement_t *stmt);
+// Gives the global in slot a type without a var statement,
+// see spk_resolver_declare
+void               spk_typechecker_declare (spk_typechecker_t *checker, uint32_t slot,
+                                            SPK_value_type type);
@@ -0,0 +1,38 @@
+#include "value.h"
+
+#include <stdio.h>
+
+spk_value_t
+spk_value_from_literal (const spk_token_literal_t *literal)
+{
+    switch (literal->type) {
+        case SPK_TOKEN_LITERAL_INTEGER:
+            return spk_value_int (literal->integer.value);
+        case SPK_TOKEN_LITERAL_STRING:
+            return spk_value_string (literal->string.value);
+        case SPK_TOKEN_LITERAL_EMPTY:
+        default:
+            return spk_value_nil ();
+    }
+}
+
+void
+spk_value_print (spk_value_t value)
+{
+    switch (spk_value_tag (value)) {
+        case SPK_VALUE_TAG_NIL:
+            printf ("empty\n");
+            break;
+        case SPK_VALUE_TAG_BOOL:
+            printf ("%s\n", spk_value_as_bool (value) ? "true" : "false");
+            break;
+        case SPK_VALUE_TAG_INTEGER:
+            printf ("%d\n", spk_value_as_int (value));
+            break;
+        case SPK_VALUE_TAG_STRING:
+            printf ("%s\n", spk_string_chars (spk_value_as_string (value)));
+            break;
+        default:
+            assert (false);
+    }
+}
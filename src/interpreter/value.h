@@ -0,0 +1,159 @@
+#pragma once
+
+#include "token.h"
+#include "object.h"
+
+#include <stdint.h>
+#include <assert.h>
+
+/*
+ Runtime values, what the engines keep on their stacks and in their
+ global slots. A value is a single 64-bit word: the top 16 bits hold the
+ tag and the low 48 bits the payload, so values are passed and returned
+ in a register and arrays of them are half the size of the lexer's
+ tagged union.
+
+ Pointer payloads rely on user-space addresses fitting in 48 bits, as
+ they do on x86-64 and AArch64.
+
+ Ints have the zero tag, an int value is its zero-extended payload. The
+ engines' operators then store results without setting any tag bits, a
+ tag on every arithmetic result would sit on the critical path of the
+ stack machine.
+*/
+
+typedef enum {
+    SPK_VALUE_TAG_INTEGER,
+    SPK_VALUE_TAG_NIL,
+    SPK_VALUE_TAG_BOOL,
+    SPK_VALUE_TAG_STRING, // spk_string_t *
+} SPK_value_tag;
+
+typedef struct spk_value_s {
+    uint64_t bits;
+} spk_value_t;
+
+static_assert (sizeof (spk_value_t) == 8);
+
+#define SPK_VALUE_TAG_SHIFT    48
+#define SPK_VALUE_PAYLOAD_MASK ((UINT64_C (1) << SPK_VALUE_TAG_SHIFT) - 1)
+
+static inline spk_value_t
+spk_value_make (SPK_value_tag tag, uint64_t payload)
+{
+    return (spk_value_t) { ((uint64_t)tag << SPK_VALUE_TAG_SHIFT) | payload };
+}
+
+static inline SPK_value_tag
+spk_value_tag (spk_value_t value)
+{
+    return (SPK_value_tag)(value.bits >> SPK_VALUE_TAG_SHIFT);
+}
+
+static inline spk_value_t
+spk_value_nil ()
+{
+    return spk_value_make (SPK_VALUE_TAG_NIL, 0);
+}
+
+static inline spk_value_t
+spk_value_bool (bool value)
+{
+    return spk_value_make (SPK_VALUE_TAG_BOOL, value);
+}
+
+static inline spk_value_t
+spk_value_int (int32_t value)
+{
+    return spk_value_make (SPK_VALUE_TAG_INTEGER, (uint32_t)value);
+}
+
+// Takes over the caller's reference
+static inline spk_value_t
+spk_value_string (spk_string_t *value)
+{
+    uintptr_t address = (uintptr_t)value;
+    assert ((address & ~SPK_VALUE_PAYLOAD_MASK) == 0);
+    return spk_value_make (SPK_VALUE_TAG_STRING, address);
+}
+
+static inline bool
+spk_value_is_int (spk_value_t value)
+{
+    return spk_value_tag (value) == SPK_VALUE_TAG_INTEGER;
+}
+
+// The accessors don't check the tag, type checked code doesn't need to
+static inline int32_t
+spk_value_as_int (spk_value_t value)
+{
+    return (int32_t)(uint32_t)value.bits;
+}
+
+// Int arithmetic wraps around on overflow, like two's complement
+// hardware, instead of being undefined. The divisor of spk_int_div can't
+// be zero, the engines report that first; INT32_MIN / -1 wraps to INT32_MIN.
+static inline int32_t
+spk_int_add (int32_t left, int32_t right)
+{
+    return (int32_t)((uint32_t)left + (uint32_t)right);
+}
+
+static inline int32_t
+spk_int_sub (int32_t left, int32_t right)
+{
+    return (int32_t)((uint32_t)left - (uint32_t)right);
+}
+
+static inline int32_t
+spk_int_mul (int32_t left, int32_t right)
+{
+    return (int32_t)((uint32_t)left * (uint32_t)right);
+}
+
+static inline int32_t
+spk_int_neg (int32_t right)
+{
+    return (int32_t)(0u - (uint32_t)right);
+}
+
+static inline int32_t
+spk_int_div (int32_t left, int32_t right)
+{
+    return right == -1 ? spk_int_neg (left) : left / right;
+}
+
+static inline bool
+spk_value_as_bool (spk_value_t value)
+{
+    return value.bits & 1;
+}
+
+static inline spk_string_t *
+spk_value_as_string (spk_value_t value)
+{
+    return (spk_string_t *)(uintptr_t)(value.bits & SPK_VALUE_PAYLOAD_MASK);
+}
+
+// Only strings are reference counted, the engines call these where the
+// type checker says a value may be a string and leave ints alone
+static inline void
+spk_value_retain (spk_value_t value)
+{
+    if (spk_value_tag (value) == SPK_VALUE_TAG_STRING) {
+        spk_string_retain (spk_value_as_string (value));
+    }
+}
+
+static inline void
+spk_value_release (spk_value_t value)
+{
+    if (spk_value_tag (value) == SPK_VALUE_TAG_STRING) {
+        spk_string_release (spk_value_as_string (value));
+    }
+}
+
+// String literals are immortal, their values are shared rather than copied
+spk_value_t spk_value_from_literal (const spk_token_literal_t *literal);
+// Prints the value on its own line
+void        spk_value_print (spk_value_t value);
@@ -0,0 +1,158 @@
+#include "vm.h"
+#include "bytecode.h"
+#include "../utils/stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef SPK_VM_COMPUTED_GOTO
+#   if defined (__GNUC__)
+#       define SPK_VM_COMPUTED_GOTO 1
+#   else
+#       define SPK_VM_COMPUTED_GOTO 0
+#   endif
+#endif
+
+#if SPK_VM_COMPUTED_GOTO
+#   define SPK_VM_DEFAULT_DISPATCH SPK_VM_DISPATCH_THREADED
+#else
+#   define SPK_VM_DEFAULT_DISPATCH SPK_VM_DISPATCH_SWITCH
+#endif
+
+typedef struct spk_vm_s {
+    const spk_chunk_t *chunk;
+    const uint8_t     *ip;
+
+    spk_value_t       *stack;
+    spk_value_t       *stack_top;
+
+    spk_value_t       *globals;
+
+    uint64_t          executed; // Statements run, for --stats
+} spk_vm_t;
+
+static void
+spk_vm_report_err (spk_vm_t *vm, const char *msg)
+{
+    size_t offset = (size_t)(vm->ip - (const uint8_t *)vm->chunk->code->data) - 1;
+    printf ("Runtime error: %s (bytecode offset %zu)\n", msg, offset);
+}
+
+#define SPK_VM_EXECUTE_FN spk_vm_execute_switch
+#define SPK_VM_DISPATCH_BEGIN for (;;) { switch ((SPK_opcode)*ip++) {
+#define SPK_VM_DISPATCH_END default: break; } break; }
+#define SPK_VM_CASE(op) case op:
+#define SPK_VM_NEXT() continue
+#include "vm_dispatch.h"
+#undef SPK_VM_NEXT
+#undef SPK_VM_CASE
+#undef SPK_VM_DISPATCH_END
+#undef SPK_VM_DISPATCH_BEGIN
+#undef SPK_VM_EXECUTE_FN
+
+#if SPK_VM_COMPUTED_GOTO
+// Labels as values and computed goto are GNU extensions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+#define SPK_OPCODE(name, ...) &&spk_vm_label_##name,
+#define SPK_VM_EXECUTE_FN spk_vm_execute_threaded
+#define SPK_VM_DISPATCH_BEGIN \
+    static void *dispatch_table[] = { SPK_OPCODE_ENUM_ITER() }; \
+    SPK_VM_NEXT ();
+#define SPK_VM_DISPATCH_END
+#define SPK_VM_CASE(op) spk_vm_label_##op:
+#define SPK_VM_NEXT() goto *dispatch_table[*ip++]
+#include "vm_dispatch.h"
+#undef SPK_VM_NEXT
+#undef SPK_VM_CASE
+#undef SPK_VM_DISPATCH_END
+#undef SPK_VM_DISPATCH_BEGIN
+#undef SPK_VM_EXECUTE_FN
+#undef SPK_OPCODE
+
+#pragma GCC diagnostic pop
+#endif
+
+const char *
+spk_vm_dispatch_str (SPK_vm_dispatch dispatch)
+{
+    switch (dispatch) {
+        case SPK_VM_DISPATCH_SWITCH: return "switch";
+        case SPK_VM_DISPATCH_THREADED: return "threaded";
+        default: return "Unknown";
+    }
+}
+
+bool
+spk_vm_dispatch_available (SPK_vm_dispatch dispatch)
+{
+    switch (dispatch) {
+        case SPK_VM_DISPATCH_SWITCH:
+            return true;
+        case SPK_VM_DISPATCH_THREADED:
+            return SPK_VM_COMPUTED_GOTO;
+        default:
+            return false;
+    }
+}
+
+static SPK_vm_result
+spk_vm_execute (const spk_chunk_t *chunk, spk_value_t *globals, SPK_vm_dispatch dispatch)
+{
+    spk_vm_t vm = {
+        .chunk = chunk,
+        .ip = chunk->code->data,
+        .stack = calloc (chunk->max_stack + 1, sizeof (spk_value_t)),
+        .globals = globals
+    };
+    vm.stack_top = vm.stack;
+
+    SPK_vm_result result;
+    switch (dispatch) {
+#if SPK_VM_COMPUTED_GOTO
+        case SPK_VM_DISPATCH_THREADED:
+            result = spk_vm_execute_threaded (&vm);
+            break;
+#endif
+        default:
+            result = spk_vm_execute_switch (&vm);
+            break;
+    }
+
+    SPK_STATS_ADD (statements, vm.executed);
+
+    // Strings left on the stack after an error
+    for (auto value = vm.stack; value < vm.stack_top; ++value) {
+        spk_value_release (*value);
+    }
+
+    free (vm.stack);
+    return result;
+}
+
+SPK_vm_result
+spk_vm_run_with_dispatch (const spk_chunk_t *chunk, SPK_vm_dispatch dispatch)
+{
+    spk_value_t *globals = calloc (chunk->global_count + 1, sizeof (spk_value_t));
+    auto result = spk_vm_execute (chunk, globals, dispatch);
+
+    for (uint32_t i = 0; i < chunk->global_count; ++i) {
+        spk_value_release (globals[i]);
+    }
+
+    free (globals);
+    return result;
+}
+
+SPK_vm_result
+spk_vm_run_with_globals (const spk_chunk_t *chunk, spk_value_t *globals)
+{
+    return spk_vm_execute (chunk, globals, SPK_VM_DEFAULT_DISPATCH);
+}
+
+SPK_vm_result
+spk_vm_run (const spk_chunk_t *chunk)
+{
+    return spk_vm_run_with_dispatch (chunk, SPK_VM_DEFAULT_DISPATCH);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "value.h"
+
+typedef struct spk_chunk_s spk_chunk_t;
+
+typedef enum {
+    SPK_VM_RESULT_OK,
+    SPK_VM_RESULT_RUNTIME_ERROR
+} SPK_vm_result;
+
+typedef enum {
+    // Portable `switch` inside a loop
+    SPK_VM_DISPATCH_SWITCH,
+    // Direct threading through GNU computed goto
+    SPK_VM_DISPATCH_THREADED,
+
+    SPK_VM_DISPATCH_COUNT
+} SPK_vm_dispatch;
+
+const char *spk_vm_dispatch_str (SPK_vm_dispatch dispatch);
+bool        spk_vm_dispatch_available (SPK_vm_dispatch dispatch);
+
+// Runs the chunk using the dispatch strategy selected at build time
+// (see SPK_VM_DISPATCH in src/CMakeLists.txt)
+SPK_vm_result spk_vm_run (const spk_chunk_t *chunk);
+SPK_vm_result spk_vm_run_with_dispatch (const spk_chunk_t *chunk, SPK_vm_dispatch dispatch);
+// Runs on the caller's global slots, at least chunk->global_count of them.
+// They can hold values before the run and still hold references after it.
+SPK_vm_result spk_vm_run_with_globals (const spk_chunk_t *chunk, spk_value_t *globals);
@@ -0,0 +1,265 @@
+// Dispatch loop shared by every dispatch strategy in vm.c.
+// Not a regular header: vm.c includes it once per strategy after defining
+//  - SPK_VM_EXECUTE_FN      name of the generated function
+//  - SPK_VM_DISPATCH_BEGIN  code that starts dispatching the first opcode
+//  - SPK_VM_DISPATCH_END    code closing whatever DISPATCH_BEGIN opened
+//  - SPK_VM_CASE(op)        entry point of an opcode handler
+//  - SPK_VM_NEXT()          dispatch the next opcode
+
+#define SPK_VM_ERROR(msg) do { \
+        vm->ip = ip; \
+        vm->stack_top = sp; \
+        vm->executed = executed; \
+        spk_vm_report_err (vm, msg); \
+        return SPK_VM_RESULT_RUNTIME_ERROR; \
+    } while (false)
+
+// Chunks are compiled from type checked programs, where operators only
+// ever see ints. None of the operators below look at a value's tag.
+// Comparisons take a C operator, arithmetic a wrapping spk_int_ function.
+#define SPK_VM_BINARY_OP(op, right_value) do { \
+        int32_t _right = spk_value_as_int (right_value); \
+        sp[-1] = spk_value_int (spk_value_as_int (sp[-1]) op _right); \
+    } while (false)
+
+#define SPK_VM_BINARY_OP_CONSTANT(op) do { \
+        int32_t _right = spk_value_as_int (constants[spk_read_u16 (ip)]); \
+        ip += 2; \
+        sp[-1] = spk_value_int (spk_value_as_int (sp[-1]) op _right); \
+    } while (false)
+
+#define SPK_VM_BINARY_OP_GLOBAL(op) do { \
+        auto _global = globals[spk_read_u16 (ip)]; \
+        ip += 2; \
+        SPK_VM_BINARY_OP (op, _global); \
+    } while (false)
+
+#define SPK_VM_INT_OP(fn, right_value) do { \
+        int32_t _right = spk_value_as_int (right_value); \
+        sp[-1] = spk_value_int (fn (spk_value_as_int (sp[-1]), _right)); \
+    } while (false)
+
+#define SPK_VM_INT_OP_CONSTANT(fn) do { \
+        int32_t _right = spk_value_as_int (constants[spk_read_u16 (ip)]); \
+        ip += 2; \
+        sp[-1] = spk_value_int (fn (spk_value_as_int (sp[-1]), _right)); \
+    } while (false)
+
+#define SPK_VM_INT_OP_GLOBAL(fn) do { \
+        auto _global = globals[spk_read_u16 (ip)]; \
+        ip += 2; \
+        SPK_VM_INT_OP (fn, _global); \
+    } while (false)
+
+#define SPK_VM_STRING_EQUAL(op) do { \
+        auto _left = spk_value_as_string (sp[-1]); \
+        auto _right = spk_value_as_string (*sp); \
+        bool _equal = spk_string_equal (_left, _right); \
+        spk_string_release (_left); \
+        spk_string_release (_right); \
+        sp[-1] = spk_value_int (_equal op true); \
+    } while (false)
+
+#define SPK_VM_CHECK_DIVISOR(divisor) do { \
+        if (spk_value_as_int (divisor) == 0) { \
+            SPK_VM_ERROR ("Division by zero"); \
+        } \
+    } while (false)
+
+static SPK_vm_result
+SPK_VM_EXECUTE_FN (spk_vm_t *vm)
+{
+    const spk_value_t *constants = vm->chunk->constants->data;
+    spk_value_t *globals = vm->globals;
+    const uint8_t *ip = vm->ip;
+    spk_value_t *sp = vm->stack_top;
+    // Every statement ends in DEFINE_GLOBAL, PRINT or POP
+    uint64_t executed = 0;
+
+    SPK_VM_DISPATCH_BEGIN
+
+    SPK_VM_CASE (SPK_OP_CONSTANT)
+        *sp++ = constants[spk_read_u16 (ip)];
+        ip += 2;
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_CONSTANT_LONG)
+        *sp++ = constants[spk_read_u32 (ip)];
+        ip += 4;
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_NIL)
+        *sp++ = spk_value_nil ();
+        SPK_VM_NEXT ();
+
+    SPK_VM_CASE (SPK_OP_DEFINE_GLOBAL)
+        globals[spk_read_u16 (ip)] = *--sp;
+        ip += 2;
+        ++executed;
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GET_GLOBAL)
+        *sp++ = globals[spk_read_u16 (ip)];
+        ip += 2;
+        SPK_VM_NEXT ();
+
+    SPK_VM_CASE (SPK_OP_NEGATE)
+        sp[-1] = spk_value_int (spk_int_neg (spk_value_as_int (sp[-1])));
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_NOT)
+        sp[-1] = spk_value_int (!spk_value_as_int (sp[-1]));
+        SPK_VM_NEXT ();
+
+    SPK_VM_CASE (SPK_OP_ADD)
+        --sp;
+        SPK_VM_INT_OP (spk_int_add, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_SUBTRACT)
+        --sp;
+        SPK_VM_INT_OP (spk_int_sub, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_MULTIPLY)
+        --sp;
+        SPK_VM_INT_OP (spk_int_mul, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_DIVIDE)
+        --sp;
+        SPK_VM_CHECK_DIVISOR (*sp);
+        SPK_VM_INT_OP (spk_int_div, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GREATER)
+        --sp;
+        SPK_VM_BINARY_OP (>, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GREATER_EQUAL)
+        --sp;
+        SPK_VM_BINARY_OP (>=, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_LESS)
+        --sp;
+        SPK_VM_BINARY_OP (<, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_LESS_EQUAL)
+        --sp;
+        SPK_VM_BINARY_OP (<=, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_EQUAL)
+        --sp;
+        SPK_VM_BINARY_OP (==, *sp);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_NOT_EQUAL)
+        --sp;
+        SPK_VM_BINARY_OP (!=, *sp);
+        SPK_VM_NEXT ();
+
+    SPK_VM_CASE (SPK_OP_CONCAT) {
+        --sp;
+        auto left = spk_value_as_string (sp[-1]);
+        auto right = spk_value_as_string (*sp);
+        sp[-1] = spk_value_string (spk_string_concat (left, right));
+        spk_string_release (left);
+        spk_string_release (right);
+        SPK_VM_NEXT ();
+    }
+    SPK_VM_CASE (SPK_OP_EQUAL_STRING)
+        --sp;
+        SPK_VM_STRING_EQUAL (==);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_NOT_EQUAL_STRING)
+        --sp;
+        SPK_VM_STRING_EQUAL (!=);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_RETAIN)
+        spk_string_retain (spk_value_as_string (sp[-1]));
+        SPK_VM_NEXT ();
+
+    SPK_VM_CASE (SPK_OP_PRINT)
+        spk_value_print (*--sp);
+        spk_value_release (*sp);
+        ++executed;
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_POP)
+        spk_value_release (*--sp);
+        ++executed;
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_RETURN)
+        vm->ip = ip;
+        vm->stack_top = sp;
+        vm->executed = executed;
+        return SPK_VM_RESULT_OK;
+
+    SPK_VM_CASE (SPK_OP_ADD_CONSTANT)
+        SPK_VM_INT_OP_CONSTANT (spk_int_add);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_SUBTRACT_CONSTANT)
+        SPK_VM_INT_OP_CONSTANT (spk_int_sub);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_MULTIPLY_CONSTANT)
+        SPK_VM_INT_OP_CONSTANT (spk_int_mul);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_DIVIDE_CONSTANT)
+        // Never fused with a zero divisor
+        SPK_VM_INT_OP_CONSTANT (spk_int_div);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GREATER_CONSTANT)
+        SPK_VM_BINARY_OP_CONSTANT (>);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GREATER_EQUAL_CONSTANT)
+        SPK_VM_BINARY_OP_CONSTANT (>=);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_LESS_CONSTANT)
+        SPK_VM_BINARY_OP_CONSTANT (<);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_LESS_EQUAL_CONSTANT)
+        SPK_VM_BINARY_OP_CONSTANT (<=);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_EQUAL_CONSTANT)
+        SPK_VM_BINARY_OP_CONSTANT (==);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_NOT_EQUAL_CONSTANT)
+        SPK_VM_BINARY_OP_CONSTANT (!=);
+        SPK_VM_NEXT ();
+
+    SPK_VM_CASE (SPK_OP_ADD_GLOBAL)
+        SPK_VM_INT_OP_GLOBAL (spk_int_add);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_SUBTRACT_GLOBAL)
+        SPK_VM_INT_OP_GLOBAL (spk_int_sub);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_MULTIPLY_GLOBAL)
+        SPK_VM_INT_OP_GLOBAL (spk_int_mul);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_DIVIDE_GLOBAL)
+        SPK_VM_CHECK_DIVISOR (globals[spk_read_u16 (ip)]);
+        SPK_VM_INT_OP_GLOBAL (spk_int_div);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GREATER_GLOBAL)
+        SPK_VM_BINARY_OP_GLOBAL (>);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_GREATER_EQUAL_GLOBAL)
+        SPK_VM_BINARY_OP_GLOBAL (>=);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_LESS_GLOBAL)
+        SPK_VM_BINARY_OP_GLOBAL (<);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_LESS_EQUAL_GLOBAL)
+        SPK_VM_BINARY_OP_GLOBAL (<=);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_EQUAL_GLOBAL)
+        SPK_VM_BINARY_OP_GLOBAL (==);
+        SPK_VM_NEXT ();
+    SPK_VM_CASE (SPK_OP_NOT_EQUAL_GLOBAL)
+        SPK_VM_BINARY_OP_GLOBAL (!=);
+        SPK_VM_NEXT ();
+
+    SPK_VM_DISPATCH_END
+
+    SPK_VM_ERROR ("Unknown opcode");
+}
+
+#undef SPK_VM_CHECK_DIVISOR
+#undef SPK_VM_STRING_EQUAL
+#undef SPK_VM_INT_OP_GLOBAL
+#undef SPK_VM_INT_OP_CONSTANT
+#undef SPK_VM_INT_OP
+#undef SPK_VM_BINARY_OP_GLOBAL
+#undef SPK_VM_BINARY_OP_CONSTANT
+#undef SPK_VM_BINARY_OP
+#undef SPK_VM_ERROR
@@ -1,10 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
 
-#include "interpreter/token.h"
+#include "spark.h"
+
 #include "interpreter/lexer.h"
 #include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/optimizer.h"
+#include "interpreter/printer.h"
+#include "interpreter/ast_interpreter.h"
+#include "interpreter/context.h"
+#include "interpreter/statements.h"
+
+#include "utils/arena.h"
+#include "utils/file.h"
+#include "utils/stats.h"
+
+#include <string.h>
 
 /*
  - Lexing / Scanning:
@@ -27,84 +40,307 @@
               Is part of a function *declaration*
 */
 
+typedef struct spk_options_s {
+    const char      *fpath;
+    SPK_engine      engine;
+    uint32_t        opt_level;
+    bool            dump_ast;
+    bool            dump_bytecode;
+    bool            peephole;
+    bool            arena_stats;
+    bool            stream;
+    const char      *cache_dir;
+    bool            jit;
+    uint32_t        jit_threshold;
+    const char      *emit_asm;
+    const char      *emit_c;
+    bool            stats;
+    const char      *profile;
+} spk_options_t;
+
 static void
 print_help ()
 {
-    printf ("Usage: spk-interp <file>\n");
+    printf ("Usage: spk-interp [options] <file>\n");
+    printf ("Options:\n");
+    printf ("\t--engine=<vm|ast|closure>  Execution engine to use (default: vm)\n");
+    printf ("\t-O0, -O1                   AST optimization level (default: -O1)\n");
+    printf ("\t--dump-ast                 Print the optimized AST before running it\n");
+    printf ("\t--dump-bytecode            Print the compiled bytecode before running it\n");
+    printf ("\t--no-peephole              Don't fuse instructions into superinstructions\n");
+    printf ("\t--arena-stats              Print arena memory usage after running\n");
+    printf ("\t--cache-dir=<dir>          Reuse the bytecode compiled by earlier runs from dir,\n");
+    printf ("\t                           skipping lexing, parsing and compiling (--engine=vm only)\n");
+    printf ("\t--stream                   Lex, check and run one statement at a time,\n");
+    printf ("\t                           stops at the first error (--engine=ast only)\n");
+    printf ("\t--jit[=<threshold>]        Compile statements to x86-64 machine code once they've\n");
+    printf ("\t                           run threshold times (default: 0, --engine=ast only)\n");
+    printf ("\t--emit-asm <out.s>         Compile to x86-64 assembly instead of running, build it\n");
+    printf ("\t                           with: cc out.s libspk-runtime.a\n");
+    printf ("\t--emit-c <out.c>           Translate to a self-contained C file instead of running\n");
+    printf ("\t--stats                    Print phase timings, counters and peak memory after running,\n");
+    printf ("\t                           lexing is part of parse with --stream\n");
+    printf ("\t--profile <out.folded>     Sample which lines the run spends its time in, write folded\n");
+    printf ("\t                           stacks for flamegraph.pl and print the hottest lines\n");
+    printf ("\t                           (--engine=ast only)\n");
 }
 
-typedef struct spk_file_s {
-    char  *data;
-    size_t size;
-} spk_file_t;
-
-static spk_file_t
-spk_read_file (const char *fpath)
+// Memory stays bounded by the largest statement rather than the
+// whole program, each one is discarded as soon as it ran
+static int32_t
+spk_stream_file (const spk_options_t *options)
 {
-    spk_file_t result = { nullptr, 0 };
+    if (options->engine != SPK_ENGINE_AST) {
+        printf ("Streaming is only supported by the ast engine\n");
+        return EXIT_FAILURE;
+    }
 
-    auto file = fopen (fpath, "r");
+    auto file = fopen (options->fpath, "r");
     if (!file) {
-        printf ("Failed to read file %s. No such file exists.\n", fpath);
-        return result;
+        printf ("Failed to read file %s. No such file exists.\n", options->fpath);
+        printf ("Failed reading spk file, exiting...\n");
+        return EXIT_FAILURE;
     }
 
-    fseek (file, 0, SEEK_END);
-    auto len = ftell (file) / sizeof (char);
-    fseek (file, 0, SEEK_SET);
+    printf ("Successfully loaded file '%s'\n", options->fpath);
+
+    spk_arena_t statement_arena;
+    spk_arena_init (&statement_arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    auto context = spk_context_create ();
+    auto stream = spk_token_stream_open (file, context->symbols);
+    auto parser = spk_parser_create (stream, &statement_arena);
+    auto resolver = spk_resolver_create ();
+    auto checker = spk_typechecker_create ();
+
+    int32_t result = EXIT_SUCCESS;
+    spk_statement_t stmt;
+    auto timer = spk_stats_timer_start ();
+    while (spk_parser_next_statement (parser, &stmt)) {
+        spk_stats_timer_stop (timer, SPK_STATS_PHASE_PARSE);
+        timer = spk_stats_timer_start ();
+
+        if (!spk_resolver_resolve (resolver, &stmt)) {
+            printf ("Resolver exited with errors.\n");
+            result = EXIT_FAILURE;
+            break;
+        }
+
+        if (!spk_typechecker_check (checker, &stmt)) {
+            printf ("Type checker exited with errors.\n");
+            result = EXIT_FAILURE;
+            break;
+        }
+
+        bool run = spk_optimize_statement (&stmt, options->opt_level);
+        spk_stats_timer_stop (timer, SPK_STATS_PHASE_CHECK);
+
+        if (run) {
+            if (options->dump_ast) {
+                spk_print_statement (&stmt);
+            }
 
-    char *buf = calloc (len + 1, sizeof (char));
-    fread (buf, sizeof (char), len, file);
-    
-    if (ferror (file) != 0) {
-        printf ("Failed to read file '%s', an error occurred.\n", fpath);
-        fclose (file);
-        return result;
+            timer = spk_stats_timer_start ();
+            bool ok = spk_interpret_statement (context, &stmt);
+            spk_stats_timer_stop (timer, SPK_STATS_PHASE_EXECUTE);
+            SPK_STATS_ADD (statements, 1);
+
+            if (!ok) {
+                result = EXIT_FAILURE;
+                break;
+            }
+        }
+
+        spk_arena_reset (&statement_arena);
+        timer = spk_stats_timer_start ();
     }
 
-    fclose (file);
+    if (spk_parser_had_error (parser)) {
+        printf ("Parser exited with errors.\n");
+        result = EXIT_FAILURE;
+    }
 
-    result.data = buf;
-    result.size = len * sizeof (char);
-    assert (result.data[result.size] == '\0');
+    if (options->arena_stats) {
+        spk_arena_print_stats (&statement_arena, "statement");
+    }
+
+    spk_typechecker_free (checker);
+    spk_resolver_free (resolver);
+    spk_parser_free (parser);
+    spk_token_stream_free (stream);
+    spk_context_free (context);
+    spk_arena_release (&statement_arena);
+
+    fclose (file);
     return result;
 }
 
 static int32_t
-spk_execute_file (const char *fpath)
+spk_execute_file (const spk_options_t *options)
 {
-    auto file = spk_read_file (fpath);
+    if (options->jit && (options->engine != SPK_ENGINE_AST || options->stream)) {
+        printf ("The JIT is only supported by the ast engine, without --stream\n");
+        return EXIT_FAILURE;
+    }
+
+    bool emit = options->emit_asm || options->emit_c;
+    if (emit && options->stream) {
+        printf ("--emit-asm and --emit-c compile the whole file, they can't be used with --stream\n");
+        return EXIT_FAILURE;
+    }
+
+    if (options->profile && (options->engine != SPK_ENGINE_AST || options->stream || emit)) {
+        printf ("--profile is only supported by the ast engine, without --stream or --emit-*\n");
+        return EXIT_FAILURE;
+    }
+
+    if (options->stream) {
+        return spk_stream_file (options);
+    }
+
+    auto timer = spk_stats_timer_start ();
+    auto file = spk_read_file (options->fpath);
+    spk_stats_timer_stop (timer, SPK_STATS_PHASE_READ);
     if (!file.data) {
         printf ("Failed reading spk file, exiting...\n");
         return EXIT_FAILURE;
     }
 
-    printf ("Successfully loaded file '%s'\n", fpath);
+    printf ("Successfully loaded file '%s'\n", options->fpath);
 
-    auto tokens = spk_tokenize_source (file.data, file.size);
-    if (!tokens) {
-        printf ("Lexer exited with errors.\n");
+    spk_program_options_t program_options;
+    spk_program_options_init (&program_options);
+    program_options.engine = options->engine;
+    program_options.opt_level = options->opt_level;
+    program_options.peephole = options->peephole;
+    program_options.dump_ast = options->dump_ast;
+    program_options.dump_bytecode = options->dump_bytecode;
+    program_options.cache_dir = options->cache_dir;
+    program_options.jit = options->jit;
+    program_options.jit_threshold = options->jit_threshold;
+    program_options.profile = options->profile != nullptr;
+
+    // Nothing runs, the ast engine builds nothing on top of the AST
+    if (emit) {
+        program_options.engine = SPK_ENGINE_AST;
+        program_options.cache_dir = nullptr;
+        program_options.jit = false;
+    }
+
+    auto program = spk_program_compile (file.data, file.size, &program_options);
+    free (file.data);
+    if (!program) {
         return EXIT_FAILURE;
     }
-    /*for (size_t i = 0; i < tokens->count; ++i) {
-        spk_print_token (darray_elem (tokens, i));
-    }*/
 
-    spk_parser_recursive_descent (tokens);
-    darray_free (tokens);
+    bool ok = true;
+    if (options->emit_asm) {
+        ok = spk_program_emit_asm (program, options->emit_asm);
+        if (ok) {
+            printf ("Successfully wrote '%s'\n", options->emit_asm);
+        }
+    }
 
-    free (file.data);
-    return EXIT_SUCCESS;
+    if (options->emit_c && ok) {
+        ok = spk_program_emit_c (program, options->emit_c);
+        if (ok) {
+            printf ("Successfully wrote '%s'\n", options->emit_c);
+        }
+    }
+
+    if (!emit) {
+        ok = spk_program_run (program, nullptr);
+    }
+
+    if (options->profile) {
+        ok = spk_program_write_profile (program, options->fpath, options->profile) && ok;
+    }
+
+    if (options->arena_stats) {
+        spk_program_print_stats (program);
+    }
+
+    spk_program_free (program);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static bool
+spk_parse_options (int argc, char **argv, spk_options_t *options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+
+        if (strcmp (arg, "--engine=vm") == 0) {
+            options->engine = SPK_ENGINE_VM;
+        } else if (strcmp (arg, "--engine=ast") == 0) {
+            options->engine = SPK_ENGINE_AST;
+        } else if (strcmp (arg, "--engine=closure") == 0) {
+            options->engine = SPK_ENGINE_CLOSURE;
+        } else if (strncmp (arg, "-O", 2) == 0 && arg[2] >= '0' && arg[2] <= '9' && !arg[3]) {
+            options->opt_level = (uint32_t)(arg[2] - '0');
+            if (options->opt_level > SPK_OPT_LEVEL_MAX) {
+                options->opt_level = SPK_OPT_LEVEL_MAX;
+            }
+        } else if (strcmp (arg, "--dump-ast") == 0) {
+            options->dump_ast = true;
+        } else if (strcmp (arg, "--dump-bytecode") == 0) {
+            options->dump_bytecode = true;
+        } else if (strcmp (arg, "--no-peephole") == 0) {
+            options->peephole = false;
+        } else if (strcmp (arg, "--arena-stats") == 0) {
+            options->arena_stats = true;
+        } else if (strncmp (arg, "--cache-dir=", 12) == 0 && arg[12]) {
+            options->cache_dir = arg + 12;
+        } else if (strcmp (arg, "--stream") == 0) {
+            options->stream = true;
+        } else if (strcmp (arg, "--jit") == 0) {
+            options->jit = true;
+        } else if (strncmp (arg, "--jit=", 6) == 0 && arg[6] >= '0' && arg[6] <= '9') {
+            options->jit = true;
+            options->jit_threshold = (uint32_t)strtoul (arg + 6, nullptr, 10);
+        } else if (strcmp (arg, "--emit-asm") == 0 && i + 1 < argc) {
+            options->emit_asm = argv[++i];
+        } else if (strcmp (arg, "--emit-c") == 0 && i + 1 < argc) {
+            options->emit_c = argv[++i];
+        } else if (strcmp (arg, "--profile") == 0 && i + 1 < argc) {
+            options->profile = argv[++i];
+        } else if (strcmp (arg, "--stats") == 0 && SPK_STATS) {
+            options->stats = true;
+        } else if (strcmp (arg, "--stats") == 0) {
+            printf ("--stats isn't available, spk-interp was built with SPK_STATS=OFF\n");
+            return false;
+        } else if (arg[0] == '-') {
+            printf ("Unknown option '%s'\n", arg);
+            return false;
+        } else {
+            options->fpath = arg;
+        }
+    }
+
+    return options->fpath != nullptr;
 }
 
 int
 main (int argc, char **argv)
 {
-    if (argc <= 1) {
+    spk_options_t options = {
+        .fpath = nullptr,
+        .engine = SPK_ENGINE_VM,
+        .opt_level = SPK_OPT_LEVEL_MAX,
+        .peephole = true
+    };
+
+    if (!spk_parse_options (argc, argv, &options)) {
         print_help ();
-        return EXIT_SUCCESS;
+        return argc <= 1 ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    return spk_execute_file (argv[1]);
-}
+    auto result = spk_execute_file (&options);
 
+#if SPK_STATS
+    if (options.stats) {
+        spk_stats_print ();
+    }
+#endif
+
+    return result;
+}
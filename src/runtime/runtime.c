@@ -0,0 +1,75 @@
+#include "runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void
+spk_rt_print_int (int32_t value)
+{
+    printf ("%d\n", value);
+}
+
+void
+spk_rt_print_string (spk_rt_string_t *string)
+{
+    printf ("%s\n", string->chars);
+    spk_rt_release (string);
+}
+
+void
+spk_rt_print_nil ()
+{
+    printf ("empty\n");
+}
+
+spk_rt_string_t *
+spk_rt_retain (spk_rt_string_t *string)
+{
+    if (string->refcount != SPK_RT_STRING_IMMORTAL) {
+        ++string->refcount;
+    }
+
+    return string;
+}
+
+void
+spk_rt_release (spk_rt_string_t *string)
+{
+    if (string->refcount != SPK_RT_STRING_IMMORTAL && --string->refcount == 0) {
+        free (string);
+    }
+}
+
+spk_rt_string_t *
+spk_rt_concat (spk_rt_string_t *left, spk_rt_string_t *right)
+{
+    size_t length = (size_t)left->length + right->length;
+    spk_rt_string_t *result = malloc (sizeof (spk_rt_string_t) + length + 1);
+    result->refcount = 1;
+    result->length = (uint32_t)length;
+    memcpy (result->chars, left->chars, left->length);
+    memcpy (result->chars + left->length, right->chars, right->length + 1);
+
+    spk_rt_release (left);
+    spk_rt_release (right);
+    return result;
+}
+
+int32_t
+spk_rt_string_equal (spk_rt_string_t *left, spk_rt_string_t *right)
+{
+    int32_t equal = left->length == right->length &&
+                    memcmp (left->chars, right->chars, left->length) == 0;
+
+    spk_rt_release (left);
+    spk_rt_release (right);
+    return equal;
+}
+
+void
+spk_rt_division_by_zero ()
+{
+    printf ("Runtime error: Division by zero\n");
+    exit (EXIT_FAILURE);
+}
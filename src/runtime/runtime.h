@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ Runtime of the programs spk-interp --emit-asm compiles ahead of time,
+ linked into the executable next to the generated code:
+
+   cc out.s libspk-runtime.a -o out
+
+ It shares nothing with the interpreter. Values are typed statically, an
+ int is an int32_t and a string is a spk_rt_string_t pointer, there are
+ no tags. Strings are refcounted, the functions below that take a string
+ without saying otherwise take over the caller's reference. Literals are
+ emitted as immortal strings straight into the executable's read-only
+ data, this header is their layout.
+*/
+
+#define SPK_RT_STRING_IMMORTAL UINT32_MAX
+
+typedef struct spk_rt_string_s {
+    uint32_t refcount; // SPK_RT_STRING_IMMORTAL for literals
+    uint32_t length;
+    char     chars[];  // Null-terminated
+} spk_rt_string_t;
+
+void spk_rt_print_int (int32_t value);
+void spk_rt_print_string (spk_rt_string_t *string);
+void spk_rt_print_nil ();
+
+// Returns string, with one more reference
+spk_rt_string_t *spk_rt_retain (spk_rt_string_t *string);
+void             spk_rt_release (spk_rt_string_t *string);
+
+spk_rt_string_t *spk_rt_concat (spk_rt_string_t *left, spk_rt_string_t *right);
+// 1 if both hold the same characters, 0 otherwise
+int32_t          spk_rt_string_equal (spk_rt_string_t *left, spk_rt_string_t *right);
+
+// Prints the runtime error and exits with EXIT_FAILURE, like spk-interp does
+void spk_rt_division_by_zero () __attribute__((noreturn));
@@ -0,0 +1,498 @@
+#include "spark.h"
+
+#include "interpreter/lexer.h"
+#include "interpreter/parser.h"
+#include "interpreter/resolver.h"
+#include "interpreter/typechecker.h"
+#include "interpreter/optimizer.h"
+#include "interpreter/printer.h"
+#include "interpreter/statements.h"
+#include "interpreter/context.h"
+#include "interpreter/ast_interpreter.h"
+#include "interpreter/bytecode.h"
+#include "interpreter/compiler.h"
+#include "interpreter/peephole.h"
+#include "interpreter/vm.h"
+#include "interpreter/closure.h"
+#include "interpreter/cache.h"
+#include "interpreter/jit.h"
+#include "interpreter/profiler.h"
+#include "interpreter/emit_asm.h"
+#include "interpreter/emit_c.h"
+
+#include "utils/arena.h"
+#include "utils/stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+struct spk_program_s {
+    SPK_engine    engine;
+    spk_context_t *context;
+    // The AST and string literals, the constants of every engine point into it
+    spk_arena_t   arena;
+
+    darray_t              *statements; // [spk_statement_t, ...], run by the ast engine
+    spk_jit_t             *jit;        // Runs them instead if set
+    spk_profiler_t        *profiler;   // Samples the ast engine's runs if set
+    spk_chunk_t           *chunk;
+    spk_closure_program_t *closure;
+
+    // What the vm runs, chunk or the one mapped from the cache
+    const spk_chunk_t *bytecode;
+    spk_cache_t       *cache;
+
+    SPK_input_type *input_types;
+    uint32_t       input_count;
+
+    spk_symbol_map_t globals;      // symbol -> slot of every input and var
+    uint32_t         global_count; // Slots reserved before every run
+};
+
+void
+spk_program_options_init (spk_program_options_t *options)
+{
+    *options = (spk_program_options_t) {
+        .engine = SPK_ENGINE_VM,
+        .opt_level = SPK_OPT_LEVEL_MAX,
+        .peephole = true
+    };
+}
+
+static SPK_value_type
+spk_input_value_type (SPK_input_type type)
+{
+    return type == SPK_INPUT_STRING ? SPK_VALUE_TYPE_STRING : SPK_VALUE_TYPE_INTEGER;
+}
+
+// Inputs take the first slots, in the order they were declared
+static bool
+spk_program_check (spk_program_t *program, const spk_program_options_t *options)
+{
+    auto symbols = program->context->symbols;
+    auto resolver = spk_resolver_create ();
+    auto checker = spk_typechecker_create ();
+
+    bool ok = true;
+    for (uint32_t i = 0; i < options->input_count; ++i) {
+        auto name = options->inputs[i].name;
+        auto symbol = spk_symbol_intern (symbols, name, strlen (name));
+
+        ok = spk_resolver_declare (resolver, symbol, name) && ok;
+        spk_typechecker_declare (checker, i, spk_input_value_type (options->inputs[i].type));
+        spk_symbol_map_insert (&program->globals, symbol, i);
+    }
+
+    for (size_t i = 0; i < program->statements->count; ++i) {
+        ok = spk_resolver_resolve (resolver, darray_elem (program->statements, i)) && ok;
+    }
+
+    if (!ok) {
+        printf ("Resolver exited with errors.\n");
+    } else {
+        for (size_t i = 0; i < program->statements->count; ++i) {
+            ok = spk_typechecker_check (checker, darray_elem (program->statements, i)) && ok;
+        }
+
+        if (!ok) {
+            printf ("Type checker exited with errors.\n");
+        }
+    }
+
+    for (size_t i = 0; i < program->statements->count && ok; ++i) {
+        spk_statement_t *stmt = darray_elem (program->statements, i);
+        if (stmt->type == SPK_STATEMENT_TYPE_VAR) {
+            spk_symbol_map_insert (&program->globals, stmt->var.symbol, stmt->var.slot);
+        }
+    }
+
+    program->global_count = program->globals.count;
+
+    spk_typechecker_free (checker);
+    spk_resolver_free (resolver);
+    return ok;
+}
+
+static bool
+spk_program_build (spk_program_t *program, const spk_program_options_t *options)
+{
+    switch (program->engine) {
+        case SPK_ENGINE_VM:
+            program->chunk = spk_compile_statements (program->statements);
+            if (!program->chunk) {
+                break;
+            }
+
+            if (options->peephole) {
+                spk_peephole_optimize (program->chunk);
+            }
+
+            if (options->dump_bytecode) {
+                spk_chunk_disassemble (program->chunk);
+            }
+
+            program->bytecode = program->chunk;
+            return true;
+        case SPK_ENGINE_AST:
+            if (options->jit && spk_jit_supported ()) {
+                program->jit = spk_jit_create (program->statements->count, options->jit_threshold);
+            }
+            return true;
+        case SPK_ENGINE_CLOSURE:
+            program->closure = spk_closure_compile (program->statements);
+            if (!program->closure) {
+                break;
+            }
+            return true;
+    }
+
+    printf ("Compiler exited with errors.\n");
+    return false;
+}
+
+static bool
+spk_program_compile_source (spk_program_t *program, const char *source, size_t length,
+                            const spk_program_options_t *options)
+{
+    auto timer = spk_stats_timer_start ();
+    auto tokens = spk_tokenize_source (source, length, program->context->symbols);
+    spk_stats_timer_stop (timer, SPK_STATS_PHASE_LEX);
+    if (!tokens) {
+        printf ("Lexer exited with errors.\n");
+        return false;
+    }
+
+    timer = spk_stats_timer_start ();
+    program->statements = spk_parser_recursive_descent (tokens, &program->arena);
+    spk_stats_timer_stop (timer, SPK_STATS_PHASE_PARSE);
+    spk_token_list_free (tokens);
+    if (!program->statements) {
+        printf ("Parser exited with errors.\n");
+        return false;
+    }
+
+    timer = spk_stats_timer_start ();
+    bool ok = spk_program_check (program, options);
+    if (ok) {
+        spk_optimize_statements (program->statements, options->opt_level);
+
+        if (options->dump_ast) {
+            spk_print_statements (program->statements);
+        }
+
+        ok = spk_program_build (program, options);
+    }
+
+    if (ok && options->profile && program->engine == SPK_ENGINE_AST) {
+        program->profiler = spk_profiler_create (program->statements, source, length);
+    }
+
+    spk_stats_timer_stop (timer, SPK_STATS_PHASE_CHECK);
+    return ok;
+}
+
+// Covers everything the bytecode depends on besides the build,
+// the cache header covers the build
+static uint64_t
+spk_program_cache_key (const char *source, size_t length, const spk_program_options_t *options)
+{
+    auto key = spk_cache_hash (SPK_CACHE_HASH_SEED, source, length);
+    key = spk_cache_hash (key, &options->opt_level, sizeof (options->opt_level));
+    key = spk_cache_hash (key, &options->peephole, sizeof (options->peephole));
+
+    for (uint32_t i = 0; i < options->input_count; ++i) {
+        auto input = &options->inputs[i];
+        key = spk_cache_hash (key, input->name, strlen (input->name));
+        key = spk_cache_hash (key, &input->type, sizeof (input->type));
+    }
+
+    return key;
+}
+
+static bool
+spk_program_load_cache (spk_program_t *program, const char *path, uint64_t key,
+                        const spk_program_options_t *options)
+{
+    program->cache = spk_cache_open (path, key);
+    if (!program->cache) {
+        return false;
+    }
+
+    program->bytecode = spk_cache_chunk (program->cache);
+    program->global_count = spk_cache_global_count (program->cache);
+
+    auto symbols = program->context->symbols;
+    for (uint32_t slot = 0; slot < program->global_count; ++slot) {
+        auto name = spk_cache_global_name (program->cache, slot);
+        auto symbol = spk_symbol_intern (symbols, name, strlen (name));
+        spk_symbol_map_insert (&program->globals, symbol, slot);
+    }
+
+    if (options->dump_bytecode) {
+        spk_chunk_disassemble (program->bytecode);
+    }
+
+    return true;
+}
+
+static void
+spk_program_store_cache (const spk_program_t *program, const char *dir, const char *path,
+                         uint64_t key)
+{
+    const char **names = calloc (program->global_count + 1, sizeof (const char *));
+    for (uint32_t i = 0; i < program->globals.capacity; ++i) {
+        auto entry = &program->globals.entries[i];
+        if (entry->key != SPK_SYMBOL_NONE) {
+            names[entry->value] = spk_symbol_name (program->context->symbols, entry->key);
+        }
+    }
+
+    // Only the last directory of the path is created
+    mkdir (dir, 0755);
+    if (!spk_cache_write (path, key, program->chunk, names, program->global_count)) {
+        printf ("Warning: failed to write cache file '%s'\n", path);
+    }
+
+    free (names);
+}
+
+spk_program_t *
+spk_program_compile (const char *source, size_t length, const spk_program_options_t *options)
+{
+    spk_program_t *program = calloc (1, sizeof (spk_program_t));
+    program->engine = options->engine;
+    program->context = spk_context_create ();
+    program->input_count = options->input_count;
+    spk_arena_init (&program->arena, SPK_ARENA_DEFAULT_BLOCK_SIZE);
+    spk_symbol_map_init (&program->globals);
+
+    program->input_types = calloc (options->input_count + 1, sizeof (SPK_input_type));
+    for (uint32_t i = 0; i < options->input_count; ++i) {
+        program->input_types[i] = options->inputs[i].type;
+    }
+
+    // The front end is skipped altogether on a cache hit
+    bool cached = options->cache_dir && options->engine == SPK_ENGINE_VM && !options->dump_ast;
+    uint64_t key = 0;
+    char *path = nullptr;
+    if (cached) {
+        key = spk_program_cache_key (source, length, options);
+        path = spk_cache_path (options->cache_dir, key);
+        if (spk_program_load_cache (program, path, key, options)) {
+            free (path);
+            return program;
+        }
+    }
+
+    bool ok = spk_program_compile_source (program, source, length, options);
+    if (ok && cached) {
+        spk_program_store_cache (program, options->cache_dir, path, key);
+    }
+
+    free (path);
+    if (!ok) {
+        spk_program_free (program);
+        return nullptr;
+    }
+
+    return program;
+}
+
+void
+spk_program_free (spk_program_t *program)
+{
+    // Globals can hold literals from the arena
+    spk_context_free (program->context);
+
+    if (program->chunk) {
+        spk_chunk_free (program->chunk);
+    }
+
+    if (program->cache) {
+        spk_cache_close (program->cache);
+    }
+
+    if (program->closure) {
+        spk_closure_program_free (program->closure);
+    }
+
+    if (program->jit) {
+        spk_jit_free (program->jit);
+    }
+
+    if (program->profiler) {
+        spk_profiler_free (program->profiler);
+    }
+
+    if (program->statements) {
+        darray_free (program->statements);
+    }
+
+    spk_symbol_map_free (&program->globals);
+    spk_arena_release (&program->arena);
+    free (program->input_types);
+    free (program);
+}
+
+bool
+spk_program_run (spk_program_t *program, const spk_input_value_t *values)
+{
+    auto context = program->context;
+    spk_context_clear_globals (context);
+    spk_context_reserve_globals (context, program->global_count);
+
+    for (uint32_t i = 0; i < program->input_count; ++i) {
+        if (program->input_types[i] == SPK_INPUT_STRING) {
+            auto string = values[i].string;
+            context->globals[i] = spk_value_string (spk_string_new (string, strlen (string)));
+        } else {
+            context->globals[i] = spk_value_int (values[i].integer);
+        }
+    }
+
+    auto timer = spk_stats_timer_start ();
+    bool ok = false;
+
+    switch (program->engine) {
+        case SPK_ENGINE_VM:
+            ok = spk_vm_run_with_globals (program->bytecode, context->globals) == SPK_VM_RESULT_OK;
+            break;
+        case SPK_ENGINE_AST:
+            // Runs unprofiled if another program's profiler is running
+            bool profile = program->profiler && spk_profiler_start (program->profiler);
+
+            ok = true;
+            size_t executed = 0;
+            for (; ok && executed < program->statements->count; ++executed) {
+                spk_statement_t *stmt = darray_elem (program->statements, executed);
+                if (profile) {
+                    spk_profiler_enter (program->profiler, executed);
+                }
+
+                if (program->jit) {
+                    ok = spk_jit_run_statement (program->jit, context, executed, stmt);
+                } else {
+                    ok = spk_interpret_statement (context, stmt);
+                }
+            }
+            if (profile) {
+                spk_profiler_stop (program->profiler);
+            }
+
+            SPK_STATS_ADD (statements, executed);
+            break;
+        case SPK_ENGINE_CLOSURE:
+            ok = spk_closure_run_with_globals (program->closure, context->globals);
+            break;
+    }
+
+    spk_stats_timer_stop (timer, SPK_STATS_PHASE_EXECUTE);
+    return ok;
+}
+
+// Returns nullptr if the program has no such global or hasn't run yet
+static spk_value_t *
+spk_program_global (spk_program_t *program, const char *name)
+{
+    auto context = program->context;
+    auto symbol = spk_symbol_intern (context->symbols, name, strlen (name));
+    auto slot = spk_symbol_map_find (&program->globals, symbol);
+    if (!slot || *slot >= context->global_capacity) {
+        return nullptr;
+    }
+
+    return &context->globals[*slot];
+}
+
+bool
+spk_program_get_int (spk_program_t *program, const char *name, int32_t *value)
+{
+    auto global = spk_program_global (program, name);
+    if (!global || !spk_value_is_int (*global)) {
+        return false;
+    }
+
+    *value = spk_value_as_int (*global);
+    return true;
+}
+
+const char *
+spk_program_get_string (spk_program_t *program, const char *name)
+{
+    auto global = spk_program_global (program, name);
+    if (!global || spk_value_tag (*global) != SPK_VALUE_TAG_STRING) {
+        return nullptr;
+    }
+
+    return spk_string_chars (spk_value_as_string (*global));
+}
+
+static bool
+spk_program_emit (const spk_program_t *program, const char *path,
+                  bool (*emit) (darray_t *statements, FILE *out))
+{
+    // A standalone executable has no host to set inputs
+    if (!program->statements || program->input_count > 0) {
+        printf ("Only programs compiled from source without inputs can be emitted\n");
+        return false;
+    }
+
+    auto file = fopen (path, "w");
+    if (!file) {
+        printf ("Failed opening '%s' for writing\n", path);
+        return false;
+    }
+
+    bool ok = emit (program->statements, file);
+    ok = fclose (file) == 0 && ok;
+    if (!ok) {
+        printf ("Failed writing '%s'\n", path);
+    }
+
+    return ok;
+}
+
+bool
+spk_program_emit_asm (const spk_program_t *program, const char *path)
+{
+    return spk_program_emit (program, path, spk_emit_asm);
+}
+
+bool
+spk_program_emit_c (const spk_program_t *program, const char *path)
+{
+    return spk_program_emit (program, path, spk_emit_c);
+}
+
+bool
+spk_program_write_profile (const spk_program_t *program, const char *script,
+                           const char *path)
+{
+    if (!program->profiler) {
+        printf ("The program wasn't compiled with profiling\n");
+        return false;
+    }
+
+    auto file = fopen (path, "w");
+    if (!file) {
+        printf ("Failed opening '%s' for writing\n", path);
+        return false;
+    }
+
+    spk_profiler_write_folded (program->profiler, script, file);
+    bool ok = fclose (file) == 0;
+    if (!ok) {
+        printf ("Failed writing '%s'\n", path);
+    }
+
+    spk_profiler_print_hotspots (program->profiler, 20);
+    return ok;
+}
+
+void
+spk_program_print_stats (const spk_program_t *program)
+{
+    spk_arena_print_stats (&program->arena, "ast");
+}
@@ -0,0 +1,133 @@
+#include "arena.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdalign.h>
+
+typedef struct spk_arena_block_s {
+    spk_arena_block_t *next;
+    size_t            size;
+    size_t            used;
+    alignas (max_align_t) uint8_t data[];
+} spk_arena_block_t;
+
+static inline size_t
+spk_arena_align (size_t size)
+{
+    const size_t align = alignof (max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static spk_arena_block_t *
+spk_arena_new_block (spk_arena_t *arena, size_t min_size)
+{
+    size_t size = min_size > arena->block_size ? min_size : arena->block_size;
+    spk_arena_block_t *block = malloc (sizeof (spk_arena_block_t) + size);
+    block->next = nullptr;
+    block->size = size;
+    block->used = 0;
+
+    arena->bytes_reserved += size;
+    SPK_STATS_ADD (bytes_allocated, sizeof (spk_arena_block_t) + size);
+    return block;
+}
+
+void
+spk_arena_init (spk_arena_t *arena, size_t block_size)
+{
+    *arena = (spk_arena_t) {
+        .first = nullptr,
+        .current = nullptr,
+        .block_size = block_size ? block_size : SPK_ARENA_DEFAULT_BLOCK_SIZE
+    };
+}
+
+void
+spk_arena_reset (spk_arena_t *arena)
+{
+    for (auto block = arena->first; block; block = block->next) {
+        block->used = 0;
+    }
+
+    arena->current = arena->first;
+    arena->bytes_used = 0;
+}
+
+void
+spk_arena_release (spk_arena_t *arena)
+{
+    auto block = arena->first;
+    while (block) {
+        auto next = block->next;
+        free (block);
+        block = next;
+    }
+
+    arena->first = nullptr;
+    arena->current = nullptr;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+}
+
+void *
+spk_arena_alloc (spk_arena_t *arena, size_t size)
+{
+    size = spk_arena_align (size);
+
+    auto block = arena->current;
+    // Blocks kept by a reset are reused before allocating new ones
+    while (block && block->used + size > block->size) {
+        block = block->next;
+    }
+
+    if (!block) {
+        block = spk_arena_new_block (arena, size);
+        if (!arena->first) {
+            arena->first = block;
+        } else {
+            // Insert after the current block so the
+            // rest of the chain stays available
+            block->next = arena->current->next;
+            arena->current->next = block;
+        }
+    }
+
+    arena->current = block;
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+
+    arena->bytes_used += size;
+    if (arena->bytes_used > arena->high_water) {
+        arena->high_water = arena->bytes_used;
+    }
+
+    return ptr;
+}
+
+void *
+spk_arena_alloc_zeroed (spk_arena_t *arena, size_t size)
+{
+    void *ptr = spk_arena_alloc (arena, size);
+    memset (ptr, 0, size);
+    return ptr;
+}
+
+char *
+spk_arena_strndup (spk_arena_t *arena, const char *str, size_t len)
+{
+    char *buf = spk_arena_alloc (arena, len + 1);
+    memcpy (buf, str, len);
+    buf[len] = '\0';
+    return buf;
+}
+
+void
+spk_arena_print_stats (const spk_arena_t *arena, const char *name)
+{
+    printf ("Arena '%s': %zu bytes used, %zu bytes high-water, %zu bytes reserved\n",
+            name, arena->bytes_used, arena->high_water, arena->bytes_reserved);
+}
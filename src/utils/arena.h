@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+#define SPK_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct spk_arena_block_s spk_arena_block_t;
+
+// Bump allocator, memory is only ever given back in bulk
+// by spk_arena_reset or spk_arena_release
+typedef struct spk_arena_s {
+    spk_arena_block_t *first;
+    spk_arena_block_t *current;
+    size_t            block_size;
+
+    size_t bytes_used;     // Allocated since the last reset
+    size_t high_water;     // Largest bytes_used ever reached
+    size_t bytes_reserved; // Total size of all blocks
+} spk_arena_t;
+
+void spk_arena_init (spk_arena_t *arena, size_t block_size);
+
+// Rewinds the arena but keeps its blocks around for reuse
+void spk_arena_reset (spk_arena_t *arena);
+// Frees every block owned by the arena
+void spk_arena_release (spk_arena_t *arena);
+
+void *spk_arena_alloc (spk_arena_t *arena, size_t size);
+void *spk_arena_alloc_zeroed (spk_arena_t *arena, size_t size);
+char *spk_arena_strndup (spk_arena_t *arena, const char *str, size_t len);
+
+void spk_arena_print_stats (const spk_arena_t *arena, const char *name);
+
+#define spk_arena_new(arena, type) \
+    ((type *)spk_arena_alloc_zeroed ((arena), sizeof (type)))
@@ -1,4 +1,5 @@
 #include "darray.h"
+#include "stats.h"
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -9,6 +10,7 @@ static void
 darray_realloc (darray_t *arr)
 {
     arr->data = reallocarray (arr->data, arr->capacity, arr->elem_size);
+    SPK_STATS_ADD (bytes_allocated, arr->capacity * arr->elem_size);
     // FIXME: Zero out new memory?
 }
 
@@ -31,6 +33,7 @@ darray_free (darray_t *arr)
         }
     }
 
+    free (arr->data);
     free (arr);
 }
 
@@ -46,6 +49,15 @@ darray_append (darray_t *arr, const void *elem)
     ++arr->count;
 }
 
+void
+darray_reserve (darray_t *arr, size_t capacity)
+{
+    if (capacity > arr->capacity) {
+        arr->capacity = capacity;
+        darray_realloc (arr);
+    }
+}
+
 void *
 darray_elem (darray_t *arr, size_t idx)
 {
@@ -16,6 +16,8 @@ darray_t *darray_empty (size_t elem_size);
 void      darray_free (darray_t *arr);
 
 void      darray_append (darray_t *arr, const void *elem);
+// Makes room for capacity elements without changing count
+void      darray_reserve (darray_t *arr, size_t capacity);
 void     *darray_elem (darray_t *arr, size_t idx);
 
 #define darray_append_v(arr, value) do { \
@@ -0,0 +1,40 @@
+#include "file.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+spk_file_t
+spk_read_file (const char *fpath)
+{
+    spk_file_t result = { nullptr, 0 };
+
+    auto file = fopen (fpath, "r");
+    if (!file) {
+        printf ("Failed to read file %s. No such file exists.\n", fpath);
+        return result;
+    }
+
+    fseek (file, 0, SEEK_END);
+    auto len = ftell (file) / sizeof (char);
+    fseek (file, 0, SEEK_SET);
+
+    char *buf = calloc (len + 1, sizeof (char));
+    SPK_STATS_ADD (bytes_allocated, len + 1);
+    fread (buf, sizeof (char), len, file);
+
+    if (ferror (file) != 0) {
+        printf ("Failed to read file '%s', an error occurred.\n", fpath);
+        free (buf);
+        fclose (file);
+        return result;
+    }
+
+    fclose (file);
+
+    result.data = buf;
+    result.size = len * sizeof (char);
+    assert (result.data[result.size] == '\0');
+    return result;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stddef.h>
+
+typedef struct spk_file_s {
+    char  *data; // Null-terminated, the caller frees it
+    size_t size;
+} spk_file_t;
+
+// Reads a whole file into memory, data is nullptr once the error is printed
+spk_file_t spk_read_file (const char *fpath);
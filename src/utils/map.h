@@ -0,0 +1,134 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "stats.h"
+
+/*
+ Typed open-addressing hash maps with linear probing, over a power-of-two
+ table kept at most 3/4 full. SPK_MAP_DECLARE (name, key_type, value_type,
+ empty_key, hash) declares name_t, name_entry_t and static inline
+
+   name_init, name_free
+   name_find      Pointer to the value, nullptr if the key isn't there
+   name_insert    false, leaving the map untouched, if the key is there
+
+ Keys are integers or pointers compared with ==, empty_key marks unused
+ entries and can't be inserted. hash returns 32 bits; the slot comes
+ from its top bits, which suits multiplicative (Fibonacci) hashing.
+
+ Lookups count towards --stats (global_lookups and global_probes).
+*/
+
+#define SPK_MAP_INITIAL_CAPACITY 16
+
+#define SPK_MAP_DECLARE(name, key_type, value_type, empty_key, hash) \
+    typedef struct name##_entry_s { \
+        key_type   key; \
+        value_type value; \
+    } name##_entry_t; \
+    \
+    typedef struct name##_s { \
+        name##_entry_t *entries; \
+        uint32_t       capacity; \
+        uint32_t       count; \
+    } name##_t; \
+    \
+    static inline uint32_t \
+    name##_slot (const name##_t *map, key_type key) \
+    { \
+        return (uint32_t)(hash (key)) >> (32 - __builtin_ctz (map->capacity)); \
+    } \
+    \
+    static inline void \
+    name##_alloc (name##_t *map, uint32_t capacity) \
+    { \
+        map->capacity = capacity; \
+        map->entries = malloc (capacity * sizeof (name##_entry_t)); \
+        for (uint32_t i = 0; i < capacity; ++i) { \
+            map->entries[i].key = (empty_key); \
+        } \
+    } \
+    \
+    static inline void \
+    name##_init (name##_t *map) \
+    { \
+        map->count = 0; \
+        name##_alloc (map, SPK_MAP_INITIAL_CAPACITY); \
+    } \
+    \
+    static inline void \
+    name##_free (name##_t *map) \
+    { \
+        free (map->entries); \
+        *map = (name##_t) {}; \
+    } \
+    \
+    static inline value_type * \
+    name##_find (const name##_t *map, key_type key) \
+    { \
+        uint32_t mask = map->capacity - 1; \
+        SPK_STATS_ADD (global_lookups, 1); \
+        \
+        for (uint32_t idx = name##_slot (map, key);; idx = (idx + 1) & mask) { \
+            auto entry = &map->entries[idx]; \
+            SPK_STATS_ADD (global_probes, 1); \
+            if (entry->key == key) { \
+                return &entry->value; \
+            } \
+            \
+            if (entry->key == (empty_key)) { \
+                return nullptr; \
+            } \
+        } \
+    } \
+    \
+    static inline void \
+    name##_grow (name##_t *map) \
+    { \
+        auto old = map->entries; \
+        auto old_capacity = map->capacity; \
+        name##_alloc (map, old_capacity * 2); \
+        \
+        uint32_t mask = map->capacity - 1; \
+        for (uint32_t i = 0; i < old_capacity; ++i) { \
+            if (old[i].key == (empty_key)) { \
+                continue; \
+            } \
+            \
+            uint32_t idx = name##_slot (map, old[i].key); \
+            while (map->entries[idx].key != (empty_key)) { \
+                idx = (idx + 1) & mask; \
+            } \
+            \
+            map->entries[idx] = old[i]; \
+        } \
+        \
+        free (old); \
+    } \
+    \
+    static inline bool \
+    name##_insert (name##_t *map, key_type key, value_type value) \
+    { \
+        assert (key != (empty_key)); \
+        \
+        if (name##_find (map, key)) { \
+            return false; \
+        } \
+        \
+        if ((map->count + 1) * 4 > map->capacity * 3) { \
+            name##_grow (map); \
+        } \
+        \
+        uint32_t mask = map->capacity - 1; \
+        uint32_t idx = name##_slot (map, key); \
+        while (map->entries[idx].key != (empty_key)) { \
+            idx = (idx + 1) & mask; \
+        } \
+        \
+        map->entries[idx] = (name##_entry_t) { key, value }; \
+        ++map->count; \
+        return true; \
+    }
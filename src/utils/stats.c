@@ -0,0 +1,77 @@
+#include "stats.h"
+
+#if SPK_STATS
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/resource.h>
+
+_Thread_local spk_stats_t spk_stats;
+
+static const char *spk_stats_phase_names[SPK_STATS_PHASE_COUNT] = {
+    [SPK_STATS_PHASE_READ] = "read",
+    [SPK_STATS_PHASE_LEX] = "lex",
+    [SPK_STATS_PHASE_PARSE] = "parse",
+    [SPK_STATS_PHASE_CHECK] = "check",
+    [SPK_STATS_PHASE_EXECUTE] = "execute",
+};
+
+static double
+spk_stats_clock (clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime (clock, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+spk_stats_timer_t
+spk_stats_timer_start ()
+{
+    return (spk_stats_timer_t) {
+        .wall = spk_stats_clock (CLOCK_MONOTONIC),
+        .cpu = spk_stats_clock (CLOCK_PROCESS_CPUTIME_ID)
+    };
+}
+
+void
+spk_stats_timer_stop (spk_stats_timer_t start, SPK_stats_phase phase)
+{
+    spk_stats.wall[phase] += spk_stats_clock (CLOCK_MONOTONIC) - start.wall;
+    spk_stats.cpu[phase] += spk_stats_clock (CLOCK_PROCESS_CPUTIME_ID) - start.cpu;
+}
+
+void
+spk_stats_print ()
+{
+    double wall = 0.0;
+    double cpu = 0.0;
+
+    printf ("Stats:\n");
+    printf ("  %-10s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (uint32_t phase = 0; phase < SPK_STATS_PHASE_COUNT; ++phase) {
+        printf ("  %-10s %12.3f %12.3f\n", spk_stats_phase_names[phase],
+                spk_stats.wall[phase] * 1e3, spk_stats.cpu[phase] * 1e3);
+        wall += spk_stats.wall[phase];
+        cpu += spk_stats.cpu[phase];
+    }
+    printf ("  %-10s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+
+    double probes = spk_stats.global_lookups
+        ? (double)spk_stats.global_probes / (double)spk_stats.global_lookups
+        : 0.0;
+
+    // ru_maxrss is in kilobytes on Linux
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+
+    printf ("  %-20s %" PRIu64 "\n", "tokens", spk_stats.tokens);
+    printf ("  %-20s %" PRIu64 "\n", "ast nodes", spk_stats.expr_nodes);
+    printf ("  %-20s %" PRIu64 "\n", "statements executed", spk_stats.statements);
+    printf ("  %-20s %" PRIu64 " (%.2f probes on average)\n", "global lookups",
+            spk_stats.global_lookups, probes);
+    printf ("  %-20s %" PRIu64 "\n", "bytes allocated", spk_stats.bytes_allocated);
+    printf ("  %-20s %ld KB\n", "peak rss", usage.ru_maxrss);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ Counters behind spk-interp --stats. Every thread counts into its own
+ spk_stats, each counter costs an add where the counted thing happens.
+ Building with SPK_STATS=0 (cmake -DSPK_STATS=OFF) removes them along
+ with the phase timers, SPK_STATS_ADD then expands to nothing.
+
+ The lexer's worker threads don't count: the thread that called
+ spk_tokenize_source adds their tokens up once they're joined, the
+ memory they allocated is missing from bytes_allocated.
+*/
+
+#ifndef SPK_STATS
+#define SPK_STATS 1
+#endif
+
+typedef enum {
+    SPK_STATS_PHASE_READ,
+    SPK_STATS_PHASE_LEX,
+    SPK_STATS_PHASE_PARSE,
+    SPK_STATS_PHASE_CHECK,   // Resolving, type checking, optimizing and compiling
+    SPK_STATS_PHASE_EXECUTE,
+
+    SPK_STATS_PHASE_COUNT
+} SPK_stats_phase;
+
+typedef struct spk_stats_s {
+    double wall[SPK_STATS_PHASE_COUNT]; // Seconds
+    double cpu[SPK_STATS_PHASE_COUNT];  // Seconds, of every thread of the process
+
+    uint64_t tokens;
+    uint64_t expr_nodes;      // Allocated by the parser
+    uint64_t statements;      // Executed, by any engine
+    uint64_t global_lookups;  // In SPK_MAP maps, all of them map symbols to slots
+    uint64_t global_probes;   // Entries those lookups looked at
+    uint64_t bytes_allocated; // By arenas, darrays, vectors, strings and file buffers
+} spk_stats_t;
+
+typedef struct spk_stats_timer_s {
+    double wall;
+    double cpu;
+} spk_stats_timer_t;
+
+#if SPK_STATS
+
+extern _Thread_local spk_stats_t spk_stats;
+
+#define SPK_STATS_ADD(counter, n) (spk_stats.counter += (uint64_t)(n))
+
+spk_stats_timer_t spk_stats_timer_start ();
+// Adds the time since start to phase
+void              spk_stats_timer_stop (spk_stats_timer_t start, SPK_stats_phase phase);
+
+// Prints this thread's counters along with the peak RSS of the process
+void spk_stats_print ();
+
+#else
+
+#define SPK_STATS_ADD(counter, n) ((void)0)
+
+static inline spk_stats_timer_t
+spk_stats_timer_start ()
+{
+    return (spk_stats_timer_t) {};
+}
+
+static inline void
+spk_stats_timer_stop (spk_stats_timer_t start, SPK_stats_phase phase)
+{
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "strbuf.h"
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define SPK_STRBUF_MIN_CAPACITY 64
+
+void
+spk_strbuf_init (spk_strbuf_t *buf)
+{
+    *buf = (spk_strbuf_t) {};
+}
+
+void
+spk_strbuf_free (spk_strbuf_t *buf)
+{
+    free (buf->data);
+    spk_strbuf_init (buf);
+}
+
+void
+spk_strbuf_reserve (spk_strbuf_t *buf, size_t length)
+{
+    if (length < buf->capacity) {
+        return;
+    }
+
+    size_t capacity = buf->capacity ? buf->capacity : SPK_STRBUF_MIN_CAPACITY;
+    while (capacity <= length) {
+        capacity *= 2;
+    }
+
+    buf->data = realloc (buf->data, capacity);
+    buf->data[buf->length] = '\0';
+    buf->capacity = capacity;
+    SPK_STATS_ADD (bytes_allocated, capacity);
+}
+
+void
+spk_strbuf_append_n (spk_strbuf_t *buf, const char *str, size_t length)
+{
+    spk_strbuf_reserve (buf, buf->length + length);
+    memcpy (buf->data + buf->length, str, length);
+    buf->length += length;
+    buf->data[buf->length] = '\0';
+}
+
+void
+spk_strbuf_append (spk_strbuf_t *buf, const char *str)
+{
+    spk_strbuf_append_n (buf, str, strlen (str));
+}
+
+void
+spk_strbuf_appendf (spk_strbuf_t *buf, const char *fmt, ...)
+{
+    va_list args;
+    va_start (args);
+    int length = vsnprintf (nullptr, 0, fmt, args);
+    va_end (args);
+
+    if (length <= 0) {
+        return;
+    }
+
+    spk_strbuf_reserve (buf, buf->length + (size_t)length);
+
+    va_start (args);
+    vsnprintf (buf->data + buf->length, (size_t)length + 1, fmt, args);
+    va_end (args);
+    buf->length += (size_t)length;
+}
+
+void
+spk_strbuf_clear (spk_strbuf_t *buf)
+{
+    buf->length = 0;
+    if (buf->data) {
+        buf->data[0] = '\0';
+    }
+}
+
+char *
+spk_strbuf_take (spk_strbuf_t *buf)
+{
+    char *str = buf->data ? buf->data : strdup ("");
+    spk_strbuf_init (buf);
+    return str;
+}
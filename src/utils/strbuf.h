@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ Growable, always null-terminated string. An empty builder allocates
+ nothing and its data is nullptr, spk_strbuf_take still returns a string.
+*/
+
+typedef struct spk_strbuf_s {
+    char   *data;
+    size_t length; // Without the null terminator
+    size_t capacity;
+} spk_strbuf_t;
+
+void spk_strbuf_init (spk_strbuf_t *buf);
+void spk_strbuf_free (spk_strbuf_t *buf);
+
+// Room for length characters plus the terminator
+void spk_strbuf_reserve (spk_strbuf_t *buf, size_t length);
+void spk_strbuf_append (spk_strbuf_t *buf, const char *str);
+void spk_strbuf_append_n (spk_strbuf_t *buf, const char *str, size_t length);
+void spk_strbuf_appendf (spk_strbuf_t *buf, const char *fmt, ...)
+    __attribute__((format (printf, 2, 3)));
+
+// Keeps the memory
+void spk_strbuf_clear (spk_strbuf_t *buf);
+// Hands the string over to the caller, who frees it, and empties buf
+char *spk_strbuf_take (spk_strbuf_t *buf);
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+/*
+ Typed growable arrays. SPK_VEC_DECLARE (name, type) declares name_t
+ along with static inline functions over it, so element accesses are
+ plain indexing the compiler sees through:
+
+   name_init, name_free     An empty vector allocates nothing
+   name_push, name_pop
+   name_at                  Bounds checked by assert
+   name_reserve             Room for at least capacity elements
+   name_shrink              Gives back what count doesn't need
+   name_clear               Keeps the memory
+
+ SPK_VEC_DECLARE_SMALL (name, type, n) also keeps the first n elements
+ inside the vector itself, short vectors never touch the heap. Those
+ point into themselves: they can't be copied or moved by value.
+
+ Capacity doubles, starting at SPK_VEC_MIN_CAPACITY. data is nullptr
+ while nothing was allocated. Heap allocations count towards --stats.
+*/
+
+#define SPK_VEC_MIN_CAPACITY 16
+
+#define SPK_VEC_DECLARE(name, type) \
+    typedef struct name##_s { \
+        type   *data; \
+        size_t count; \
+        size_t capacity; \
+    } name##_t; \
+    SPK_VEC_FUNCTIONS (name, type, nullptr, 0)
+
+#define SPK_VEC_DECLARE_SMALL(name, type, inline_capacity) \
+    typedef struct name##_s { \
+        type   *data; \
+        size_t count; \
+        size_t capacity; \
+        type   small[inline_capacity]; \
+    } name##_t; \
+    SPK_VEC_FUNCTIONS (name, type, vec->small, inline_capacity)
+
+// small is an expression of vec, nullptr for vectors without one
+#define SPK_VEC_FUNCTIONS(name, type, small, small_capacity) \
+    static inline void \
+    name##_init (name##_t *vec) \
+    { \
+        vec->count = 0; \
+        vec->data = (small); \
+        vec->capacity = (small_capacity); \
+    } \
+    \
+    static inline void \
+    name##_free (name##_t *vec) \
+    { \
+        if (vec->data != (small)) { \
+            free (vec->data); \
+        } \
+        name##_init (vec); \
+    } \
+    \
+    static inline void \
+    name##_resize_storage (name##_t *vec, size_t capacity) \
+    { \
+        type *inline_data = (small); \
+        if (inline_data && capacity <= (small_capacity)) { \
+            if (vec->data != inline_data) { \
+                memcpy (inline_data, vec->data, vec->count * sizeof (type)); \
+                free (vec->data); \
+                vec->data = inline_data; \
+            } \
+            vec->capacity = (small_capacity); \
+        } else if (inline_data && vec->data == inline_data) { \
+            vec->data = malloc (capacity * sizeof (type)); \
+            memcpy (vec->data, inline_data, vec->count * sizeof (type)); \
+            vec->capacity = capacity; \
+            SPK_STATS_ADD (bytes_allocated, capacity * sizeof (type)); \
+        } else if (capacity == 0) { \
+            free (vec->data); \
+            vec->data = nullptr; \
+            vec->capacity = 0; \
+        } else { \
+            vec->data = reallocarray (vec->data, capacity, sizeof (type)); \
+            vec->capacity = capacity; \
+            SPK_STATS_ADD (bytes_allocated, capacity * sizeof (type)); \
+        } \
+    } \
+    \
+    static inline void \
+    name##_reserve (name##_t *vec, size_t capacity) \
+    { \
+        if (capacity > vec->capacity) { \
+            name##_resize_storage (vec, capacity); \
+        } \
+    } \
+    \
+    static inline void \
+    name##_shrink (name##_t *vec) \
+    { \
+        if (vec->count < vec->capacity) { \
+            name##_resize_storage (vec, vec->count); \
+        } \
+    } \
+    \
+    static inline void \
+    name##_push (name##_t *vec, type value) \
+    { \
+        if (vec->count == vec->capacity) { \
+            name##_resize_storage (vec, vec->capacity ? vec->capacity * 2 : SPK_VEC_MIN_CAPACITY); \
+        } \
+        vec->data[vec->count++] = value; \
+    } \
+    \
+    static inline type \
+    name##_pop (name##_t *vec) \
+    { \
+        assert (vec->count > 0); \
+        return vec->data[--vec->count]; \
+    } \
+    \
+    static inline type * \
+    name##_at (const name##_t *vec, size_t index) \
+    { \
+        assert (index < vec->count); \
+        return &vec->data[index]; \
+    } \
+    \
+    static inline void \
+    name##_clear (name##_t *vec) \
+    { \
+        vec->count = 0; \
+    }
@@ -0,0 +1,118 @@
+# Runs a script with --cache-dir and checks when the .spkc file is
+# reused: a second run maps it, an edited source or a damaged file is
+# compiled again and gives the right output. Whether the front end ran
+# is read from the token count --stats prints, 0 on a cache hit.
+#
+#   cmake -DSPK_INTERP=<exe> -DSCRIPT=<file.spk> -DEXPECTED_OUTPUT=<file>
+#         -DWORK_DIR=<dir> -P cache.cmake
+
+get_filename_component(script_name "${SCRIPT}" NAME)
+set(script "${WORK_DIR}/${script_name}")
+set(cache_dir "${WORK_DIR}/cache")
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+configure_file("${SCRIPT}" "${script}" COPYONLY)
+file(READ "${EXPECTED_OUTPUT}" expected)
+
+# spk_cache_run(<step> <hit|miss> <expected output>)
+function(spk_cache_run step outcome expected)
+    execute_process(
+        COMMAND "${SPK_INTERP}" --engine=vm --cache-dir=cache --stats "${script_name}"
+        WORKING_DIRECTORY "${WORK_DIR}"
+        RESULT_VARIABLE status
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE errors)
+    message("${step}:\n${output}${errors}")
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "${step}: exit status ${status}")
+    endif()
+
+    string(FIND "${output}" "Stats:\n" stats)
+    string(SUBSTRING "${output}" 0 ${stats} printed)
+    if(NOT printed STREQUAL expected)
+        message(FATAL_ERROR "${step}: output differs from the uncached run")
+    endif()
+
+    string(REGEX MATCH "tokens +([0-9]+)" _ "${output}")
+    if(outcome STREQUAL "hit" AND NOT CMAKE_MATCH_1 EQUAL 0)
+        message(FATAL_ERROR "${step}: compiled the source instead of using the cache file")
+    elseif(outcome STREQUAL "miss" AND CMAKE_MATCH_1 EQUAL 0)
+        message(FATAL_ERROR "${step}: used a cache file it shouldn't have")
+    endif()
+endfunction()
+
+# Replaces length bytes at offset with text, text can't hold a NUL
+function(spk_cache_patch file offset length text)
+    math(EXPR tail_start "${offset} + ${length} + 1")
+    execute_process(COMMAND head -c ${offset} "${file}" OUTPUT_FILE "${WORK_DIR}/head")
+    execute_process(COMMAND tail -c +${tail_start} "${file}" OUTPUT_FILE "${WORK_DIR}/tail")
+    file(WRITE "${WORK_DIR}/text" "${text}")
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E cat "${WORK_DIR}/head" "${WORK_DIR}/text" "${WORK_DIR}/tail"
+        OUTPUT_FILE "${file}")
+    file(REMOVE "${WORK_DIR}/head" "${WORK_DIR}/text" "${WORK_DIR}/tail")
+endfunction()
+
+# Little endian uint32_t at offset
+function(spk_cache_read_u32 file offset result)
+    file(READ "${file}" hex OFFSET ${offset} LIMIT 4 HEX)
+    set(value "")
+    foreach(byte 6 4 2 0)
+        string(SUBSTRING "${hex}" ${byte} 2 digits)
+        string(APPEND value "${digits}")
+    endforeach()
+    math(EXPR value "0x${value}")
+    set(${result} ${value} PARENT_SCOPE)
+endfunction()
+
+spk_cache_run("first run" miss "${expected}")
+file(GLOB cache_files "${cache_dir}/*.spkc")
+list(LENGTH cache_files count)
+if(NOT count EQUAL 1)
+    message(FATAL_ERROR "Expected one cache file, found ${count}")
+endif()
+set(old_file "${cache_files}")
+configure_file("${old_file}" "${WORK_DIR}/old.spkc" COPYONLY)
+
+spk_cache_run("second run" hit "${expected}")
+
+# An edited source gets its own file, and a file holding another key
+# under its name isn't used either
+file(APPEND "${script}" "print \"edited\";\n")
+string(APPEND expected "edited\n")
+spk_cache_run("edited source" miss "${expected}")
+
+file(GLOB cache_files "${cache_dir}/*.spkc")
+list(REMOVE_ITEM cache_files "${old_file}")
+set(file "${cache_files}")
+configure_file("${WORK_DIR}/old.spkc" "${file}" COPYONLY)
+spk_cache_run("stale file" miss "${expected}")
+spk_cache_run("rewritten stale file" hit "${expected}")
+
+# Damaged files fall back to compiling and get rewritten
+file(SIZE "${file}" size)
+math(EXPR half "${size} / 2")
+execute_process(COMMAND head -c ${half} "${file}" OUTPUT_FILE "${WORK_DIR}/truncated")
+configure_file("${WORK_DIR}/truncated" "${file}" COPYONLY)
+spk_cache_run("truncated file" miss "${expected}")
+
+file(WRITE "${file}" "")
+spk_cache_run("empty file" miss "${expected}")
+
+spk_cache_patch("${file}" 0 4 "SPKX")
+spk_cache_run("bad magic" miss "${expected}")
+
+# strings_offset is at offset 52 of spk_cache_header_t, the refcount of
+# the first string isn't SPK_STRING_IMMORTAL anymore
+spk_cache_read_u32("${file}" 52 strings_offset)
+spk_cache_patch("${file}" ${strings_offset} 4 "xxxx")
+spk_cache_run("bad string" miss "${expected}")
+
+# The names section has to end with a NUL
+file(SIZE "${file}" size)
+math(EXPR last "${size} - 1")
+spk_cache_patch("${file}" ${last} 1 "x")
+spk_cache_run("bad names" miss "${expected}")
+
+spk_cache_run("repaired file" hit "${expected}")
@@ -0,0 +1,73 @@
+# Runs spk-interp on a script, or the executable --emit-asm / --emit-c
+# build out of it, and checks the exit status. The output is printed for
+# PASS_REGULAR_EXPRESSION, a mismatch fails with a CMake error.
+#
+#   cmake -DSPK_INTERP=<exe> -DSCRIPT=<file.spk> [-DARGS=<"a b">]
+#         [-DEXPECTED_EXIT=<n>] [-DEXPECTED_OUTPUT=<file>]
+#         [-DEMIT=<asm|c> -DCC=<cc> -DRUNTIME=<lib> -DWORK_DIR=<dir>]
+#         -P run_script.cmake
+#
+# The script runs from its own directory, so the "Successfully loaded
+# file" line doesn't depend on where the tree is checked out.
+
+if(EXPECTED_EXIT STREQUAL "")
+    set(EXPECTED_EXIT 0)
+endif()
+
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+get_filename_component(script_dir "${SCRIPT}" DIRECTORY)
+get_filename_component(script_name "${SCRIPT}" NAME)
+
+if(EMIT)
+    set(extension ${EMIT})
+    if(EMIT STREQUAL "asm")
+        set(extension s)
+    endif()
+
+    get_filename_component(name "${SCRIPT}" NAME_WE)
+    file(MAKE_DIRECTORY "${WORK_DIR}")
+    set(emitted "${WORK_DIR}/${name}.${extension}")
+    set(exe "${WORK_DIR}/${name}-${EMIT}")
+
+    execute_process(
+        COMMAND "${SPK_INTERP}" --emit-${EMIT} "${emitted}" "${script_name}"
+        WORKING_DIRECTORY "${script_dir}"
+        RESULT_VARIABLE status
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "--emit-${EMIT} failed (${status}):\n${output}")
+    endif()
+
+    execute_process(
+        COMMAND "${CC}" -o "${exe}" "${emitted}" ${RUNTIME}
+        RESULT_VARIABLE status
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output)
+    if(NOT status EQUAL 0)
+        message(FATAL_ERROR "Building ${emitted} failed (${status}):\n${output}")
+    endif()
+
+    set(command "${exe}")
+else()
+    set(command "${SPK_INTERP}" ${args} "${script_name}")
+endif()
+
+execute_process(
+    COMMAND ${command}
+    WORKING_DIRECTORY "${script_dir}"
+    RESULT_VARIABLE status
+    OUTPUT_VARIABLE output
+    ERROR_VARIABLE errors)
+message("${output}${errors}")
+
+if(NOT status STREQUAL "${EXPECTED_EXIT}")
+    message(FATAL_ERROR "Unexpected exit status ${status}, expected ${EXPECTED_EXIT}")
+endif()
+
+if(EXPECTED_OUTPUT)
+    file(READ "${EXPECTED_OUTPUT}" expected)
+    if(NOT output STREQUAL expected)
+        message(FATAL_ERROR "Output differs from ${EXPECTED_OUTPUT}")
+    endif()
+endif()